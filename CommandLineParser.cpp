@@ -6,6 +6,9 @@
  * Copyright (C) 2022 Marc S. Ressl
  */
 
+#include <cstdint>
+#include <cstdlib>
+
 #include "CommandLineParser.h"
 
 using namespace std;
@@ -39,3 +42,28 @@ string CommandLineParser::getOption(const string &name)
 
     return "";
 }
+
+/**
+ * @brief Reads the value of an option as a number
+ *
+ * @param name
+ * @param value     not changed if the option is missing or invalid
+ * @return false if the option is there, but its value is not a number
+ */
+bool CommandLineParser::getNumberOption(const string &name, unsigned int &value)
+{
+    if (!hasOption(name))
+        return true;
+
+    string option = getOption(name);
+
+    char *end;
+    unsigned long number = strtoul(option.c_str(), &end, 10);
+
+    if (option.empty() || option[0] == '-' || *end != '\0' || number > UINT32_MAX)
+        return false;
+
+    value = (unsigned int)number;
+
+    return true;
+}
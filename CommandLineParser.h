@@ -21,6 +21,7 @@ public:
 
     bool hasOption(const std::string &option);
     std::string getOption(const std::string &option);
+    bool getNumberOption(const std::string &option, unsigned int &value);
 
 private:
     std::vector<std::string> arguments;
@@ -0,0 +1,124 @@
+/**
+ * @file DirectoryWatcher.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Notifies changes to the files of a directory
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "DirectoryWatcher.h"
+
+using namespace std;
+
+// Cuánto tiempo sin cambios nuevos se espera antes de avisar
+static const int QUIET_MILLISECONDS = 300;
+
+// Cada cuánto se revisa si hay que terminar
+static const int STOP_CHECK_MILLISECONDS = 250;
+
+DirectoryWatcher::DirectoryWatcher()
+{
+    inotifyFd = -1;
+    isStopping = false;
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    stop();
+}
+
+/**
+ * @brief Starts watching a directory
+ *
+ * @param path
+ * @param onChange  called from the watcher thread, never twice at once
+ * @return true if the directory is being watched
+ */
+bool DirectoryWatcher::start(const string &path, function<void()> onChange)
+{
+    stop();
+
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0)
+        return false;
+
+    // IN_ATTRIB detecta también un "touch", que solo cambia la fecha
+    uint32_t events = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ATTRIB;
+    if (inotify_add_watch(inotifyFd, path.c_str(), events) < 0)
+    {
+        close(inotifyFd);
+        inotifyFd = -1;
+        return false;
+    }
+
+    this->onChange = onChange;
+    isStopping = false;
+    watchThread = thread(&DirectoryWatcher::run, this);
+
+    return true;
+#else
+    cout << "No se pueden vigilar directorios en esta plataforma" << endl;
+
+    return false;
+#endif
+}
+
+/**
+ * @brief Stops watching and waits for a call to onChange in progress
+ *
+ */
+void DirectoryWatcher::stop()
+{
+    isStopping = true;
+
+    if (watchThread.joinable())
+        watchThread.join();
+
+#ifdef __linux__
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+#endif
+    inotifyFd = -1;
+}
+
+void DirectoryWatcher::run()
+{
+#ifdef __linux__
+    bool hasChanges = false;
+
+    // Los eventos no se miran uno por uno: alcanza con saber que hubo alguno
+    alignas(inotify_event) char buffer[4096];
+
+    while (!isStopping)
+    {
+        pollfd pollEntry = {inotifyFd, POLLIN, 0};
+        int timeout = hasChanges ? QUIET_MILLISECONDS : STOP_CHECK_MILLISECONDS;
+        int result = poll(&pollEntry, 1, timeout);
+
+        if (result > 0)
+        {
+            while (read(inotifyFd, buffer, sizeof(buffer)) > 0)
+                hasChanges = true;
+        }
+        else if (result == 0 && hasChanges)
+        {
+            hasChanges = false;
+            onChange();
+        }
+        else if (result < 0 && errno != EINTR)
+            break;
+    }
+#endif
+}
@@ -0,0 +1,45 @@
+/**
+ * @file DirectoryWatcher.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Notifies changes to the files of a directory
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Calls a function from its own thread when files of a directory are
+ *        written, moved or deleted
+ *
+ * Los cambios se agrupan: la función se llama recién cuando pasa un rato sin
+ * cambios nuevos, así que copiar muchas páginas de una vez genera una sola
+ * llamada. Solo funciona en Linux (inotify).
+ */
+class DirectoryWatcher
+{
+public:
+    DirectoryWatcher();
+    ~DirectoryWatcher();
+
+    bool start(const std::string &path, std::function<void()> onChange);
+    void stop();
+
+private:
+    void run();
+
+    int inotifyFd;
+    std::atomic<bool> isStopping;
+    std::function<void()> onChange;
+    std::thread watchThread;
+};
+
+#endif
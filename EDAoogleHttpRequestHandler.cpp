@@ -7,10 +7,16 @@
  *
  */
 
-#include <iostream>
 #include <algorithm>
-#include <filesystem>
-#include <fstream>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string_view>
 #include <vector>
 
 // Referencia para la implementación de medición de tiempos:
@@ -21,419 +27,780 @@
 
 using namespace std;
 
-static void removeHtmlFromLine(string &line);
-static void splitLineInStrings(string &linel, vector<string> &output);
-static bool isNotSeparator(char c);
-static void decodeHtmlEntities(vector<string> &words);
-static void encodeHtmlEntities(vector<string> &words);
-static void printSearchIndex();
+// Directorio de los segmentos del índice
+static const string SEARCH_INDEX_PATH = "searchIndex";
+
+// Resultados por página, si no se indica "k"
+static const size_t DEFAULT_RESULTS_PER_PAGE = 10;
+static const size_t MAX_RESULTS_PER_PAGE = 100;
+
+// Más resultados que estos no se ordenan: se envían a medida que aparecen
+static const size_t MAX_STREAMED_RESULTS = UINT32_MAX;
+static const size_t MAX_OFFSET = UINT32_MAX;
+static const size_t STREAM_CHUNK_RESULTS = 64;
+
+// Búsquedas recientes que se guardan, repartidas en shards
+static const size_t QUERY_CACHE_SIZE = 4096;
+static const size_t QUERY_CACHE_SHARDS = 16;
+
+// Palabras sugeridas mientras se escribe, si no se indica "n"
+static const size_t DEFAULT_SUGGESTIONS = 10;
+static const size_t MAX_SUGGESTIONS = 100;
+
+static const string SEARCH_URL = "/search";
+static const string SUGGEST_URL = "/suggest";
+static const string METRICS_URL = "/metrics";
+
+static const string SUGGEST_CONTENT_TYPE = "application/json; charset=utf-8";
+
+// El formato de texto de Prometheus
+static const string METRICS_CONTENT_TYPE = "text/plain; version=0.0.4";
+
+static const string EMPTY_STRING;
+
+// La página de resultados se arma alrededor de la búsqueda, que va en el input
+static const string_view PAGE_HEADER = "<!DOCTYPE html>\
+<html>\
+\
+<head>\
+    <meta charset=\"utf-8\" />\
+    <title>EDAoogle</title>\
+    <link rel=\"preload\" href=\"https://fonts.googleapis.com\" />\
+    <link rel=\"preload\" href=\"https://fonts.gstatic.com\" crossorigin />\
+    <link href=\"https://fonts.googleapis.com/css2?family=Inter:wght@400;800&display=swap\" rel=\"stylesheet\" />\
+    <link rel=\"preload\" href=\"../css/style.css\" />\
+    <link rel=\"stylesheet\" href=\"../css/style.css\" />\
+</head>\
+\
+<body>\
+    <article class=\"edaoogle\">\
+        <div class=\"title\"><a href=\"/\">EDAoogle</a></div>\
+        <div class=\"search\">\
+            <form action=\"/search\" method=\"get\">\
+                <input type=\"text\" name=\"q\" value=\"";
+static const string_view PAGE_SEARCH_END = "\" autofocus>\
+            </form>\
+        </div>\
+        ";
+static const string_view PAGE_TRAILER = "    </article>\
+</body>\
+</html>";
+
+// Lo más que puede crecer un caracter al escaparlo ("&quot;") o codificarlo ("%22")
+static const size_t MAX_HTML_ESCAPE_GROWTH = 6;
+static const size_t MAX_URL_ENCODE_GROWTH = 3;
+
+// Lo que ocupan como máximo los números y el texto fijo alrededor de ellos y de cada resultado
+static const size_t MAX_NUMBER_SIZE = 32;
+static const size_t MAX_RESULT_MARKUP_SIZE = 64;
+static const size_t MAX_PAGE_MARKUP_SIZE = 512;
+
+/**
+ * @brief Writes a page at the end of a buffer, which must have reserved enough
+ *        space so that it never grows
+ */
+class PageWriter
+{
+public:
+    PageWriter(vector<char> &output);
+
+    void write(string_view text);
+    void writeNumber(size_t value);
+    void writeHtmlEscaped(string_view text);
+    void writeUrlArgument(string_view value);
+
+private:
+    vector<char> &output;
+};
+
+// Entidad que reemplaza a cada caracter especial de HTML
+static const struct HtmlEntityTable
+{
+    const char *entities[256] = {};
+
+    HtmlEntityTable()
+    {
+        entities[(unsigned char)'&'] = "&amp;";
+        entities[(unsigned char)'<'] = "&lt;";
+        entities[(unsigned char)'>'] = "&gt;";
+        entities[(unsigned char)'"'] = "&quot;";
+        entities[(unsigned char)'\''] = "&#39;";
+    }
+
+    const char *operator[](unsigned char c) const
+    {
+        return entities[c];
+    }
+} HTML_ENTITIES;
+
+struct ResultsPage
+{
+    string_view searchString;
+    bool anyWord;
+    size_t offset;
+    size_t limit;
+    size_t matchCount;
+    float searchTime;
+    string_view resultsHtml;
+    bool hasNextPage;
+};
+
+/**
+ * @brief Page with more results than can be ranked at once. Los resultados se
+ *        envían en orden de docId, a medida que el índice los va encontrando,
+ *        así que la memoria y el tiempo hasta el primer byte no dependen de
+ *        cuántos sean
+ */
+class SearchResultsStream : public HttpResponseStream
+{
+public:
+    SearchResultsStream(shared_ptr<const IndexSnapshot> searchIndex, const string &searchString,
+                        SearchMode mode, size_t offset, size_t limit);
+
+    size_t read(char *buffer, size_t size);
+
+private:
+    void writeNextPart();
+
+    // El índice no se libera mientras la página se envía
+    shared_ptr<const IndexSnapshot> searchIndex;
+    string searchString;
+    bool anyWord;
+    size_t offset;
+    size_t limit;
+
+    IndexMatches matches;
+    size_t matchPosition;
+    bool isStarted;
+    bool isFinished;
+
+    // La parte de la página que todavía no se leyó
+    vector<char> part;
+    size_t partPosition;
+};
+
+static size_t getNumberArgument(HttpArguments &arguments, const string &name,
+                                size_t defaultValue, size_t maxValue);
+static void writeResult(PageWriter &writer, string_view path);
+static void writePageLinks(PageWriter &writer, string_view searchString, bool anyWord,
+                           size_t offset, size_t limit, bool hasNextPage);
+static void renderResults(const vector<SearchResult> &results, const IndexSnapshot &searchIndex,
+                          vector<char> &html);
+static size_t getResultsPageMaxSize(const ResultsPage &resultsPage);
+static void writeResultsPage(PageWriter &writer, const ResultsPage &resultsPage);
 
 /**
  * @brief Construct a new EDAoogleHttpRequestHandler::EDAoogleHttpRequestHandler object
  *
  * @param homePath
+ * @param options       how to build the search index
+ * @param fileCacheSize maximum bytes of static files kept in memory
  */
-EDAoogleHttpRequestHandler::EDAoogleHttpRequestHandler(string homePath) : ServeHttpRequestHandler(homePath)
+EDAoogleHttpRequestHandler::EDAoogleHttpRequestHandler(string homePath,
+                                                       const SearchIndexOptions &options,
+                                                       size_t fileCacheSize) : ServeHttpRequestHandler(homePath, fileCacheSize),
+                                                                               searchIndex(SEARCH_INDEX_PATH, homePath + "/wiki", options),
+                                                                               queryCache(QUERY_CACHE_SIZE, QUERY_CACHE_SHARDS)
 {
     auto t1 = chrono::high_resolution_clock::now();
-    if (!loadSearchIndex())
+    cout << "Leyendo índice..." << endl;
+    if (!searchIndex.load())
     {
+        cout << "No existe índice válido. Creándolo..." << endl;
+
         auto t1 = chrono::high_resolution_clock::now();
 
-        buildSearchIndex();
+        // Se guarda a medida que se arma
+        searchIndex.build();
 
         auto t2 = chrono::high_resolution_clock::now();
         chrono::duration<double, std::milli> buildSearchIndexTime = t2 - t1;
 
-        printSearchIndex();
-        t1 = chrono::high_resolution_clock::now();
-
-        chrono::duration<double, std::milli> printSearchIndexTime = t1 - t2;
-
         cout << "Tiempo de armado de índice: " << buildSearchIndexTime.count() << "ms" << endl;
-        cout << "Tiempo de escritura de índice : " << printSearchIndexTime.count() << "ms" << endl;
     }
     else
     {
+        cout << "Índice leído..." << endl;
+
         auto t2 = chrono::high_resolution_clock::now();
         chrono::duration<double, std::milli> loadSearchIndexTime = t2 - t1;
         cout << "Tiempo de lectura de índice : " << loadSearchIndexTime.count() << "ms" << endl;
     }
+
+    // Si las páginas cambiaron desde que se guardó, se leen solo esas
+    updateSearchIndex();
+
+    searchIndex.startMerging();
 }
 
 bool EDAoogleHttpRequestHandler::handleRequest(string url,
                                                HttpArguments arguments,
-                                               vector<char> &response)
+                                               HttpResponse &response)
 {
-    string searchPage = "/search";
-    if (url.substr(0, searchPage.size()) == searchPage)
+    if (url.compare(0, SUGGEST_URL.size(), SUGGEST_URL) == 0)
     {
-        string searchString;
-        if (arguments.find("q") != arguments.end())
-            searchString = arguments["q"];
+        metrics.addCount(METRIC_SUGGEST_REQUESTS);
 
-        // Header
-        string responseString = string("<!DOCTYPE html>\
-<html>\
-\
-<head>\
-    <meta charset=\"utf-8\" />\
-    <title>EDAoogle</title>\
-    <link rel=\"preload\" href=\"https://fonts.googleapis.com\" />\
-    <link rel=\"preload\" href=\"https://fonts.gstatic.com\" crossorigin />\
-    <link href=\"https://fonts.googleapis.com/css2?family=Inter:wght@400;800&display=swap\" rel=\"stylesheet\" />\
-    <link rel=\"preload\" href=\"../css/style.css\" />\
-    <link rel=\"stylesheet\" href=\"../css/style.css\" />\
-</head>\
-\
-<body>\
-    <article class=\"edaoogle\">\
-        <div class=\"title\"><a href=\"/\">EDAoogle</a></div>\
-        <div class=\"search\">\
-            <form action=\"/search\" method=\"get\">\
-                <input type=\"text\" name=\"q\" value=\"" +
-                                       searchString + "\" autofocus>\
-            </form>\
-        </div>\
-        ");
+        auto query = arguments.find("q");
+        const string &prefix = (query != arguments.end()) ? query->second : EMPTY_STRING;
+        size_t count = getNumberArgument(arguments, "n", DEFAULT_SUGGESTIONS, MAX_SUGGESTIONS);
+
+        vector<TermCompletion> completions;
+        searchIndex.getSnapshot()->findCompletions(prefix, count, completions);
 
-        vector<string> results;
+        // Un array JSON. Los términos normalizados solo tienen letras y
+        // números, así que no hay nada que escapar
+        string json = "[";
+        for (size_t i = 0; i < completions.size(); i++)
+        {
+            if (i)
+                json += ",";
+            json += "\"" + completions[i].term + "\"";
+        }
+        json += "]";
+
+        response.contentType = SUGGEST_CONTENT_TYPE;
+        response.body.assign(json.begin(), json.end());
+
+        return true;
+    }
+    else if (url.compare(0, METRICS_URL.size(), METRICS_URL) == 0)
+    {
+        metrics.addCount(METRIC_METRICS_REQUESTS);
+
+        string text;
+        writeMetrics(text);
+        response.contentType = METRICS_CONTENT_TYPE;
+        response.body.assign(text.begin(), text.end());
+
+        return true;
+    }
+    else if (url.compare(0, SEARCH_URL.size(), SEARCH_URL) == 0)
+    {
+        metrics.addCount(METRIC_SEARCH_REQUESTS);
 
         auto t1 = chrono::high_resolution_clock::now();
 
-        matchSearch(searchString, results);
+        auto query = arguments.find("q");
+        const string &searchString = (query != arguments.end()) ? query->second : EMPTY_STRING;
+
+        // "k" resultados por página; las páginas se cuentan desde 1
+        size_t limit = getNumberArgument(arguments, "k", DEFAULT_RESULTS_PER_PAGE,
+                                         MAX_RESULTS_PER_PAGE);
+        size_t maxPage = SIZE_MAX / MAX_RESULTS_PER_PAGE;
+        size_t page = getNumberArgument(arguments, "page", 1, maxPage);
+        size_t offset = (page - 1) * limit;
+
+        // "offset" y "limit" reemplazan a "page" y "k"
+        offset = getNumberArgument(arguments, "offset", offset, MAX_OFFSET);
+        limit = getNumberArgument(arguments, "limit", limit, MAX_STREAMED_RESULTS);
+
+        // "mode=or" busca páginas con cualquiera de las palabras
+        auto modeArgument = arguments.find("mode");
+        bool anyWord = modeArgument != arguments.end() && modeArgument->second == "or";
+        SearchMode mode = anyWord ? SEARCH_ANY_WORD : SEARCH_ALL_WORDS;
+
+        if (limit > MAX_RESULTS_PER_PAGE)
+        {
+            response.stream = make_unique<SearchResultsStream>(searchIndex.getSnapshot(), searchString,
+                                                               mode, offset, limit);
+            return true;
+        }
+
+        // Las búsquedas populares se responden desde el cache
+        string cacheKey = getQueryCacheKey(searchString, mode, offset, limit);
 
         auto t2 = chrono::high_resolution_clock::now();
-        chrono::duration<double, std::milli> matchSearchTime = t2 - t1;
-        cout << "Tiempo de búsqueda: " << matchSearchTime.count() << "ms" << endl;
 
-        float searchTime = matchSearchTime.count() / 1000.0F;
+        // Desde el cache no hay nada que planear, ejecutar ni escribir
+        SearchTiming searchTiming = {0, 0, 0};
+        chrono::duration<double, std::milli> renderResultsTime(0);
 
-        // Print search results
-        responseString += "<div class=\"results\">" + to_string(results.size()) +
-                          " results (" + to_string(searchTime) + " seconds):</div>";
-        for (auto &result : results)
-            responseString += "<div class=\"result\"><a href=\"" +
-                              result + "\">" + result + "</a></div>";
+        shared_ptr<const QueryResults> queryResults = queryCache.get(cacheKey);
+        bool isCached = queryResults != NULL;
+        if (!isCached)
+        {
+            // La generación se lee antes que el índice: si justo se cambia el
+            // índice, los resultados del anterior no quedan en el cache
+            uint64_t generation = queryCache.getGeneration();
+            shared_ptr<const IndexSnapshot> snapshot = searchIndex.getSnapshot();
 
-        // Trailer
-        responseString += "    </article>\
-</body>\
-</html>";
+            auto newResults = make_shared<QueryResults>();
+            newResults->matchCount = snapshot->search(searchString, mode, offset, limit,
+                                                      newResults->results, &searchTiming);
+
+            auto t3 = chrono::high_resolution_clock::now();
+            renderResults(newResults->results, *snapshot, newResults->html);
+            renderResultsTime = chrono::high_resolution_clock::now() - t3;
+
+            queryCache.put(cacheKey, generation, newResults);
+            queryResults = newResults;
+        }
+
+        auto t4 = chrono::high_resolution_clock::now();
+        chrono::duration<double, std::milli> matchSearchTime = t4 - t1;
 
-        response.assign(responseString.begin(), responseString.end());
+        ResultsPage resultsPage;
+        resultsPage.searchString = searchString;
+        resultsPage.anyWord = anyWord;
+        resultsPage.offset = offset;
+        resultsPage.limit = limit;
+        resultsPage.matchCount = queryResults->matchCount;
+        resultsPage.searchTime = matchSearchTime.count() / 1000.0F;
+        resultsPage.resultsHtml = string_view(queryResults->html.data(), queryResults->html.size());
+        resultsPage.hasNextPage = offset + queryResults->results.size() < queryResults->matchCount;
+
+        // Se reserva una sola vez y se escribe directo en la respuesta
+        response.body.clear();
+        response.body.reserve(getResultsPageMaxSize(resultsPage));
+
+        PageWriter pageWriter(response.body);
+        writeResultsPage(pageWriter, resultsPage);
+
+        chrono::duration<double, std::milli> parseTime = t2 - t1;
+        chrono::duration<double, std::milli> renderPageTime = chrono::high_resolution_clock::now() - t4;
+
+        metrics.addTime(METRIC_PARSE, parseTime.count() + searchTiming.parseTime);
+        if (!isCached)
+        {
+            metrics.addTime(METRIC_LOOKUP, searchTiming.planningTime);
+            metrics.addTime(METRIC_INTERSECT, searchTiming.executionTime);
+        }
+        metrics.addTime(METRIC_RENDER, renderResultsTime.count() + renderPageTime.count());
 
         return true;
     }
     else
-        return serve(url, response);
+    {
+        bool isServed = serve(url, response);
+        metrics.addCount(isServed ? METRIC_FILE_REQUESTS : METRIC_NOT_FOUND_REQUESTS);
+
+        return isServed;
+    }
 
     return false;
 }
+
 /**
- * @brief Find the pages that contain all the words given in the string "searchString" and
- *        completes the "results" vector.
+ * @brief Adds the time that a response took to send, and its size
  *
- * @param searchString
- * @param results
+ * @param sentBytes
+ * @param milliseconds
  */
-void EDAoogleHttpRequestHandler::matchSearch(string &searchString, vector<string> &results)
+void EDAoogleHttpRequestHandler::handleResponseSent(uint64_t sentBytes, double milliseconds)
 {
-    if (searchString.size())
-    {
-        vector<string> wordsToSearch;
-        splitLineInStrings(searchString, wordsToSearch);
-
-        vector<unordered_set<string>> partialResults;
-
-        for (auto &word : wordsToSearch)
-        {
-            for (auto &c : word)
-                c = tolower(c);
-
-            // Se separan todas las coincidencias para cada palabra
-            partialResults.push_back(searchIndex[word]);
-        }
+    metrics.addTime(METRIC_SEND, milliseconds);
+    metrics.addCount(METRIC_SENT_BYTES, sentBytes);
+}
 
-        // Solo se aceptan solo los paths comunes a todas las coincidencias
-        for (auto path : partialResults[0])
-        {
-            bool pathChecker = false;
-
-            for (int i = 1; i < partialResults.size(); i++)
-            {
-                if (!partialResults[i].count(path))
-                {
-                    pathChecker = true;
-                    break;
-                }
-            }
-
-            if (!pathChecker)
-                results.push_back(path);
-        }
-    }
+/**
+ * @brief Keeps the search index up to date while the server runs, updating it
+ *        each time pages are written, moved or deleted
+ *
+ * @return true if the pages are being watched
+ */
+bool EDAoogleHttpRequestHandler::watchPages()
+{
+    return pageWatcher.start(searchIndex.getWikiPath(), [this]()
+                             { updateSearchIndex(); });
 }
+
 /**
- * @brief makes a search index that contains all the words that appear
- *        on the available pages
+ * @brief Adds to the index the pages added, changed or deleted since it was
+ *        built
  *
+ * Las búsquedas no se detienen: siguen usando el snapshot anterior hasta que
+ * se publica el nuevo.
  */
-void EDAoogleHttpRequestHandler::buildSearchIndex()
+void EDAoogleHttpRequestHandler::updateSearchIndex()
 {
-    const auto path = filesystem::absolute("www/wiki");
+    auto t1 = chrono::high_resolution_clock::now();
 
-    // Paths de todos los .html
-    vector fileList(filesystem::directory_iterator(path), {});
+    size_t changedCount = searchIndex.update();
+    if (!changedCount)
+        return;
 
-    for (auto &file : fileList)
-    {
-        if (filesystem::is_regular_file(file.path()))
-        {
-            ifstream fileStream(file.path().string());
+    // Primero el índice y después la generación (ver handleRequest())
+    queryCache.invalidate();
 
-            if (fileStream)
-            {
-                string webPath = file.path().string();
-                webPath = webPath.substr(webPath.find("/wiki"));
+    auto t2 = chrono::high_resolution_clock::now();
+    chrono::duration<double, std::milli> updateSearchIndexTime = t2 - t1;
 
-                string tempStr;
+    shared_ptr<const IndexSnapshot> snapshot = searchIndex.getSnapshot();
+    cout << "Índice actualizado: " << changedCount << " páginas cambiadas, "
+         << snapshot->getDocumentCount() << " en total, en "
+         << snapshot->getSegmentCount() << " segmentos" << endl;
+    cout << "Tiempo de actualización de índice: " << updateSearchIndexTime.count() << "ms" << endl;
+}
 
-                while (getline(fileStream, tempStr))
-                {
-                    removeHtmlFromLine(tempStr);
+/**
+ * @brief Hits and misses of the search results cache
+ *
+ * @return const QueryCache&
+ */
+const QueryCache &EDAoogleHttpRequestHandler::getQueryCache() const
+{
+    return queryCache;
+}
 
-                    vector<string> words;
-                    splitLineInStrings(tempStr, words);
+/**
+ * @brief Latencies of each stage of the requests, and counters
+ *
+ * @return const ServerMetrics&
+ */
+const ServerMetrics &EDAoogleHttpRequestHandler::getMetrics() const
+{
+    return metrics;
+}
 
-                    // Intentamos encodear las palabras ingresadas por el usuario, pero se hacía mal
-                    // el reemplazo por htmlEntities (agregaba caracteres extra)
+/**
+ * @brief Writes the page of /metrics: the metrics of the requests, of the
+ *        cache and of the current snapshot of the index
+ *
+ * @param text
+ */
+void EDAoogleHttpRequestHandler::writeMetrics(string &text)
+{
+    metrics.write(text);
 
-                    // Sería más eficiente, ya que no se decodifica cada palabra de la wiki
-                    decodeHtmlEntities(words);
+    writeMetric(text, "edaoogle_query_cache_hits_total", "counter", "Searches answered from the cache.",
+                (double)queryCache.getHitCount());
+    writeMetric(text, "edaoogle_query_cache_misses_total", "counter", "Searches not found in the cache.",
+                (double)queryCache.getMissCount());
 
-                    for (auto word : words)
-                    {
-                        for (auto &c : word)
-                            c = tolower(c);
+    // Un término que está en varios segmentos se cuenta en cada uno
+    shared_ptr<const IndexSnapshot> snapshot = searchIndex.getSnapshot();
 
-                        searchIndex[word].insert(webPath);
-                    }
-                }
-            }
-        }
+    size_t termCount = 0;
+    size_t postingBytes = 0;
+    for (size_t i = 0; i < snapshot->getSegmentCount(); i++)
+    {
+        const SearchIndex &segmentIndex = *snapshot->getSegment(i).index;
+        termCount += segmentIndex.getTermCount();
+        postingBytes += segmentIndex.getPostingBytes();
     }
+
+    writeMetric(text, "edaoogle_index_documents", "gauge", "Pages in the index.",
+                (double)snapshot->getDocumentCount());
+    writeMetric(text, "edaoogle_index_segments", "gauge", "Segments of the index.",
+                (double)snapshot->getSegmentCount());
+    writeMetric(text, "edaoogle_index_terms", "gauge", "Terms in the index, added up over its segments.",
+                (double)termCount);
+    writeMetric(text, "edaoogle_index_posting_bytes", "gauge", "Bytes of the posting lists.",
+                (double)postingBytes);
+    writeMetric(text, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.",
+                (double)getResidentMemory());
 }
+
 /**
- * @brief removes all HTML content from a given line
+ * @brief Reads a positive number from the request arguments
  *
- * @param line
+ * @param arguments
+ * @param name
+ * @param defaultValue  if the argument is missing or is not a positive number
+ * @param maxValue      larger numbers are clamped to this value
+ * @return size_t
  */
-static void removeHtmlFromLine(string &line)
+static size_t getNumberArgument(HttpArguments &arguments, const string &name,
+                                size_t defaultValue, size_t maxValue)
 {
-    while ((line.find('<')) != string::npos)
-    {
-        int starter = line.find('<');
-        int ender = line.find('>') + 1;
+    auto argument = arguments.find(name);
+    if (argument == arguments.end())
+        return defaultValue;
 
-        if (ender != string::npos)
-        {
-            line.erase(starter, ender - starter);
-        }
-    }
+    char *end;
+    unsigned long long value = strtoull(argument->second.c_str(), &end, 10);
+
+    if (end == argument->second.c_str() || *end != '\0' || value == 0 ||
+        argument->second[0] == '-')
+        return defaultValue;
+
+    return (size_t)min<unsigned long long>(value, maxValue);
 }
+
 /**
- * @brief divides a line into separated strings
+ * @brief Writes the list of results in HTML. It only depends on the results,
+ *        so it is cached with them
  *
- * @param line      Line to split into separated strings
- * @param output    vector that contains the separated strings
+ * @param results
+ * @param searchIndex   to get the path of each result
+ * @param html
  */
-static void splitLineInStrings(string &line, vector<string> &output)
+static void renderResults(const vector<SearchResult> &results, const IndexSnapshot &searchIndex,
+                          vector<char> &html)
 {
-
-    output.clear();
-    for (int i = 0; i < line.length(); i++)
+    size_t maxSize = 0;
+    for (auto &result : results)
     {
-        if (isNotSeparator(line[i]))
-        {
-            int j = i + 1;
+        size_t pathSize = searchIndex.getDocument(result.docId).path.size();
+        maxSize += MAX_RESULT_MARKUP_SIZE + 2 * MAX_HTML_ESCAPE_GROWTH * pathSize;
+    }
 
-            while (isNotSeparator(line[j]) && j < line.length())
-                j++;
+    html.clear();
+    html.reserve(maxSize);
 
-            output.push_back(line.substr(i, j - i));
+    PageWriter writer(html);
+    for (auto &result : results)
+        writeResult(writer, searchIndex.getDocument(result.docId).path);
 
-            i = j;
-        }
-    }
+    html.shrink_to_fit();
 }
+
 /**
- * @brief Determines if a character is a separator of words
+ * @brief Bounds the size of a page of results, from the length of its parts
  *
- * @param c character to evaluate
- * @return true if c is not a separator
- * @return false if c is a separator
+ * @param resultsPage
+ * @return size_t
  */
-static bool isNotSeparator(char c)
+static size_t getResultsPageMaxSize(const ResultsPage &resultsPage)
 {
-    return !(c == ' ' || c == ',' || c == '.' || c == '\r' || c == '-' || c == '\t' || c == '"' ||
-             c == '\'' || c == ';' || c == '(' || c == ')' || c == '[' || c == ']' || c == ':');
+    size_t searchSize = resultsPage.searchString.size();
+
+    return PAGE_HEADER.size() + PAGE_SEARCH_END.size() + PAGE_TRAILER.size() +
+           MAX_PAGE_MARKUP_SIZE + 4 * MAX_NUMBER_SIZE +
+           MAX_HTML_ESCAPE_GROWTH * searchSize +
+           2 * MAX_URL_ENCODE_GROWTH * searchSize +
+           resultsPage.resultsHtml.size();
 }
+
 /**
- * @brief Convert an HTML entity to a UNICODE character
+ * @brief Writes the HTML of a page of results
  *
- * @param words     words that may contain HTML entities to convert
+ * @param writer
+ * @param resultsPage
  */
-static void decodeHtmlEntities(vector<string> &words)
+static void writeResultsPage(PageWriter &writer, const ResultsPage &resultsPage)
 {
-    for (auto &word : words)
-    {
-        int startIndex = word.find("&#");
-
-        if (startIndex != string::npos)
-        {
-            int endIndex = startIndex + 4;
+    writer.write(PAGE_HEADER);
+    writer.writeHtmlEscaped(resultsPage.searchString);
+    writer.write(PAGE_SEARCH_END);
 
-            if (word[endIndex] != ';')
-                endIndex++;
+    // to_string() de un float también usa "%f"
+    char searchTime[32];
+    snprintf(searchTime, sizeof(searchTime), "%f", resultsPage.searchTime);
 
-            int code = stoi(word.substr(startIndex + 2, endIndex - 1));
+    writer.write("<div class=\"results\">");
+    writer.writeNumber(resultsPage.matchCount);
+    writer.write(" results (");
+    writer.write(searchTime);
+    writer.write(" seconds):</div>");
 
-            string realChar;
+    writer.write(resultsPage.resultsHtml);
 
-            switch (code)
-            {
-            case 225:
-                realChar = "á";
-                break;
-            case 233:
-                realChar = "é";
-                break;
-            case 237:
-                realChar = "í";
-                break;
-            case 243:
-                realChar = "ó";
-                break;
-            case 250:
-                realChar = "ú";
-                break;
-            case 63:
-                realChar = "?";
-                break;
-            case 191:
-                realChar = "¿";
-                break;
-            case 33:
-                realChar = "!";
-                break;
-            case 161:
-                realChar = "¡";
-                break;
-            default:
-                break;
-            }
+    writePageLinks(writer, resultsPage.searchString, resultsPage.anyWord,
+                   resultsPage.offset, resultsPage.limit, resultsPage.hasNextPage);
+    writer.write(PAGE_TRAILER);
+}
 
-            word.replace(startIndex, (code <= 99) ? 5 : 6, realChar);
-        }
-    }
+/**
+ * @brief Writes a link to a result
+ *
+ * @param writer
+ * @param path
+ */
+static void writeResult(PageWriter &writer, string_view path)
+{
+    writer.write("<div class=\"result\"><a href=\"");
+    writer.writeHtmlEscaped(path);
+    writer.write("\">");
+    writer.writeHtmlEscaped(path);
+    writer.write("</a></div>");
 }
 
 /**
- * @brief convert an Unicode character to a HTML entity
+ * @brief Writes the links to the previous and next pages of results
  *
- * @param words     Words which may contain the characters to be converted
+ * @param writer
+ * @param searchString
+ * @param anyWord
+ * @param offset        of the current page
+ * @param limit         results per page
+ * @param hasNextPage
  */
-static void encodeHtmlEntities(vector<string> &words)
+static void writePageLinks(PageWriter &writer, string_view searchString, bool anyWord,
+                           size_t offset, size_t limit, bool hasNextPage)
 {
-    for (auto &word : words)
+    for (int i = 0; i < 2; i++)
     {
-        int entitieIndex;
-
-        if ((entitieIndex = word.find("á")) != string::npos)
-            word.replace(entitieIndex, 1, "&#225;");
-        if ((entitieIndex = word.find("é")) != string::npos)
-            word.replace(entitieIndex, 1, "&#233;");
-        if ((entitieIndex = word.find("í")) != string::npos)
-            word.replace(entitieIndex, 0, "&#237;");
-        if ((entitieIndex = word.find("ó")) != string::npos)
-            word.replace(entitieIndex, 1, "&#243;");
-        if ((entitieIndex = word.find("ú")) != string::npos)
-            word.replace(entitieIndex, 1, "&#250;");
-
-        if ((entitieIndex = word.find("?")) != string::npos)
-            word.replace(entitieIndex, 1, "&#63;");
-        if ((entitieIndex = word.find("¿")) != string::npos)
-            word.replace(entitieIndex, 1, "&#191;");
-
-        if ((entitieIndex = word.find("!")) != string::npos)
-            word.replace(entitieIndex, 1, "&#33;");
-        if ((entitieIndex = word.find("¡")) != string::npos)
-            word.replace(entitieIndex, 1, "&#161;");
+        bool isNext = (i == 1);
+        if (isNext ? !hasNextPage : offset == 0)
+            continue;
+
+        writer.write("<div class=\"result\"><a href=\"/search?q=");
+        writer.writeUrlArgument(searchString);
+        if (anyWord)
+            writer.write("&amp;mode=or");
+        writer.write("&amp;offset=");
+        writer.writeNumber(isNext ? offset + limit : offset - min(offset, limit));
+        writer.write("&amp;limit=");
+        writer.writeNumber(limit);
+        writer.write(isNext ? "\">Siguiente &gt;</a></div>" : "\">&lt; Anterior</a></div>");
     }
 }
 
 /**
- * @brief Saves in disk the search index
+ * @brief Construct a new SearchResultsStream
  *
+ * @param searchIndex
+ * @param searchString
+ * @param mode
+ * @param offset        number of matches to skip
+ * @param limit         maximum number of results
  */
+SearchResultsStream::SearchResultsStream(shared_ptr<const IndexSnapshot> searchIndex, const string &searchString,
+                                         SearchMode mode, size_t offset, size_t limit)
+{
+    this->searchIndex = searchIndex;
+    this->searchString = searchString;
+    anyWord = (mode == SEARCH_ANY_WORD);
+    this->offset = offset;
+    this->limit = limit;
+
+    searchIndex->openMatches(searchString, mode, matches);
+    matchPosition = 0;
+    isStarted = false;
+    isFinished = false;
+
+    partPosition = 0;
+}
 
-void EDAoogleHttpRequestHandler::printSearchIndex()
+size_t SearchResultsStream::read(char *buffer, size_t size)
 {
-    ofstream file("searchIndex.txt");
+    size_t length = 0;
 
-    if (file.is_open())
+    while (length < size)
     {
-        for (auto word : searchIndex)
+        if (partPosition == part.size())
         {
-            file << word.first << " ";
-
-            for (auto it = word.second.begin(); it != word.second.end(); it++)
-                file << it->data() << " ";
+            if (isFinished)
+                break;
 
-            file << endl;
+            writeNextPart();
+            continue;
         }
+
+        size_t partLength = min(size - length, part.size() - partPosition);
+        memcpy(buffer + length, part.data() + partPosition, partLength);
+
+        length += partLength;
+        partPosition += partLength;
     }
 
-    file.close();
+    return length;
 }
 
 /**
- * @brief Checks if the index exists and in that case, it reads it
+ * @brief Writes the header, the next few results, or the trailer
  *
- * @return true if the search was read
- * @return false if the index does not exist
  */
-bool EDAoogleHttpRequestHandler::loadSearchIndex()
+void SearchResultsStream::writeNextPart()
 {
-    ifstream file("searchIndex.txt");
+    part.clear();
+    partPosition = 0;
+
+    PageWriter writer(part);
 
-    if (file.is_open())
+    if (!isStarted)
     {
-        cout << "Leyendo índice..." << endl;
+        writer.write(PAGE_HEADER);
+        writer.writeHtmlEscaped(searchString);
+        writer.write(PAGE_SEARCH_END);
+        writer.write("<div class=\"results\">Results from ");
+        writer.writeNumber(offset + 1);
+        writer.write(", unranked:</div>");
+
+        isStarted = true;
+        return;
+    }
 
-        string tempStr;
+    DocId docIds[STREAM_CHUNK_RESULTS];
+    size_t count = matches.next(docIds, STREAM_CHUNK_RESULTS);
 
-        while (getline(file, tempStr))
+    bool hasNextPage = false;
+    for (size_t i = 0; i < count; i++, matchPosition++)
+    {
+        if (matchPosition >= offset + limit)
         {
-            size_t startIndex = 0;
-            size_t endIndex = tempStr.find_first_of(' ');
+            hasNextPage = true;
+            break;
+        }
 
-            string word = tempStr.substr(startIndex, endIndex - startIndex);
+        if (matchPosition >= offset)
+            writeResult(writer, searchIndex->getDocument(docIds[i]).path);
+    }
 
-            startIndex = endIndex + 1;
+    if (!count || hasNextPage)
+    {
+        writePageLinks(writer, searchString, anyWord, offset, limit, hasNextPage);
+        writer.write(PAGE_TRAILER);
 
-            while ((endIndex = tempStr.find(' ', startIndex)) != string::npos)
-            {
-                searchIndex[word].insert(tempStr.substr(startIndex, endIndex - startIndex));
-                startIndex = endIndex + 1;
-            }
-        }
+        isFinished = true;
+    }
+}
 
-        cout << "Índice leído..." << endl;
-        return true;
+/**
+ * @brief Construct a new PageWriter
+ *
+ * @param output    the page is added at its end
+ */
+PageWriter::PageWriter(vector<char> &output) : output(output)
+{
+}
+
+void PageWriter::write(string_view text)
+{
+    output.insert(output.end(), text.begin(), text.end());
+}
+
+void PageWriter::writeNumber(size_t value)
+{
+    char text[24];
+    auto result = to_chars(text, text + sizeof(text), value);
+
+    write(string_view(text, result.ptr - text));
+}
+
+/**
+ * @brief Writes text so that it can go in an HTML element or attribute
+ *
+ * @param text
+ */
+void PageWriter::writeHtmlEscaped(string_view text)
+{
+    size_t start = 0;
+    while (start < text.size())
+    {
+        // Los tramos sin caracteres especiales se copian de una vez
+        size_t end = start;
+        while (end < text.size() && !HTML_ENTITIES[(unsigned char)text[end]])
+            end++;
+
+        write(text.substr(start, end - start));
+
+        if (end < text.size())
+            write(HTML_ENTITIES[(unsigned char)text[end]]);
+
+        start = end + 1;
     }
+}
 
-    cout << "No existe índice. Creándolo..." << endl;
-    return false;
-}
\ No newline at end of file
+/**
+ * @brief Percent-encodes a value to use it in a URL
+ *
+ * @param value
+ */
+void PageWriter::writeUrlArgument(string_view value)
+{
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+    for (unsigned char c : value)
+    {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+            write(string_view((const char *)&c, 1));
+        else
+        {
+            char encoded[3] = {'%', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xf]};
+            write(string_view(encoded, sizeof(encoded)));
+        }
+    }
+}
@@ -11,24 +11,38 @@
 #ifndef EDAOOGLEHTTPREQUESTHANDLER_H
 #define EDAOOGLEHTTPREQUESTHANDLER_H
 
+#include "DirectoryWatcher.h"
+#include "QueryCache.h"
+#include "SegmentedIndex.h"
 #include "ServeHttpRequestHandler.h"
-#include <unordered_map>
-#include <unordered_set>
+#include "ServerMetrics.h"
 
 class EDAoogleHttpRequestHandler : public ServeHttpRequestHandler
 {
 public:
-    EDAoogleHttpRequestHandler(std::string homePath);
+    EDAoogleHttpRequestHandler(std::string homePath, const SearchIndexOptions &options,
+                               size_t fileCacheSize);
 
-    bool handleRequest(std::string url, HttpArguments arguments, std::vector<char> &response);
+    bool handleRequest(std::string url, HttpArguments arguments, HttpResponse &response);
+    void handleResponseSent(uint64_t sentBytes, double milliseconds);
+
+    bool watchPages();
+    void updateSearchIndex();
+
+    const QueryCache &getQueryCache() const;
+    const ServerMetrics &getMetrics() const;
 
 private:
-    void matchSearch(std::string &searchString, std::vector<std::string> &results);
-    void buildSearchIndex();
-    void printSearchIndex();
-    bool loadSearchIndex();
+    void writeMetrics(std::string &text);
+
+    // Cada búsqueda usa el snapshot que había al empezar, aunque el índice se
+    // actualice mientras tanto
+    SegmentedIndex searchIndex;
+    QueryCache queryCache;
+    ServerMetrics metrics;
 
-    std::unordered_map<std::string, std::unordered_set<std::string>> searchIndex;
+    // Último, para que su hilo termine antes de destruir el resto
+    DirectoryWatcher pageWatcher;
 };
 
 #endif
@@ -0,0 +1,125 @@
+/**
+ * @file FileCache.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief LRU cache of file contents
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <fstream>
+
+#include "FileCache.h"
+
+using namespace std;
+
+// Un archivo no puede ocupar más que esta fracción del cache
+static const size_t MAX_FILE_FRACTION = 8;
+
+/**
+ * @brief Construct a new FileCache
+ *
+ * @param capacity  maximum bytes of file contents kept in memory
+ */
+FileCache::FileCache(size_t capacity)
+{
+    this->capacity = capacity;
+    size = 0;
+}
+
+/**
+ * @brief Gets the contents of a file, reading it if it is not cached or if it
+ *        changed since it was read
+ *
+ * @param path
+ * @param modificationTime  as the file system reports it now, in nanoseconds
+ * @param fileSize          as the file system reports it now
+ * @return FileContents     NULL if the file can't be read
+ */
+FileContents FileCache::get(const string &path, uint64_t modificationTime, size_t fileSize)
+{
+    {
+        lock_guard<mutex> lock(entriesMutex);
+
+        auto i = entriesByPath.find(path);
+        if (i != entriesByPath.end())
+        {
+            auto entry = i->second;
+            if (entry->modificationTime == modificationTime && entry->contents->size() == fileSize)
+            {
+                entries.splice(entries.begin(), entries, entry);
+
+                return entry->contents;
+            }
+        }
+    }
+
+    // Se lee sin el lock, para no frenar a los otros hilos
+    ifstream file(path, ios::binary);
+    if (file.fail())
+        return NULL;
+
+    auto contents = make_shared<vector<char>>(fileSize);
+    file.read(contents->data(), fileSize);
+    contents->resize(file.gcount());
+
+    if (contents->size() <= getMaxFileSize())
+        insert({path, modificationTime, contents});
+
+    return contents;
+}
+
+/**
+ * @brief Files larger than this are not cached
+ *
+ * @return size_t
+ */
+size_t FileCache::getMaxFileSize() const
+{
+    return capacity / MAX_FILE_FRACTION;
+}
+
+/**
+ * @brief Bytes of file contents in the cache
+ *
+ * @return size_t
+ */
+size_t FileCache::getSize()
+{
+    lock_guard<mutex> lock(entriesMutex);
+
+    return size;
+}
+
+/**
+ * @brief Adds or replaces a file, and removes the least recently used ones
+ *        until the cache fits in its capacity
+ *
+ * @param entry
+ */
+void FileCache::insert(Entry &&entry)
+{
+    lock_guard<mutex> lock(entriesMutex);
+
+    auto i = entriesByPath.find(entry.path);
+    if (i != entriesByPath.end())
+    {
+        size -= i->second->contents->size();
+        entries.erase(i->second);
+        entriesByPath.erase(i);
+    }
+
+    size += entry.contents->size();
+    entries.push_front(move(entry));
+    entriesByPath[entries.front().path] = entries.begin();
+
+    while (size > capacity)
+    {
+        Entry &leastRecentlyUsed = entries.back();
+
+        size -= leastRecentlyUsed.contents->size();
+        entriesByPath.erase(leastRecentlyUsed.path);
+        entries.pop_back();
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file FileCache.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief LRU cache of file contents
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef std::shared_ptr<const std::vector<char>> FileContents;
+
+/**
+ * @brief Keeps the most recently used files in memory, up to a byte budget
+ *
+ * El contenido se comparte con shared_ptr: una respuesta que todavía se está
+ * enviando sigue siendo válida aunque el archivo salga del cache. Se puede usar
+ * desde varios hilos a la vez.
+ */
+class FileCache
+{
+public:
+    FileCache(size_t capacity);
+
+    FileContents get(const std::string &path, uint64_t modificationTime, size_t fileSize);
+
+    size_t getMaxFileSize() const;
+    size_t getSize();
+
+private:
+    struct Entry
+    {
+        std::string path;
+        uint64_t modificationTime;  // en nanosegundos
+        FileContents contents;
+    };
+
+    void insert(Entry &&entry);
+
+    std::mutex entriesMutex;
+
+    // El más usado primero
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> entriesByPath;
+
+    size_t capacity;
+    size_t size;
+};
+
+#endif
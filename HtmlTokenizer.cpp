@@ -0,0 +1,252 @@
+/**
+ * @file HtmlTokenizer.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Single pass HTML tokenizer
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <cctype>
+
+#include "HtmlTokenizer.h"
+#include "TextNormalizer.h"
+
+using namespace std;
+
+static bool startsWithIgnoreCase(string_view text, size_t position, string_view prefix);
+static size_t findIgnoreCase(string_view text, string_view pattern, size_t position);
+
+/**
+ * @brief Construct a new HtmlTokenizer
+ *
+ * @param html  the whole page. It must outlive the tokenizer
+ */
+HtmlTokenizer::HtmlTokenizer(string_view html)
+{
+    this->html = html;
+    position = 0;
+}
+
+/**
+ * @brief Finds the next word of the page
+ *
+ * @param token     the word, valid until the next call
+ * @return true if there was another word
+ */
+bool HtmlTokenizer::next(string_view &token)
+{
+    while (position < html.size())
+    {
+        char c = html[position];
+
+        if (c == '<')
+            skipMarkup();
+        else if (isWordByte(c))
+        {
+            readWord(token);
+            return true;
+        }
+        else if (c == '&')
+        {
+            // Una palabra puede empezar con una entidad, como "&#193;frica"
+            uint32_t codepoint;
+            size_t length = decodeHtmlEntity(html, position, codepoint);
+            if (length && isWordCodepoint(codepoint))
+            {
+                readWord(token);
+                return true;
+            }
+
+            position += length ? length : 1;
+        }
+        else
+            position++;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Text of the first <title> element, as it is in the page
+ *
+ * @return string_view  empty until the tokenizer gets past the <title> tag
+ */
+string_view HtmlTokenizer::getTitle() const
+{
+    return title;
+}
+
+/**
+ * @brief Reads a word that starts at the current position
+ *
+ * @param token
+ */
+void HtmlTokenizer::readWord(string_view &token)
+{
+    size_t segmentStart = position;
+    bool isBuffered = false;
+
+    while (position < html.size())
+    {
+        char c = html[position];
+
+        if (isWordByte(c))
+        {
+            position++;
+            continue;
+        }
+
+        if (c != '&')
+            break;
+
+        // Las entidades que no son letras ni dígitos terminan la palabra
+        uint32_t codepoint;
+        size_t length = decodeHtmlEntity(html, position, codepoint);
+        if (!length || !isWordCodepoint(codepoint))
+            break;
+
+        if (!isBuffered)
+        {
+            buffer.clear();
+            isBuffered = true;
+        }
+
+        char text[4];
+        buffer.append(html.substr(segmentStart, position - segmentStart));
+        buffer.append(text, encodeUtf8(codepoint, text));
+
+        position += length;
+        segmentStart = position;
+    }
+
+    if (isBuffered)
+    {
+        buffer.append(html.substr(segmentStart, position - segmentStart));
+        token = buffer;
+    }
+    else
+        token = html.substr(segmentStart, position - segmentStart);
+}
+
+/**
+ * @brief Skips a tag or a comment that starts at the current position, and
+ *        the content of <script> and <style>
+ *
+ */
+void HtmlTokenizer::skipMarkup()
+{
+    if (startsWithIgnoreCase(html, position, "<!--"))
+    {
+        size_t end = html.find("-->", position + 4);
+        position = (end == string_view::npos) ? html.size() : end + 3;
+        return;
+    }
+
+    char next = (position + 1 < html.size()) ? html[position + 1] : '\0';
+
+    // <!DOCTYPE ...>, <?xml ...>
+    if (next == '!' || next == '?')
+    {
+        skipTag();
+        return;
+    }
+
+    bool isClosingTag = (next == '/');
+    size_t nameStart = position + (isClosingTag ? 2 : 1);
+
+    // Un '<' que no empieza una etiqueta es parte del texto
+    if (nameStart >= html.size() || !isalpha((unsigned char)html[nameStart]))
+    {
+        position++;
+        return;
+    }
+
+    size_t nameEnd = nameStart;
+    while (nameEnd < html.size() && isalnum((unsigned char)html[nameEnd]))
+        nameEnd++;
+
+    string_view name = html.substr(nameStart, nameEnd - nameStart);
+
+    position = nameEnd;
+    skipTag();
+
+    bool isSelfClosing = (html[position - 1] == '>' && html[position - 2] == '/');
+    if (isClosingTag || isSelfClosing)
+        return;
+
+    if (name.size() == 6 && startsWithIgnoreCase(name, 0, "script"))
+    {
+        size_t end = findIgnoreCase(html, "</script", position);
+        position = (end == string_view::npos) ? html.size() : end;
+    }
+    else if (name.size() == 5 && startsWithIgnoreCase(name, 0, "style"))
+    {
+        size_t end = findIgnoreCase(html, "</style", position);
+        position = (end == string_view::npos) ? html.size() : end;
+    }
+    else if (name.size() == 5 && startsWithIgnoreCase(name, 0, "title") && title.empty())
+    {
+        // Las palabras del título también se indexan, así que no se saltea
+        size_t end = findIgnoreCase(html, "</title", position);
+        title = html.substr(position, (end == string_view::npos) ? string_view::npos : end - position);
+    }
+}
+
+/**
+ * @brief Moves past the '>' that ends the current tag, ignoring the ones in
+ *        quoted attributes
+ *
+ */
+void HtmlTokenizer::skipTag()
+{
+    while (position < html.size())
+    {
+        char c = html[position++];
+
+        if (c == '>')
+            return;
+
+        if (c == '"' || c == '\'')
+        {
+            size_t end = html.find(c, position);
+            position = (end == string_view::npos) ? html.size() : end + 1;
+        }
+    }
+}
+
+static bool startsWithIgnoreCase(string_view text, size_t position, string_view prefix)
+{
+    if (text.size() - position < prefix.size())
+        return false;
+
+    for (size_t i = 0; i < prefix.size(); i++)
+    {
+        if (tolower((unsigned char)text[position + i]) != tolower((unsigned char)prefix[i]))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Finds a pattern that starts with '<', ignoring case
+ *
+ * @param text
+ * @param pattern
+ * @param position  where to start looking
+ * @return size_t   where the pattern is, or npos
+ */
+static size_t findIgnoreCase(string_view text, string_view pattern, size_t position)
+{
+    while ((position = text.find(pattern[0], position)) != string_view::npos)
+    {
+        if (startsWithIgnoreCase(text, position, pattern))
+            return position;
+
+        position++;
+    }
+
+    return string_view::npos;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file HtmlTokenizer.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Single pass HTML tokenizer
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef HTMLTOKENIZER_H
+#define HTMLTOKENIZER_H
+
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Splits the text of an HTML page in words, in a single pass over the
+ *        whole page
+ *
+ * Saltea las etiquetas, los comentarios y el contenido de <script> y <style>,
+ * aunque ocupen varias líneas. Las palabras se devuelven como string_view sobre
+ * la página, sin copiarlas; solo las que tienen entidades HTML se arman en un
+ * buffer interno. Las palabras todavía no están normalizadas (ver
+ * TextNormalizer.h), y pueden contener puntuación que no es ASCII.
+ */
+class HtmlTokenizer
+{
+public:
+    HtmlTokenizer(std::string_view html);
+
+    bool next(std::string_view &token);
+    std::string_view getTitle() const;
+
+private:
+    void readWord(std::string_view &token);
+    void skipMarkup();
+    void skipTag();
+
+    std::string_view html;
+    size_t position;
+    std::string_view title;
+    std::string buffer;
+};
+
+#endif
@@ -8,10 +8,45 @@
  *
  */
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <chrono>
+
 #include "HttpServer.h"
 
 using namespace std;
 
+// Bytes que libmicrohttpd le pide a un stream por vez
+static const size_t STREAM_BLOCK_SIZE = 32 * 1024;
+
+// Un pedido cuya respuesta se está enviando
+struct HttpRequestState
+{
+    HttpRequestHandler *httpRequestHandler;
+    chrono::steady_clock::time_point queueTime;
+    uint64_t sentBytes;
+};
+
+// Lo que queda en *con_cls entre la llamada con los headers y la siguiente.
+// Solo importa su dirección, que nunca es la de un HttpRequestState
+static char headersReceivedMark;
+
+// El cls de un stream: el stream, y el pedido al que le cuenta los bytes
+struct HttpStreamState
+{
+    HttpResponseStream *stream;
+    HttpRequestState *requestState;
+};
+
+static MHD_Response *createMhdResponse(HttpResponse &response, HttpRequestState *requestState);
+static void releaseSharedBody(void *cls);
+static ssize_t readStream(void *cls, uint64_t position, char *buffer, size_t size);
+static void releaseStream(void *cls);
+
 /**
  * @brief GetArgument callback for libmicrohttp
  *
@@ -60,11 +95,12 @@ MHD_Result httpRequestHandlerCallback(void *cls,
                                       void **con_cls)
 {
     HttpServer *server = (HttpServer *)cls;
+    HttpRequestHandler *httpRequestHandler = server->httpRequestHandler;
 
     // Headers are invalid on first call, wait for second call.
-    if (con_cls == NULL)
+    if (*con_cls == NULL)
     {
-        *con_cls = cls;
+        *con_cls = &headersReceivedMark;
 
         return MHD_YES;
     }
@@ -78,7 +114,7 @@ MHD_Result httpRequestHandlerCallback(void *cls,
 
         // Make response
         int statusCode;
-        vector<char> response;
+        HttpResponse response;
 
         // Clean URL
         string cleanedUrl = url;
@@ -89,40 +125,104 @@ MHD_Result httpRequestHandlerCallback(void *cls,
         if (cleanedUrl.back() == '/')
             cleanedUrl += "index.html";
 
-        if (server->httpRequestHandler &&
-            server->httpRequestHandler->handleRequest(cleanedUrl, arguments, response))
-            statusCode = MHD_HTTP_FOUND;
+        if (httpRequestHandler &&
+            httpRequestHandler->handleRequest(cleanedUrl, arguments, response))
+            statusCode = response.statusCode;
         else
         {
             statusCode = MHD_HTTP_NOT_FOUND;
 
             string errorResponse = "<html><body><h1>404 Not Found</h1></body></html>";
-            response.assign(errorResponse.begin(), errorResponse.end());
+            response = HttpResponse();
+            response.body.assign(errorResponse.begin(), errorResponse.end());
+        }
+
+        // Se mide desde acá hasta httpRequestCompletedCallback()
+        HttpRequestState *requestState = new HttpRequestState{httpRequestHandler,
+                                                              chrono::steady_clock::now(),
+                                                              0};
+
+        MHD_Response *mhdResponse = createMhdResponse(response, requestState);
+        if (!mhdResponse)
+        {
+            delete requestState;
+            return MHD_NO;
         }
 
-        MHD_Response *mhdResponse = MHD_create_response_from_buffer(response.size(),
-                                                                    (void *)response.data(),
-                                                                    MHD_RESPMEM_MUST_COPY);
+        if (!response.contentType.empty())
+            MHD_add_response_header(mhdResponse, MHD_HTTP_HEADER_CONTENT_TYPE, response.contentType.c_str());
+
         bool isResponseQueued = MHD_queue_response(connection, statusCode, mhdResponse);
         MHD_destroy_response(mhdResponse);
 
-        return isResponseQueued ? MHD_YES : MHD_NO;
+        if (!isResponseQueued)
+        {
+            delete requestState;
+            return MHD_NO;
+        }
+
+        *con_cls = requestState;
+
+        return MHD_YES;
     }
 
     return MHD_NO;
 }
 
-HttpServer::HttpServer(int port)
+/**
+ * @brief Request completed callback for libmicrohttpd: tells the handler how
+ *        long the response took to send
+ *
+ * @param cls The server object
+ * @param connection The connection
+ * @param con_cls The HttpRequestState of the request, if a response was queued
+ * @param toe Why the request ended
+ */
+static void httpRequestCompletedCallback(void * /*cls*/,
+                                         struct MHD_Connection * /*connection*/,
+                                         void **con_cls,
+                                         enum MHD_RequestTerminationCode /*toe*/)
+{
+    // Sin respuesta encolada no hay un HttpRequestState que liberar
+    if (*con_cls == NULL || *con_cls == &headersReceivedMark)
+        return;
+
+    HttpRequestState *requestState = (HttpRequestState *)*con_cls;
+
+    chrono::duration<double, milli> sendTime = chrono::steady_clock::now() - requestState->queueTime;
+    if (requestState->httpRequestHandler)
+        requestState->httpRequestHandler->handleResponseSent(requestState->sentBytes, sendTime.count());
+
+    delete requestState;
+    *con_cls = NULL;
+}
+
+/**
+ * @brief Starts the server
+ *
+ * Con MHD_USE_AUTO libmicrohttpd elige epoll en Linux, o poll/select en el
+ * resto. Con más de un hilo, cada hilo del pool acepta y atiende conexiones.
+ *
+ * @param options   port, threads, connection limit and timeout
+ */
+HttpServer::HttpServer(const HttpServerOptions &options)
 {
-    daemon = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD,
-                              8000,
+    // Se inicializa antes de arrancar, porque los hilos ya pueden llamar al handler
+    httpRequestHandler = NULL;
+
+    unsigned int threadCount = options.threadCount ? options.threadCount : 1;
+
+    daemon = MHD_start_daemon(MHD_USE_AUTO_INTERNAL_THREAD,
+                              (uint16_t)options.port,
                               NULL,
                               NULL,
                               httpRequestHandlerCallback,
                               this,
+                              MHD_OPTION_THREAD_POOL_SIZE, threadCount,
+                              MHD_OPTION_CONNECTION_LIMIT, options.connectionLimit,
+                              MHD_OPTION_CONNECTION_TIMEOUT, options.connectionTimeout,
+                              MHD_OPTION_NOTIFY_COMPLETED, httpRequestCompletedCallback, this,
                               MHD_OPTION_END);
-
-    httpRequestHandler = NULL;
 }
 
 HttpServer::~HttpServer()
@@ -142,3 +242,100 @@ void HttpServer::setHttpRequestHandler(HttpRequestHandler *httpRequestHandler)
 {
     this->httpRequestHandler = httpRequestHandler;
 }
+
+/**
+ * @brief Makes a libmicrohttpd response without copying the body
+ *
+ * @param response  its body is moved to the returned response
+ * @param requestState  gets the size of the body, or counts it as it is sent
+ * @return MHD_Response*    NULL on error
+ */
+static MHD_Response *createMhdResponse(HttpResponse &response, HttpRequestState *requestState)
+{
+    if (response.stream)
+    {
+        // Sin tamaño conocido, HTTP/1.1 lo envía en chunks
+        HttpStreamState *streamState = new HttpStreamState{response.stream.release(), requestState};
+        MHD_Response *mhdResponse = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN,
+                                                                      STREAM_BLOCK_SIZE,
+                                                                      readStream,
+                                                                      streamState,
+                                                                      releaseStream);
+        if (!mhdResponse)
+            releaseStream(streamState);
+
+        return mhdResponse;
+    }
+
+    if (response.fileDescriptor >= 0)
+    {
+        MHD_Response *mhdResponse = MHD_create_response_from_fd(response.fileSize,
+                                                                response.fileDescriptor);
+        if (!mhdResponse)
+        {
+            close(response.fileDescriptor);
+            return NULL;
+        }
+
+        requestState->sentBytes = response.fileSize;
+
+        return mhdResponse;
+    }
+
+    // La respuesta guarda una referencia al contenido hasta que se termina de enviar
+    auto body = response.sharedBody
+                    ? new shared_ptr<const vector<char>>(response.sharedBody)
+                    : new shared_ptr<const vector<char>>(make_shared<vector<char>>(move(response.body)));
+
+    MHD_Response *mhdResponse = MHD_create_response_from_buffer_with_free_callback_cls((*body)->size(),
+                                                                                       (*body)->data(),
+                                                                                       releaseSharedBody,
+                                                                                       body);
+    if (!mhdResponse)
+    {
+        delete body;
+        return NULL;
+    }
+
+    requestState->sentBytes = (*body)->size();
+
+    return mhdResponse;
+}
+
+/**
+ * @brief Releases the body of a response, when libmicrohttpd is done with it
+ *
+ * @param cls   the shared_ptr to the body
+ */
+static void releaseSharedBody(void *cls)
+{
+    delete (shared_ptr<const vector<char>> *)cls;
+}
+
+/**
+ * @brief Content reader callback for libmicrohttpd
+ *
+ * @param cls       the HttpStreamState
+ * @param position  bytes already sent
+ * @param buffer
+ * @param size      space in buffer
+ * @return ssize_t  bytes written, or MHD_CONTENT_READER_END_OF_STREAM
+ */
+static ssize_t readStream(void *cls, uint64_t position, char *buffer, size_t size)
+{
+    HttpStreamState *streamState = (HttpStreamState *)cls;
+    size_t length = streamState->stream->read(buffer, size);
+
+    // Nunca se lee después de que termina el pedido, que es cuando se libera requestState
+    streamState->requestState->sentBytes = position + length;
+
+    return length ? (ssize_t)length : MHD_CONTENT_READER_END_OF_STREAM;
+}
+
+static void releaseStream(void *cls)
+{
+    HttpStreamState *streamState = (HttpStreamState *)cls;
+
+    delete streamState->stream;
+    delete streamState;
+}
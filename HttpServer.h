@@ -13,22 +13,85 @@
 
 #include <microhttpd.h>
 
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 typedef std::map<std::string, std::string> HttpArguments;
 
+/**
+ * @brief Body of a response that is generated while it is sent
+ */
+class HttpResponseStream
+{
+public:
+    virtual ~HttpResponseStream() {}
+
+    /**
+     * @brief Writes the next part of the body
+     *
+     * @param buffer
+     * @param size      space in buffer
+     * @return size_t   bytes written, 0 at the end of the body
+     */
+    virtual size_t read(char *buffer, size_t size) = 0;
+};
+
+/**
+ * @brief Status, type and body of an HTTP response
+ *
+ * El handler completa "body", o comparte un contenido que ya tiene en memoria
+ * con "sharedBody", o pasa un archivo abierto con "fileDescriptor" (que el
+ * servidor envía con sendfile y cierra), o lo va generando con "stream" a
+ * medida que se envía. Ninguna se copia.
+ */
+struct HttpResponse
+{
+    int statusCode = MHD_HTTP_OK;
+    std::string contentType;        // si está vacío, no se envía Content-Type
+    std::vector<char> body;
+    std::shared_ptr<const std::vector<char>> sharedBody;
+    int fileDescriptor = -1;
+    uint64_t fileSize = 0;
+    std::unique_ptr<HttpResponseStream> stream;
+};
+
 class HttpRequestHandler
 {
 public:
-    virtual bool handleRequest(std::string url, HttpArguments arguments, std::vector<char> &response) = 0;
+    virtual bool handleRequest(std::string url, HttpArguments arguments, HttpResponse &response) = 0;
+
+    /**
+     * @brief Called when a response was sent, or the connection was closed
+     *        before
+     *
+     * @param sentBytes     of the body
+     * @param milliseconds  since the response was queued
+     */
+    virtual void handleResponseSent(uint64_t /*sentBytes*/, double /*milliseconds*/) {}
+};
+
+struct HttpServerOptions
+{
+    unsigned int port;
+    unsigned int threadCount;       // hilos que atienden pedidos
+    unsigned int connectionLimit;   // conexiones abiertas al mismo tiempo
+    unsigned int connectionTimeout; // segundos sin actividad; 0 es sin límite
 };
 
+/**
+ * @brief HTTP server on a pool of threads
+ *
+ * Cada hilo atiende sus propias conexiones, así que el HttpRequestHandler se
+ * llama desde varios hilos a la vez y tiene que poder hacerlo.
+ */
 class HttpServer
 {
 public:
-    HttpServer(int port);
+    HttpServer(const HttpServerOptions &options);
     ~HttpServer();
 
     bool isRunning();
@@ -36,7 +99,7 @@ public:
 
 private:
     MHD_Daemon *daemon;
-    HttpRequestHandler *httpRequestHandler;
+    std::atomic<HttpRequestHandler *> httpRequestHandler;
 
     // Grant private access to libmicrohttp request handler
     friend MHD_Result httpRequestHandlerCallback(void *cls, struct MHD_Connection *connection,
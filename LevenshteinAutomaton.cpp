@@ -0,0 +1,153 @@
+/**
+ * @file LevenshteinAutomaton.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Recognizes the words at a bounded edit distance from another
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <algorithm>
+
+#include "LevenshteinAutomaton.h"
+#include "TextNormalizer.h"
+
+using namespace std;
+
+/**
+ * @brief Construct a new LevenshteinAutomaton
+ *
+ * @param term          normalized, in UTF-8
+ * @param maxDistance   at most MAX_EDIT_DISTANCE
+ */
+LevenshteinAutomaton::LevenshteinAutomaton(string_view term, uint32_t maxDistance)
+{
+    this->maxDistance = (uint8_t)min(maxDistance, MAX_EDIT_DISTANCE);
+
+    // Se compara por caracteres, no por bytes: cambiar una "ñ" es un cambio
+    size_t position = 0;
+    while (position < term.size())
+    {
+        uint32_t codepoint;
+        size_t length = decodeUtf8(term, position, codepoint);
+        if (!length)
+        {
+            codepoint = (unsigned char)term[position];
+            length = 1;
+        }
+
+        codepoints.push_back(codepoint);
+        position += length;
+    }
+}
+
+/**
+ * @brief Bytes of a state
+ *
+ * @return size_t
+ */
+size_t LevenshteinAutomaton::getStateSize() const
+{
+    return codepoints.size() + 1;
+}
+
+/**
+ * @brief The state before reading anything
+ *
+ * @param state     getStateSize() bytes
+ */
+void LevenshteinAutomaton::start(uint8_t *state) const
+{
+    for (size_t i = 0; i < getStateSize(); i++)
+        state[i] = (uint8_t)min(i, (size_t)maxDistance + 1);
+}
+
+/**
+ * @brief Reads one character
+ *
+ * @param state
+ * @param codepoint
+ * @param nextState     getStateSize() bytes, not the same as state
+ */
+void LevenshteinAutomaton::step(const uint8_t *state, uint32_t codepoint, uint8_t *nextState) const
+{
+    uint8_t limit = maxDistance + 1;
+
+    nextState[0] = min((uint8_t)(state[0] + 1), limit);
+
+    for (size_t i = 1; i < getStateSize(); i++)
+    {
+        uint8_t substitution = state[i - 1] + (codepoints[i - 1] != codepoint);
+        uint8_t insertion = state[i] + 1;
+        uint8_t deletion = nextState[i - 1] + 1;
+
+        nextState[i] = min(min(substitution, insertion), min(deletion, limit));
+    }
+}
+
+/**
+ * @brief Determines if some word that starts with what was read can match
+ *
+ * @param state
+ * @return true if some prefix of the term is still near enough
+ */
+bool LevenshteinAutomaton::canMatch(const uint8_t *state) const
+{
+    return *min_element(state, state + getStateSize()) <= maxDistance;
+}
+
+/**
+ * @brief Determines if what was read is near enough to the term
+ *
+ * @param state
+ * @return true if it is at most maxDistance edits away
+ */
+bool LevenshteinAutomaton::isMatch(const uint8_t *state) const
+{
+    return getDistance(state) <= maxDistance;
+}
+
+/**
+ * @brief Finds the smallest character after another that does not make a
+ *        state unable to match
+ *
+ * Si queda margen, cualquier caracter sirve, como inserción. Si no, solo los
+ * del término que coinciden justo donde la distancia es la máxima.
+ *
+ * @param state         that can match
+ * @param after
+ * @param codepoint
+ * @return true if there is one
+ */
+bool LevenshteinAutomaton::findNextCodepoint(const uint8_t *state, uint32_t after, uint32_t &codepoint) const
+{
+    if (*min_element(state, state + getStateSize()) < maxDistance)
+    {
+        codepoint = after + 1;
+        return codepoint <= MAX_CODEPOINT;
+    }
+
+    bool isFound = false;
+    for (size_t i = 0; i < codepoints.size(); i++)
+    {
+        if (state[i] <= maxDistance && codepoints[i] > after && (!isFound || codepoints[i] < codepoint))
+        {
+            codepoint = codepoints[i];
+            isFound = true;
+        }
+    }
+
+    return isFound;
+}
+
+/**
+ * @brief Edit distance between the term and what was read
+ *
+ * @param state
+ * @return uint32_t     more than maxDistance if the word does not match
+ */
+uint32_t LevenshteinAutomaton::getDistance(const uint8_t *state) const
+{
+    return state[codepoints.size()];
+}
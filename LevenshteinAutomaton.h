@@ -0,0 +1,53 @@
+/**
+ * @file LevenshteinAutomaton.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Recognizes the words at a bounded edit distance from another
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef LEVENSHTEINAUTOMATON_H
+#define LEVENSHTEINAUTOMATON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Más cambios encuentran casi cualquier palabra corta
+const uint32_t MAX_EDIT_DISTANCE = 2;
+
+const uint32_t MAX_CODEPOINT = 0x10ffff;
+
+/**
+ * @brief Automaton that accepts the words at most maxDistance insertions,
+ *        deletions or substitutions away from a term
+ *
+ * Cada estado es una fila de la matriz de Levenshtein: la distancia entre cada
+ * prefijo del término y lo leído hasta ahora, acotada a maxDistance + 1. Los
+ * estados se calculan a medida que se leen caracteres, así que no hace falta
+ * armar el autómata entero; quien lo recorre guarda los estados de cada
+ * prefijo para no volver a leerlo.
+ */
+class LevenshteinAutomaton
+{
+public:
+    LevenshteinAutomaton(std::string_view term, uint32_t maxDistance);
+
+    size_t getStateSize() const;
+    void start(uint8_t *state) const;
+    void step(const uint8_t *state, uint32_t codepoint, uint8_t *nextState) const;
+
+    bool canMatch(const uint8_t *state) const;
+    bool isMatch(const uint8_t *state) const;
+    bool findNextCodepoint(const uint8_t *state, uint32_t after, uint32_t &codepoint) const;
+    uint32_t getDistance(const uint8_t *state) const;
+
+private:
+    std::vector<uint32_t> codepoints;
+    uint8_t maxDistance;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/**
+ * @file MappedFile.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Read-only memory mapped file
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+using namespace std;
+
+MappedFile::MappedFile()
+{
+    data = NULL;
+    size = 0;
+
+#ifdef _WIN32
+    fileHandle = NULL;
+    mappingHandle = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+/**
+ * @brief Maps a whole file in memory, read-only
+ *
+ * @param filename
+ * @return true if the file was mapped
+ * @return false if the file does not exist, is empty or can't be mapped
+ */
+bool MappedFile::open(const string &filename)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = (const char *)view;
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // El mapeo sigue siendo válido después de cerrar el descriptor
+    ::close(fd);
+
+    if (view == MAP_FAILED)
+        return false;
+
+    data = (const char *)view;
+    size = (size_t)fileStat.st_size;
+#endif
+
+    return true;
+}
+
+/**
+ * @brief Unmaps the file. Pointers returned by getData() become invalid
+ *
+ */
+void MappedFile::close()
+{
+    if (!data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+
+    fileHandle = NULL;
+    mappingHandle = NULL;
+#else
+    munmap((void *)data, size);
+#endif
+
+    data = NULL;
+    size = 0;
+}
+
+const char *MappedFile::getData() const
+{
+    return data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return size;
+}
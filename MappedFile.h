@@ -0,0 +1,42 @@
+/**
+ * @file MappedFile.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Read-only memory mapped file
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &filename);
+    void close();
+
+    const char *getData() const;
+    size_t getSize() const;
+
+private:
+    const char *data;
+    size_t size;
+
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#endif
+};
+
+#endif
@@ -0,0 +1,675 @@
+/**
+ * @file PostingCodec.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Compressed posting lists
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+
+#include "PostingCodec.h"
+
+using namespace std;
+
+// Posición del bit en 1 menos significativo de cada byte
+static const uint8_t LOWEST_BIT[256] = {
+    0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+    5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+};
+
+static void encodeVarintBlock(const DocId *docIds, size_t count, DocId base, vector<uint8_t> &output);
+static void encodeBitpackBlock(const DocId *docIds, size_t count, DocId base, vector<uint8_t> &output);
+static void decodeVarintBlock(const uint8_t *input, size_t count, DocId base, DocId *output);
+static void decodeBitpackBlock(const uint8_t *input, size_t count, DocId base, DocId *output);
+static void alignOutput(vector<uint8_t> &output);
+
+/**
+ * @brief Converts the name used in the command line to a codec
+ *
+ * @param name      "raw", "varint" or "bitpack"
+ * @param codec
+ * @return true if the name is valid
+ */
+bool parsePostingCodec(const string &name, PostingCodec &codec)
+{
+    if (name == "raw")
+        codec = POSTING_CODEC_RAW;
+    else if (name == "varint")
+        codec = POSTING_CODEC_VARINT;
+    else if (name == "bitpack")
+        codec = POSTING_CODEC_BITPACK;
+    else
+        return false;
+
+    return true;
+}
+
+const char *getPostingCodecName(PostingCodec codec)
+{
+    switch (codec)
+    {
+    case POSTING_CODEC_RAW:
+        return "raw";
+    case POSTING_CODEC_VARINT:
+        return "varint";
+    case POSTING_CODEC_BITPACK:
+        return "bitpack";
+    }
+
+    return "";
+}
+
+/**
+ * @brief Appends the docIds whose bits are set in a range of a bitmap
+ *
+ * @param bitmap
+ * @param firstByte
+ * @param lastByte      one past the last byte
+ * @param output
+ */
+void appendBitmapDocIds(const uint8_t *bitmap, size_t firstByte, size_t lastByte,
+                        vector<DocId> &output)
+{
+    for (size_t byte = firstByte; byte < lastByte; byte++)
+    {
+        for (unsigned int bits = bitmap[byte]; bits; bits &= bits - 1)
+            output.push_back((DocId)(byte * 8 + LOWEST_BIT[bits]));
+    }
+}
+
+/**
+ * @brief Appends a sorted posting list to output
+ *
+ * Supone que output empieza alineado a 4 bytes, porque la tabla de saltos y
+ * las listas sin comprimir se leen como uint32_t.
+ *
+ * @param docIds
+ * @param count
+ * @param codec
+ * @param documentCount     number of documents in the index, for bitmaps
+ * @param output
+ * @param offset            where the list starts in output
+ * @return PostingEncoding  how the list was stored
+ */
+PostingEncoding encodePostings(const DocId *docIds, size_t count,
+                               PostingCodec codec, uint32_t documentCount,
+                               vector<uint8_t> &output, size_t &offset)
+{
+    if (codec == POSTING_CODEC_RAW)
+    {
+        alignOutput(output);
+
+        offset = output.size();
+        output.resize(offset + count * sizeof(DocId));
+        if (count)
+            memcpy(output.data() + offset, docIds, count * sizeof(DocId));
+
+        return POSTING_ENCODING_RAW;
+    }
+
+    size_t blockCount = (count + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+
+    // Se reusan entre llamadas: al guardar un índice se codifica una lista por
+    // término, y pedir memoria para cada una era casi todo lo que se pedía
+    static thread_local vector<uint32_t> skipTable;
+    static thread_local vector<uint8_t> blockData;
+    skipTable.clear();
+    blockData.clear();
+
+    for (size_t block = 0; block < blockCount; block++)
+    {
+        size_t first = block * POSTING_BLOCK_SIZE;
+        size_t blockSize = min(POSTING_BLOCK_SIZE, count - first);
+        DocId base = block ? docIds[first - 1] : 0;
+
+        skipTable.push_back(docIds[first + blockSize - 1]);
+        skipTable.push_back((uint32_t)blockData.size());
+
+        if (codec == POSTING_CODEC_VARINT)
+            encodeVarintBlock(docIds + first, blockSize, base, blockData);
+        else
+            encodeBitpackBlock(docIds + first, blockSize, base, blockData);
+    }
+
+    // Las listas de un solo bloque no llevan tabla de saltos
+    if (blockCount == 1)
+        skipTable.clear();
+
+    size_t encodedSize = skipTable.size() * sizeof(uint32_t) + blockData.size();
+    size_t bitmapSize = (documentCount + 7) / 8;
+
+    if (bitmapSize < encodedSize)
+    {
+        offset = output.size();
+        output.resize(offset + bitmapSize, 0);
+
+        for (size_t i = 0; i < count; i++)
+            output[offset + docIds[i] / 8] |= (uint8_t)(1 << (docIds[i] % 8));
+
+        return POSTING_ENCODING_BITMAP;
+    }
+
+    if (!skipTable.empty())
+        alignOutput(output);
+
+    offset = output.size();
+
+    if (!skipTable.empty())
+    {
+        output.resize(offset + skipTable.size() * sizeof(uint32_t));
+        memcpy(output.data() + offset, skipTable.data(), skipTable.size() * sizeof(uint32_t));
+    }
+
+    output.insert(output.end(), blockData.begin(), blockData.end());
+
+    return (codec == POSTING_CODEC_VARINT) ? POSTING_ENCODING_VARINT : POSTING_ENCODING_BITPACK;
+}
+
+/**
+ * @brief Appends a number using 7 bits per byte; the high bit marks that more
+ *        bytes follow
+ *
+ * @param value
+ * @param output
+ */
+void writeVarint(uint32_t value, vector<uint8_t> &output)
+{
+    encodeVarintBlock(&value, 1, 0, output);
+}
+
+/**
+ * @brief Reads a number written by writeVarint()
+ *
+ * @param input
+ * @param value
+ * @return const uint8_t*   where the next value starts
+ */
+const uint8_t *readVarint(const uint8_t *input, uint32_t &value)
+{
+    value = 0;
+    int shift = 0;
+
+    while (*input & 0x80)
+    {
+        value |= (uint32_t)(*input++ & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= (uint32_t)(*input++) << shift;
+
+    return input;
+}
+
+/**
+ * @brief Appends the positions of a term in one page: how many there are, and
+ *        then the differences between them, in varint
+ *
+ * @param positions     in ascending order
+ * @param count
+ * @param output
+ */
+void encodePositions(const uint32_t *positions, size_t count, vector<uint8_t> &output)
+{
+    writeVarint((uint32_t)count, output);
+    encodeVarintBlock(positions, count, 0, output);
+}
+
+/**
+ * @brief Reads the positions written by encodePositions()
+ *
+ * @param input
+ * @param positions
+ * @return const uint8_t*   where the next list starts
+ */
+const uint8_t *decodePositions(const uint8_t *input, vector<uint32_t> &positions)
+{
+    uint32_t count;
+    input = readVarint(input, count);
+
+    positions.resize(count);
+
+    uint32_t position = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t delta;
+        input = readVarint(input, delta);
+
+        position += delta;
+        positions[i] = position;
+    }
+
+    return input;
+}
+
+/**
+ * @brief Moves past the positions written by encodePositions(), without
+ *        decoding them
+ *
+ * @param input
+ * @return const uint8_t*   where the next list starts
+ */
+const uint8_t *skipPositions(const uint8_t *input)
+{
+    uint32_t count;
+    input = readVarint(input, count);
+
+    // Cada valor termina en el primer byte sin el bit alto
+    while (count)
+    {
+        if (!(*input++ & 0x80))
+            count--;
+    }
+
+    return input;
+}
+
+/**
+ * @brief Construct a new PostingReader
+ *
+ * @param data                  where encodePostings() wrote the list
+ * @param documentFrequency     number of docIds in the list
+ * @param encoding              value returned by encodePostings()
+ * @param documentCount         number of documents in the index
+ */
+PostingReader::PostingReader(const uint8_t *data, uint32_t documentFrequency,
+                             PostingEncoding encoding, uint32_t documentCount)
+{
+    this->data = data;
+    this->documentFrequency = documentFrequency;
+    this->encoding = encoding;
+    this->documentCount = documentCount;
+
+    skipTable = NULL;
+    blocks = data;
+
+    if (encoding == POSTING_ENCODING_BITMAP)
+        blockCount = (documentCount + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+    else
+        blockCount = (documentFrequency + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+
+    if ((encoding == POSTING_ENCODING_VARINT || encoding == POSTING_ENCODING_BITPACK) &&
+        blockCount > 1)
+    {
+        skipTable = (const uint32_t *)data;
+        blocks = data + 2 * blockCount * sizeof(uint32_t);
+    }
+}
+
+uint32_t PostingReader::getDocumentFrequency() const
+{
+    return documentFrequency;
+}
+
+size_t PostingReader::getBlockCount() const
+{
+    return blockCount;
+}
+
+/**
+ * @brief Upper bound of the docIds in a block. Every docId of the next block
+ *        is greater
+ *
+ * @param block
+ * @return DocId
+ */
+DocId PostingReader::getBlockMax(size_t block) const
+{
+    // El último bloque contiene todo lo que queda
+    if (block + 1 >= blockCount)
+        return UINT32_MAX;
+
+    switch (encoding)
+    {
+    case POSTING_ENCODING_RAW:
+        return ((const DocId *)data)[(block + 1) * POSTING_BLOCK_SIZE - 1];
+    case POSTING_ENCODING_BITMAP:
+        return (DocId)((block + 1) * POSTING_BLOCK_SIZE - 1);
+    default:
+        return skipTable[2 * block];
+    }
+}
+
+/**
+ * @brief Gets the docIds of one block, decoding them only if needed
+ *
+ * @param block
+ * @param buffer    room for POSTING_BLOCK_SIZE docIds
+ * @param count     number of docIds in the block
+ * @return const DocId* the docIds, in buffer or in the list itself
+ */
+const DocId *PostingReader::getBlock(size_t block, DocId *buffer, size_t &count) const
+{
+    size_t first = block * POSTING_BLOCK_SIZE;
+
+    switch (encoding)
+    {
+    case POSTING_ENCODING_RAW:
+        count = min(POSTING_BLOCK_SIZE, (size_t)documentFrequency - first);
+        return (const DocId *)data + first;
+
+    case POSTING_ENCODING_BITMAP:
+    {
+        size_t last = min(first + POSTING_BLOCK_SIZE, (size_t)documentCount);
+
+        // Los bloques empiezan en un múltiplo de 8, así que se recorre de a byte
+        count = 0;
+        for (size_t byte = first / 8; byte < (last + 7) / 8; byte++)
+        {
+            for (unsigned int bits = data[byte]; bits; bits &= bits - 1)
+                buffer[count++] = (DocId)(byte * 8 + LOWEST_BIT[bits]);
+        }
+
+        return buffer;
+    }
+
+    default:
+    {
+        count = min(POSTING_BLOCK_SIZE, (size_t)documentFrequency - first);
+
+        const uint8_t *input = blocks + (skipTable ? skipTable[2 * block + 1] : 0);
+        DocId base = block ? skipTable[2 * (block - 1)] : 0;
+
+        if (encoding == POSTING_ENCODING_VARINT)
+            decodeVarintBlock(input, count, base, buffer);
+        else
+            decodeBitpackBlock(input, count, base, buffer);
+
+        return buffer;
+    }
+    }
+}
+
+bool PostingReader::isBitmap() const
+{
+    return encoding == POSTING_ENCODING_BITMAP;
+}
+
+const uint8_t *PostingReader::getBitmap() const
+{
+    return data;
+}
+
+size_t PostingReader::getBitmapSize() const
+{
+    return (documentCount + 7) / 8;
+}
+
+/**
+ * @brief Checks a list for a docId. A bitmap is not decoded; other lists
+ *        decode only the block that could contain it
+ *
+ * @param docId
+ * @return true if the docId is in the list
+ */
+bool PostingReader::contains(DocId docId) const
+{
+    if (encoding == POSTING_ENCODING_BITMAP)
+        return docId < documentCount && (data[docId / 8] & (1 << (docId % 8)));
+
+    // El primer bloque cuyo mayor docId no es menor
+    size_t low = 0, high = blockCount;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (getBlockMax(middle) < docId)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low == blockCount)
+        return false;
+
+    DocId buffer[POSTING_BLOCK_SIZE];
+    size_t count;
+    const DocId *values = getBlock(low, buffer, count);
+
+    return binary_search(values, values + count, docId);
+}
+
+/**
+ * @brief Decodes the whole list
+ *
+ * @param output
+ */
+void PostingReader::decodeAll(vector<DocId> &output) const
+{
+    output.resize(documentFrequency);
+
+    DocId buffer[POSTING_BLOCK_SIZE];
+    size_t position = 0;
+
+    for (size_t block = 0; block < blockCount; block++)
+    {
+        size_t count;
+        const DocId *values = getBlock(block, buffer, count);
+
+        memcpy(output.data() + position, values, count * sizeof(DocId));
+        position += count;
+    }
+}
+
+PostingCursor::PostingCursor(const PostingReader &reader) : reader(reader)
+{
+    docIds = NULL;
+    docId = 0;
+    block = 0;
+    count = 0;
+    index = 0;
+    blockPosition = 0;
+}
+
+/**
+ * @brief Moves to the first docId of the list that is not smaller than target
+ *
+ * @param target    not smaller than the docId of a previous call
+ * @return DocId    the docId, or POSTING_END if there is none
+ */
+DocId PostingCursor::moveTo(DocId target)
+{
+    if (!docIds || reader.getBlockMax(block) < target)
+        loadBlock(findBlock(target));
+
+    while (true)
+    {
+        while (index < count && docIds[index] < target)
+            index++;
+
+        if (index < count)
+            return docId = docIds[index];
+
+        // Los bloques de un bitmap pueden estar vacíos
+        if (block + 1 >= reader.getBlockCount())
+            return docId = POSTING_END;
+
+        loadBlock(block + 1);
+    }
+}
+
+/**
+ * @brief docId found by the last call to moveTo()
+ *
+ * @return DocId
+ */
+DocId PostingCursor::getDocId() const
+{
+    return docId;
+}
+
+/**
+ * @brief Position in the list of the current docId
+ *
+ * @return size_t   number of docIds before it
+ */
+size_t PostingCursor::getPosition() const
+{
+    return blockPosition + index;
+}
+
+/**
+ * @brief Block that would contain a docId, without decoding anything
+ *
+ * @param target    not smaller than the current docId
+ * @return size_t
+ */
+size_t PostingCursor::findBlock(DocId target) const
+{
+    size_t targetBlock = docIds ? block : 0;
+
+    while (reader.getBlockMax(targetBlock) < target)
+        targetBlock++;
+
+    return targetBlock;
+}
+
+DocId PostingCursor::getBlockMax(size_t block) const
+{
+    return reader.getBlockMax(block);
+}
+
+/**
+ * @brief Decodes a block, that can not be before the current one
+ *
+ * @param newBlock
+ */
+void PostingCursor::loadBlock(size_t newBlock)
+{
+    if (reader.isBitmap())
+    {
+        // Los bloques de un bitmap no están llenos: se cuentan los bits salteados
+        const uint8_t *bitmap = reader.getBitmap();
+        size_t bytesPerBlock = POSTING_BLOCK_SIZE / 8;
+
+        for (size_t byte = block * bytesPerBlock; byte < newBlock * bytesPerBlock; byte++)
+            blockPosition += bitset<8>(bitmap[byte]).count();
+    }
+    else
+        blockPosition = newBlock * POSTING_BLOCK_SIZE;
+
+    block = newBlock;
+    docIds = reader.getBlock(block, buffer, count);
+    index = 0;
+}
+
+/**
+ * @brief Appends the differences between docIds using 7 bits per byte; the
+ *        high bit marks that more bytes follow
+ *
+ */
+static void encodeVarintBlock(const DocId *docIds, size_t count, DocId base, vector<uint8_t> &output)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t value = docIds[i] - base;
+        base = docIds[i];
+
+        while (value >= 0x80)
+        {
+            output.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+
+        output.push_back((uint8_t)value);
+    }
+}
+
+/**
+ * @brief Appends the number of bits of the largest difference between docIds,
+ *        and then every difference packed with that many bits
+ *
+ */
+static void encodeBitpackBlock(const DocId *docIds, size_t count, DocId base, vector<uint8_t> &output)
+{
+    uint32_t maxDelta = 0;
+    DocId previous = base;
+    for (size_t i = 0; i < count; i++)
+    {
+        maxDelta |= docIds[i] - previous;
+        previous = docIds[i];
+    }
+
+    int bits = 0;
+    while (bits < 32 && (maxDelta >> bits))
+        bits++;
+
+    output.push_back((uint8_t)bits);
+
+    uint64_t accumulator = 0;
+    int accumulatorBits = 0;
+
+    previous = base;
+    for (size_t i = 0; i < count; i++)
+    {
+        accumulator |= (uint64_t)(docIds[i] - previous) << accumulatorBits;
+        accumulatorBits += bits;
+        previous = docIds[i];
+
+        while (accumulatorBits >= 8)
+        {
+            output.push_back((uint8_t)accumulator);
+            accumulator >>= 8;
+            accumulatorBits -= 8;
+        }
+    }
+
+    if (accumulatorBits > 0)
+        output.push_back((uint8_t)accumulator);
+}
+
+static void decodeVarintBlock(const uint8_t *input, size_t count, DocId base, DocId *output)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t delta = 0;
+        int shift = 0;
+
+        while (*input & 0x80)
+        {
+            delta |= (uint32_t)(*input++ & 0x7f) << shift;
+            shift += 7;
+        }
+        delta |= (uint32_t)(*input++) << shift;
+
+        base += delta;
+        output[i] = base;
+    }
+}
+
+static void decodeBitpackBlock(const uint8_t *input, size_t count, DocId base, DocId *output)
+{
+    int bits = *input++;
+    uint32_t mask = (bits == 32) ? UINT32_MAX : ((1U << bits) - 1);
+
+    uint64_t accumulator = 0;
+    int accumulatorBits = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        while (accumulatorBits < bits)
+        {
+            accumulator |= (uint64_t)(*input++) << accumulatorBits;
+            accumulatorBits += 8;
+        }
+
+        base += (uint32_t)accumulator & mask;
+        accumulator >>= bits;
+        accumulatorBits -= bits;
+
+        output[i] = base;
+    }
+}
+
+static void alignOutput(vector<uint8_t> &output)
+{
+    output.resize((output.size() + 3) & ~(size_t)3, 0);
+}
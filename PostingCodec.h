@@ -0,0 +1,136 @@
+/**
+ * @file PostingCodec.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Compressed posting lists
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef POSTINGCODEC_H
+#define POSTINGCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+typedef uint32_t DocId;
+
+// Las posting lists se guardan en bloques de hasta 128 docIds
+const size_t POSTING_BLOCK_SIZE = 128;
+
+// Lo que devuelve un PostingCursor al pasar el final de la lista
+const DocId POSTING_END = UINT32_MAX;
+
+/**
+ * @brief How the posting lists of an index are stored
+ *
+ */
+enum PostingCodec
+{
+    POSTING_CODEC_RAW,          // uint32_t sin comprimir
+    POSTING_CODEC_VARINT,       // diferencias en varint
+    POSTING_CODEC_BITPACK,      // diferencias con el mismo ancho de bits por bloque
+};
+
+/**
+ * @brief How one posting list is stored. Dense lists use a bitmap whatever
+ *        the codec, when it is smaller
+ *
+ */
+enum PostingEncoding
+{
+    POSTING_ENCODING_RAW,
+    POSTING_ENCODING_VARINT,
+    POSTING_ENCODING_BITPACK,
+    POSTING_ENCODING_BITMAP,
+};
+
+bool parsePostingCodec(const std::string &name, PostingCodec &codec);
+const char *getPostingCodecName(PostingCodec codec);
+
+void appendBitmapDocIds(const uint8_t *bitmap, size_t firstByte, size_t lastByte,
+                        std::vector<DocId> &output);
+
+PostingEncoding encodePostings(const DocId *docIds, size_t count,
+                               PostingCodec codec, uint32_t documentCount,
+                               std::vector<uint8_t> &output, size_t &offset);
+
+void writeVarint(uint32_t value, std::vector<uint8_t> &output);
+const uint8_t *readVarint(const uint8_t *input, uint32_t &value);
+
+void encodePositions(const uint32_t *positions, size_t count, std::vector<uint8_t> &output);
+const uint8_t *decodePositions(const uint8_t *input, std::vector<uint32_t> &positions);
+const uint8_t *skipPositions(const uint8_t *input);
+
+/**
+ * @brief Read-only view of an encoded posting list, decoded one block at a time
+ *
+ * Las listas de más de un bloque empiezan con una tabla de saltos (el mayor
+ * docId de cada bloque y dónde empieza), así que se puede ir directo al bloque
+ * que contiene un docId sin decodificar los anteriores.
+ */
+class PostingReader
+{
+public:
+    PostingReader(const uint8_t *data, uint32_t documentFrequency,
+                  PostingEncoding encoding, uint32_t documentCount);
+
+    uint32_t getDocumentFrequency() const;
+    size_t getBlockCount() const;
+    DocId getBlockMax(size_t block) const;
+    const DocId *getBlock(size_t block, DocId *buffer, size_t &count) const;
+
+    bool isBitmap() const;
+    bool contains(DocId docId) const;
+    const uint8_t *getBitmap() const;
+    size_t getBitmapSize() const;
+
+    void decodeAll(std::vector<DocId> &output) const;
+
+private:
+    const uint8_t *data;
+    const uint32_t *skipTable;
+    const uint8_t *blocks;
+    uint32_t documentFrequency;
+    uint32_t documentCount;
+    size_t blockCount;
+    PostingEncoding encoding;
+};
+
+/**
+ * @brief Walks a posting list forward, one block at a time
+ *
+ * Los docIds se tienen que pedir en orden creciente, así que cada bloque se
+ * decodifica una sola vez, y los bloques que se saltean no se decodifican.
+ * La posición sirve para leer datos guardados en el mismo orden que los
+ * docIds, como las frecuencias.
+ */
+class PostingCursor
+{
+public:
+    PostingCursor(const PostingReader &reader);
+
+    DocId moveTo(DocId target);
+    DocId getDocId() const;
+    size_t getPosition() const;
+
+    size_t findBlock(DocId target) const;
+    DocId getBlockMax(size_t block) const;
+
+private:
+    void loadBlock(size_t newBlock);
+
+    PostingReader reader;
+    const DocId *docIds;
+    DocId docId;
+    size_t block;
+    size_t count;
+    size_t index;
+    size_t blockPosition;
+    DocId buffer[POSTING_BLOCK_SIZE];
+};
+
+#endif
@@ -0,0 +1,502 @@
+/**
+ * @file PostingIntersection.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Intersection of sorted posting lists
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "PostingIntersection.h"
+
+using namespace std;
+
+/**
+ * @brief Position of a posting list while it is intersected, with the last
+ *        decoded block
+ *
+ */
+struct BlockCursor
+{
+    size_t block;
+    size_t decodedBlock;
+    const DocId *values;
+    size_t count;
+    DocId buffer[POSTING_BLOCK_SIZE];
+};
+
+static void intersectBitmaps(const vector<PostingReader> &lists, vector<DocId> &results);
+static size_t filterCandidates(const PostingReader &list, BlockCursor &cursor,
+                               DocId *candidates, size_t candidateCount);
+static size_t intersectPair(const DocId *a, size_t aSize,
+                            const DocId *b, size_t bSize,
+                            DocId *output);
+static size_t mergeTail(const DocId *a, size_t aSize, size_t i,
+                        const DocId *b, size_t bSize, size_t j,
+                        DocId *output, size_t count);
+
+/**
+ * @brief Intersects every list, one block at a time
+ *
+ * Se decodifica un bloque de la lista más corta y se descartan los candidatos
+ * que no aparecen en cada una de las otras, de la más corta a la más larga. De
+ * las otras listas solo se decodifican los bloques que pueden contener algún
+ * candidato; en los bitmaps se consulta directamente cada candidato.
+ *
+ * @param lists     posting lists to intersect (they are reordered by length)
+ * @param results   docIds present in every list, in ascending order
+ */
+void intersectPostings(vector<PostingReader> &lists, vector<DocId> &results)
+{
+    results.clear();
+
+    if (lists.empty())
+        return;
+
+    sort(lists.begin(), lists.end(),
+         [](const PostingReader &a, const PostingReader &b)
+         { return a.getDocumentFrequency() < b.getDocumentFrequency(); });
+
+    if (lists.size() == 1)
+    {
+        lists[0].decodeAll(results);
+        return;
+    }
+
+    // Si todas son bitmaps, se hace el AND de a bloques
+    bool allBitmaps = true;
+    for (const PostingReader &list : lists)
+        allBitmaps = allBitmaps && list.isBitmap();
+
+    if (allBitmaps)
+    {
+        intersectBitmaps(lists, results);
+        return;
+    }
+
+    vector<BlockCursor> cursors(lists.size());
+    for (auto &cursor : cursors)
+    {
+        cursor.block = 0;
+        cursor.decodedBlock = SIZE_MAX;
+    }
+
+    DocId candidates[POSTING_BLOCK_SIZE];
+
+    for (size_t block = 0; block < lists[0].getBlockCount(); block++)
+    {
+        size_t count;
+        const DocId *values = lists[0].getBlock(block, candidates, count);
+        if (values != candidates)
+            copy(values, values + count, candidates);
+
+        for (size_t i = 1; i < lists.size() && count; i++)
+            count = filterCandidates(lists[i], cursors[i], candidates, count);
+
+        results.insert(results.end(), candidates, candidates + count);
+    }
+}
+
+/**
+ * @brief Counts the docIds that are in at least one of the lists
+ *
+ * @param lists
+ * @param documentCount     number of documents in the index
+ * @return size_t
+ */
+size_t countPostingUnion(const vector<PostingReader> &lists, uint32_t documentCount)
+{
+    if (lists.size() == 1)
+        return lists[0].getDocumentFrequency();
+
+    vector<uint8_t> bitmap((documentCount + 7) / 8, 0);
+    DocId buffer[POSTING_BLOCK_SIZE];
+
+    for (auto &list : lists)
+    {
+        if (list.isBitmap())
+        {
+            const uint8_t *listBitmap = list.getBitmap();
+            for (size_t i = 0; i < bitmap.size(); i++)
+                bitmap[i] |= listBitmap[i];
+
+            continue;
+        }
+
+        for (size_t block = 0; block < list.getBlockCount(); block++)
+        {
+            size_t count;
+            const DocId *docIds = list.getBlock(block, buffer, count);
+
+            for (size_t i = 0; i < count; i++)
+                bitmap[docIds[i] / 8] |= (uint8_t)(1 << (docIds[i] % 8));
+        }
+    }
+
+    size_t unionSize = 0;
+    for (auto byte : bitmap)
+        unionSize += bitset<8>(byte).count();
+
+    return unionSize;
+}
+
+/**
+ * @brief Intersects lists stored as bitmaps, 64 bytes at a time
+ *
+ * @param lists
+ * @param results
+ */
+static void intersectBitmaps(const vector<PostingReader> &lists, vector<DocId> &results)
+{
+    const size_t chunkSize = 64;
+    size_t bitmapSize = lists[0].getBitmapSize();
+
+    uint8_t chunk[chunkSize];
+
+    for (size_t first = 0; first < bitmapSize; first += chunkSize)
+    {
+        size_t count = min(chunkSize, bitmapSize - first);
+
+        memcpy(chunk, lists[0].getBitmap() + first, count);
+        for (size_t i = 1; i < lists.size(); i++)
+        {
+            const uint8_t *bitmap = lists[i].getBitmap() + first;
+            for (size_t j = 0; j < count; j++)
+                chunk[j] &= bitmap[j];
+        }
+
+        // chunk representa los bytes [first, first + count) del bitmap
+        size_t resultCount = results.size();
+        appendBitmapDocIds(chunk, 0, count, results);
+        for (size_t i = resultCount; i < results.size(); i++)
+            results[i] += (DocId)(first * 8);
+    }
+}
+
+/**
+ * @brief Keeps only the candidates that are in the list
+ *
+ * @param list
+ * @param cursor            position in the list, advanced as needed
+ * @param candidates        sorted docIds, overwritten with the ones that remain
+ * @param candidateCount
+ * @return size_t           number of candidates that remain
+ */
+static size_t filterCandidates(const PostingReader &list, BlockCursor &cursor,
+                               DocId *candidates, size_t candidateCount)
+{
+    size_t count = 0;
+
+    if (list.isBitmap())
+    {
+        for (size_t i = 0; i < candidateCount; i++)
+        {
+            if (list.contains(candidates[i]))
+                candidates[count++] = candidates[i];
+        }
+
+        return count;
+    }
+
+    size_t i = 0;
+    while (i < candidateCount)
+    {
+        // Se saltean los bloques que terminan antes del candidato
+        while (list.getBlockMax(cursor.block) < candidates[i])
+            cursor.block++;
+
+        if (cursor.decodedBlock != cursor.block)
+        {
+            cursor.values = list.getBlock(cursor.block, cursor.buffer, cursor.count);
+            cursor.decodedBlock = cursor.block;
+        }
+
+        // Candidatos que caen dentro de este bloque
+        DocId blockMax = list.getBlockMax(cursor.block);
+        size_t end = upper_bound(candidates + i, candidates + candidateCount, blockMax) - candidates;
+
+        count += intersectPair(candidates + i, end - i, cursor.values, cursor.count, candidates + count);
+        i = end;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Intersects two sorted arrays, choosing the algorithm by their lengths
+ *
+ * @param a
+ * @param aSize
+ * @param b
+ * @param bSize
+ * @param output    may be the same array as a, or point before it
+ * @return size_t   number of elements written to output
+ */
+static size_t intersectPair(const DocId *a, size_t aSize,
+                            const DocId *b, size_t bSize,
+                            DocId *output)
+{
+    if (aSize && bSize / aSize >= GALLOPING_RATIO)
+        return intersectGalloping(a, aSize, b, bSize, output);
+
+    return intersectBlocks(a, aSize, b, bSize, output);
+}
+
+/**
+ * @brief Looks up each element of the small list in the large one with an
+ *        exponential search that starts where the previous one ended
+ *
+ * @param small         the shorter list
+ * @param smallSize
+ * @param large         the longer list
+ * @param largeSize
+ * @param output        may be the same array as small
+ * @return size_t       number of elements written to output
+ */
+size_t intersectGalloping(const DocId *small, size_t smallSize,
+                          const DocId *large, size_t largeSize,
+                          DocId *output)
+{
+    size_t count = 0;
+    size_t low = 0;
+
+    for (size_t i = 0; i < smallSize && low < largeSize; i++)
+    {
+        DocId value = small[i];
+
+        size_t step = 1;
+        while (low + step < largeSize && large[low + step] < value)
+            step *= 2;
+
+        const DocId *found = lower_bound(large + low + step / 2,
+                                         large + min(low + step + 1, largeSize),
+                                         value);
+        low = found - large;
+
+        if (low < largeSize && *found == value)
+            output[count++] = value;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Compares blocks of both lists against each other with SIMD, and
+ *        advances the block with the smaller maximum
+ *
+ * @param a
+ * @param aSize
+ * @param b
+ * @param bSize
+ * @param output    may be the same array as a
+ * @return size_t   number of elements written to output
+ */
+size_t intersectBlocks(const DocId *a, size_t aSize,
+                       const DocId *b, size_t bSize,
+                       DocId *output)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+
+#if defined(__AVX2__)
+    const __m256i rotate = _mm256_set_epi32(0, 7, 6, 5, 4, 3, 2, 1);
+
+    while (i + 8 <= aSize && j + 8 <= bSize)
+    {
+        __m256i aBlock = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i bBlock = _mm256_loadu_si256((const __m256i *)(b + j));
+
+        // Se compara cada elemento de a con las 8 rotaciones del bloque de b
+        __m256i matches = _mm256_cmpeq_epi32(aBlock, bBlock);
+        for (int rotation = 1; rotation < 8; rotation++)
+        {
+            bBlock = _mm256_permutevar8x32_epi32(bBlock, rotate);
+            matches = _mm256_or_si256(matches, _mm256_cmpeq_epi32(aBlock, bBlock));
+        }
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(matches));
+
+        DocId aMax = a[i + 7];
+        DocId bMax = b[j + 7];
+
+        DocId values[8];
+        _mm256_storeu_si256((__m256i *)values, aBlock);
+        for (int k = 0; k < 8; k++)
+        {
+            if (mask & (1 << k))
+                output[count++] = values[k];
+        }
+
+        if (aMax <= bMax)
+            i += 8;
+        if (bMax <= aMax)
+            j += 8;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    while (i + 4 <= aSize && j + 4 <= bSize)
+    {
+        __m128i aBlock = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i bBlock = _mm_loadu_si128((const __m128i *)(b + j));
+
+        // Se compara cada elemento de a con las 4 rotaciones del bloque de b
+        __m128i matches = _mm_cmpeq_epi32(aBlock, bBlock);
+        bBlock = _mm_shuffle_epi32(bBlock, _MM_SHUFFLE(0, 3, 2, 1));
+        matches = _mm_or_si128(matches, _mm_cmpeq_epi32(aBlock, bBlock));
+        bBlock = _mm_shuffle_epi32(bBlock, _MM_SHUFFLE(0, 3, 2, 1));
+        matches = _mm_or_si128(matches, _mm_cmpeq_epi32(aBlock, bBlock));
+        bBlock = _mm_shuffle_epi32(bBlock, _MM_SHUFFLE(0, 3, 2, 1));
+        matches = _mm_or_si128(matches, _mm_cmpeq_epi32(aBlock, bBlock));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(matches));
+
+        DocId aMax = a[i + 3];
+        DocId bMax = b[j + 3];
+
+        DocId values[4];
+        _mm_storeu_si128((__m128i *)values, aBlock);
+        for (int k = 0; k < 4; k++)
+        {
+            if (mask & (1 << k))
+                output[count++] = values[k];
+        }
+
+        if (aMax <= bMax)
+            i += 4;
+        if (bMax <= aMax)
+            j += 4;
+    }
+#endif
+
+    return mergeTail(a, aSize, i, b, bSize, j, output, count);
+}
+
+/**
+ * @brief Scalar merge of whatever is left after the SIMD blocks
+ *
+ */
+static size_t mergeTail(const DocId *a, size_t aSize, size_t i,
+                        const DocId *b, size_t bSize, size_t j,
+                        DocId *output, size_t count)
+{
+    while (i < aSize && j < bSize)
+    {
+        if (a[i] < b[j])
+            i++;
+        else if (b[j] < a[i])
+            j++;
+        else
+        {
+            output[count++] = a[i];
+            i++;
+            j++;
+        }
+    }
+
+    return count;
+}
+
+PostingStream::PostingStream()
+{
+    isUnion = false;
+    nextDocId = 0;
+}
+
+/**
+ * @brief Starts over with new lists
+ *
+ * @param lists     the index they read must outlive the stream
+ * @param isUnion   true for the docIds in any list, false for the ones in all
+ */
+void PostingStream::open(const vector<PostingReader> &lists, bool isUnion)
+{
+    this->isUnion = isUnion;
+    nextDocId = 0;
+
+    // Los cursores no se pueden mover una vez que decodifican un bloque
+    cursors.clear();
+    cursors.reserve(lists.size());
+    for (auto &list : lists)
+        cursors.emplace_back(list);
+}
+
+/**
+ * @brief Gets the next docIds
+ *
+ * @param docIds
+ * @param maxCount
+ * @return size_t   how many, 0 at the end
+ */
+size_t PostingStream::next(DocId *docIds, size_t maxCount)
+{
+    size_t count = 0;
+
+    while (count < maxCount && !cursors.empty())
+    {
+        DocId docId = isUnion ? findAny(nextDocId) : findCommon(nextDocId);
+        if (docId == POSTING_END)
+        {
+            cursors.clear();
+            break;
+        }
+
+        docIds[count++] = docId;
+        nextDocId = docId + 1;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Finds the first docId from target on that is in every list: cada
+ *        cursor salta hasta el candidato, y si se pasa, lo reemplaza
+ *
+ * @param target
+ * @return DocId    POSTING_END if there are no more
+ */
+DocId PostingStream::findCommon(DocId target)
+{
+    DocId candidate = target;
+    size_t agreements = 0;
+
+    for (size_t i = 0; agreements < cursors.size(); i = (i + 1) % cursors.size())
+    {
+        DocId docId = cursors[i].moveTo(candidate);
+        if (docId == POSTING_END)
+            return POSTING_END;
+
+        if (docId == candidate)
+            agreements++;
+        else
+        {
+            candidate = docId;
+            agreements = 1;
+        }
+    }
+
+    return candidate;
+}
+
+/**
+ * @brief Finds the first docId from target on that is in any list
+ *
+ * @param target
+ * @return DocId    POSTING_END if there are no more
+ */
+DocId PostingStream::findAny(DocId target)
+{
+    DocId first = POSTING_END;
+    for (auto &cursor : cursors)
+        first = min(first, cursor.moveTo(target));
+
+    return first;
+}
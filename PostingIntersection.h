@@ -0,0 +1,61 @@
+/**
+ * @file PostingIntersection.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Intersection of sorted posting lists
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef POSTINGINTERSECTION_H
+#define POSTINGINTERSECTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PostingCodec.h"
+
+// A partir de esta relación entre los largos conviene saltar por la lista
+// larga en vez de recorrerla entera
+const size_t GALLOPING_RATIO = 16;
+
+void intersectPostings(std::vector<PostingReader> &lists, std::vector<DocId> &results);
+size_t countPostingUnion(const std::vector<PostingReader> &lists, uint32_t documentCount);
+
+/**
+ * @brief Intersection or union of posting lists, produced in docId order a
+ *        few docIds at a time
+ *
+ * Las listas no se decodifican de antemano: cada PostingCursor decodifica un
+ * bloque por vez, así que la memoria no depende de cuántos docIds haya.
+ */
+class PostingStream
+{
+public:
+    PostingStream();
+
+    PostingStream(const PostingStream &) = delete;
+    PostingStream &operator=(const PostingStream &) = delete;
+
+    void open(const std::vector<PostingReader> &lists, bool isUnion);
+    size_t next(DocId *docIds, size_t maxCount);
+
+private:
+    DocId findCommon(DocId target);
+    DocId findAny(DocId target);
+
+    std::vector<PostingCursor> cursors;
+    bool isUnion;
+    DocId nextDocId;
+};
+
+size_t intersectGalloping(const DocId *small, size_t smallSize,
+                          const DocId *large, size_t largeSize,
+                          DocId *output);
+size_t intersectBlocks(const DocId *a, size_t aSize,
+                       const DocId *b, size_t bSize,
+                       DocId *output);
+
+#endif
@@ -0,0 +1,191 @@
+/**
+ * @file QueryCache.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Sharded LRU cache of search results
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+#include "QueryCache.h"
+#include "SearchQuery.h"
+
+using namespace std;
+
+/**
+ * @brief Builds the key of a search: its normalized words, sorted and without
+ *        repetitions, so "Agua golfo" and "golfo AGUA agua" share results, its
+ *        phrases and its operators
+ *
+ * @param searchString
+ * @param mode
+ * @param offset
+ * @param count
+ * @return string
+ */
+string getQueryCacheKey(const string &searchString, SearchMode mode, size_t offset, size_t count)
+{
+    SearchQuery query;
+    parseSearchQuery(searchString, query);
+
+    string key = to_string(mode) + ' ' + to_string(offset) + ' ' + to_string(count);
+    for (size_t i = 0; i < query.terms.size(); i++)
+    {
+        key += ' ';
+        key += query.terms[i];
+
+        if (query.maxEdits[i])
+        {
+            key += '~';
+            key += to_string(query.maxEdits[i]);
+        }
+    }
+
+    // Los términos no tienen comillas, comas ni "~"
+    for (auto &constraint : query.constraints)
+    {
+        key += " \"";
+        key += to_string(constraint.maxDistance);
+        for (auto termIndex : constraint.termIndexes)
+        {
+            key += ',';
+            key += to_string(termIndex);
+        }
+    }
+
+    // Los operadores no cambian las palabras: "agua -golfo" y "agua OR golfo"
+    // solo se distinguen por el árbol
+    for (auto &node : query.nodes)
+    {
+        key += " (";
+        key += to_string(node.type);
+        key += ':';
+        key += to_string(node.value);
+        for (auto child : node.children)
+        {
+            key += ',';
+            key += to_string(child);
+        }
+        key += ')';
+    }
+
+    return key;
+}
+
+/**
+ * @brief Construct a new QueryCache
+ *
+ * @param capacity      maximum number of searches kept
+ * @param shardCount
+ */
+QueryCache::QueryCache(size_t capacity, size_t shardCount) : shards(max(shardCount, (size_t)1))
+{
+    shardCapacity = max(capacity / shards.size(), (size_t)1);
+
+    generation = 0;
+    hitCount = 0;
+    missCount = 0;
+}
+
+/**
+ * @brief Looks up the results of a search
+ *
+ * @param key   from getQueryCacheKey()
+ * @return shared_ptr<const QueryResults>   NULL if they are not cached
+ */
+shared_ptr<const QueryResults> QueryCache::get(const string &key)
+{
+    Shard &shard = getShard(key);
+
+    {
+        lock_guard<mutex> lock(shard.entriesMutex);
+
+        auto i = shard.entriesByKey.find(key);
+        if (i != shard.entriesByKey.end() && i->second->generation == generation)
+        {
+            shard.entries.splice(shard.entries.begin(), shard.entries, i->second);
+            hitCount++;
+
+            return i->second->results;
+        }
+    }
+
+    missCount++;
+
+    return NULL;
+}
+
+/**
+ * @brief Adds the results of a search
+ *
+ * @param key
+ * @param generation    getGeneration() from before the search. If the cache
+ *                      was invalidated since, the results are dropped
+ * @param results
+ */
+void QueryCache::put(const string &key, uint64_t generation, shared_ptr<const QueryResults> results)
+{
+    Shard &shard = getShard(key);
+
+    lock_guard<mutex> lock(shard.entriesMutex);
+
+    if (generation != this->generation)
+        return;
+
+    auto i = shard.entriesByKey.find(key);
+    if (i != shard.entriesByKey.end())
+    {
+        shard.entries.erase(i->second);
+        shard.entriesByKey.erase(i);
+    }
+
+    shard.entries.push_front({key, generation, results});
+    shard.entriesByKey[key] = shard.entries.begin();
+
+    if (shard.entries.size() > shardCapacity)
+    {
+        shard.entriesByKey.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+}
+
+/**
+ * @brief Current generation of the index
+ *
+ * @return uint64_t
+ */
+uint64_t QueryCache::getGeneration() const
+{
+    return generation;
+}
+
+/**
+ * @brief Discards every cached search, at once. Must be called after the index
+ *        changes
+ *
+ * Las entradas viejas no se borran acá: se ignoran, y se van reemplazando.
+ */
+void QueryCache::invalidate()
+{
+    generation++;
+}
+
+uint64_t QueryCache::getHitCount() const
+{
+    return hitCount;
+}
+
+uint64_t QueryCache::getMissCount() const
+{
+    return missCount;
+}
+
+QueryCache::Shard &QueryCache::getShard(const string &key)
+{
+    return shards[hash<string>()(key) % shards.size()];
+}
@@ -0,0 +1,86 @@
+/**
+ * @file QueryCache.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Sharded LRU cache of search results
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SearchIndex.h"
+
+struct QueryResults
+{
+    size_t matchCount;
+    std::vector<SearchResult> results;
+    std::vector<char> html; // los resultados, ya escritos para la página
+};
+
+std::string getQueryCacheKey(const std::string &searchString, SearchMode mode,
+                             size_t offset, size_t count);
+
+/**
+ * @brief Keeps the results of the most recent searches
+ *
+ * Las entradas se reparten en shards, cada uno con su propio lock, para que los
+ * hilos del servidor no compitan por uno solo. Cada entrada recuerda la
+ * generación del índice con el que se calculó: invalidate() cambia de
+ * generación, y desde ese momento ninguna entrada anterior se devuelve.
+ */
+class QueryCache
+{
+public:
+    QueryCache(size_t capacity, size_t shardCount);
+
+    std::shared_ptr<const QueryResults> get(const std::string &key);
+    void put(const std::string &key, uint64_t generation,
+             std::shared_ptr<const QueryResults> results);
+
+    uint64_t getGeneration() const;
+    void invalidate();
+
+    uint64_t getHitCount() const;
+    uint64_t getMissCount() const;
+
+private:
+    struct Entry
+    {
+        std::string key;
+        uint64_t generation;
+        std::shared_ptr<const QueryResults> results;
+    };
+
+    struct Shard
+    {
+        std::mutex entriesMutex;
+
+        // La más usada primero
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> entriesByKey;
+    };
+
+    Shard &getShard(const std::string &key);
+
+    std::vector<Shard> shards;
+    size_t shardCapacity;
+
+    std::atomic<uint64_t> generation;
+    std::atomic<uint64_t> hitCount;
+    std::atomic<uint64_t> missCount;
+};
+
+#endif
@@ -0,0 +1,683 @@
+/**
+ * @file QueryPlan.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Plans and runs searches with boolean operators
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <algorithm>
+#include <iterator>
+
+#include "QueryPlan.h"
+
+using namespace std;
+
+// Una unión que puede tener más de una página cada tantas se arma en un
+// bitmap, igual que las listas que se guardan como bitmap
+static const uint64_t DENSE_UNION_RATIO = 32;
+
+static bool isBitmapLeaf(const PlanNode &plan, const vector<PostingReader> &postings);
+static void removeDuplicateLeaves(vector<PlanNode> &nodes);
+static void setEmpty(PlanNode &plan);
+static void setBits(const DocId *docIds, size_t count, vector<uint8_t> &bitmap);
+static const char *getStrategyName(PlanStrategy strategy);
+
+/**
+ * @brief Plans a search with operators for one index
+ *
+ * @param query         with nodes; it must outlive the plan
+ * @param postings      one list per term of the query, empty if the index does
+ *                      not have it; they must outlive the plan
+ * @param documentCount of the index
+ */
+QueryPlan::QueryPlan(const SearchQuery &query, const vector<PostingReader> &postings,
+                     uint32_t documentCount) : query(query),
+                                               postings(postings)
+{
+    this->documentCount = documentCount;
+
+    if (query.nodes.empty())
+        setEmpty(root);
+    else
+        planNode((uint32_t)query.nodes.size() - 1, root);
+}
+
+/**
+ * @brief Finds the pages that match
+ *
+ * @param filterConstraint  for the phrases and NEAR/k
+ * @param results           docIds in ascending order
+ */
+void QueryPlan::run(const ConstraintFilter &filterConstraint, vector<DocId> &results) const
+{
+    runNode(root, filterConstraint, results);
+}
+
+/**
+ * @brief Most pages the search can find. 0 si seguro no encuentra ninguna
+ *
+ * @return uint32_t
+ */
+uint32_t QueryPlan::getEstimate() const
+{
+    return root.estimate;
+}
+
+/**
+ * @brief Describes the plan, like "AND/galloping(b a NOT/merge(c))": los
+ *        operandos en el orden en que se evalúan, con la estrategia de cada
+ *        operador. Las restricciones van como "CONSTRAINT(i)"
+ *
+ * @return string
+ */
+string QueryPlan::describe() const
+{
+    string text;
+    describeNode(root, text);
+
+    return text;
+}
+
+/**
+ * @brief Plans a node of the query tree
+ *
+ * @param node
+ * @param plan
+ */
+void QueryPlan::planNode(uint32_t node, PlanNode &plan) const
+{
+    const QueryNode &queryNode = query.nodes[node];
+
+    switch (queryNode.type)
+    {
+    case QUERY_WORD:
+        planWord(queryNode.value, plan);
+        break;
+
+    case QUERY_CONSTRAINT:
+    {
+        setEmpty(plan);
+        plan.type = QUERY_AND;
+        for (auto termIndex : query.constraints[queryNode.value].termIndexes)
+            plan.children.push_back(getLeaf(termIndex));
+        plan.constraints.push_back(queryNode.value);
+
+        finishAnd(plan);
+        break;
+    }
+
+    case QUERY_AND:
+        planAnd(queryNode, plan);
+        break;
+
+    case QUERY_OR:
+        planOr(queryNode, plan);
+        break;
+
+    case QUERY_NOT:
+    {
+        // Un NOT que no está en un AND no tiene de qué sacar páginas
+        bool isNegated;
+        uint32_t child = skipNegations(node, isNegated);
+        if (isNegated)
+            setEmpty(plan);
+        else
+            planNode(child, plan);
+        break;
+    }
+    }
+}
+
+/**
+ * @brief Plans a word, which with variants is the union of their lists
+ *
+ * @param word
+ * @param plan
+ */
+void QueryPlan::planWord(uint32_t word, PlanNode &plan) const
+{
+    if (query.variants[word].empty())
+    {
+        plan = getLeaf(word);
+        return;
+    }
+
+    setEmpty(plan);
+    plan.type = QUERY_OR;
+    plan.children.push_back(getLeaf(word));
+    for (auto termIndex : query.variants[word])
+        plan.children.push_back(getLeaf(termIndex));
+
+    finishOr(plan);
+}
+
+/**
+ * @brief Plans an AND. Sus NOT pasan a ser exclusiones, y los AND que tiene
+ *        adentro se suman a él
+ *
+ * @param queryNode
+ * @param plan
+ */
+void QueryPlan::planAnd(const QueryNode &queryNode, PlanNode &plan) const
+{
+    setEmpty(plan);
+    plan.type = QUERY_AND;
+
+    for (auto child : queryNode.children)
+    {
+        bool isNegated;
+        uint32_t operand = skipNegations(child, isNegated);
+
+        PlanNode childPlan;
+        planNode(operand, childPlan);
+
+        if (isNegated)
+            plan.exclusions.push_back(move(childPlan));
+        else if (childPlan.type == QUERY_AND)
+        {
+            move(childPlan.children.begin(), childPlan.children.end(), back_inserter(plan.children));
+            move(childPlan.exclusions.begin(), childPlan.exclusions.end(), back_inserter(plan.exclusions));
+            plan.constraints.insert(plan.constraints.end(), childPlan.constraints.begin(),
+                                    childPlan.constraints.end());
+        }
+        else
+            plan.children.push_back(move(childPlan));
+    }
+
+    finishAnd(plan);
+}
+
+/**
+ * @brief Plans an OR. Los OR que tiene adentro se suman a él
+ *
+ * @param queryNode
+ * @param plan
+ */
+void QueryPlan::planOr(const QueryNode &queryNode, PlanNode &plan) const
+{
+    setEmpty(plan);
+    plan.type = QUERY_OR;
+
+    for (auto child : queryNode.children)
+    {
+        PlanNode childPlan;
+        planNode(child, childPlan);
+
+        if (childPlan.type == QUERY_OR)
+            move(childPlan.children.begin(), childPlan.children.end(), back_inserter(plan.children));
+        else
+            plan.children.push_back(move(childPlan));
+    }
+
+    finishOr(plan);
+}
+
+/**
+ * @brief Orders the operands of an AND and chooses how to intersect them
+ *
+ * Si todos son bitmaps, se hace el AND de los bits. Si no, la lista más corta
+ * propone los candidatos, y si la siguiente es mucho más larga, se buscan
+ * saltando por las otras en vez de recorrerlas.
+ *
+ * @param plan
+ */
+void QueryPlan::finishAnd(PlanNode &plan) const
+{
+    removeDuplicateLeaves(plan.children);
+
+    // Sin operandos que aporten páginas, o con uno que no tiene ninguna
+    if (plan.children.empty() ||
+        any_of(plan.children.begin(), plan.children.end(), [](const PlanNode &child)
+               { return !child.estimate; }))
+    {
+        setEmpty(plan);
+        return;
+    }
+
+    stable_sort(plan.children.begin(), plan.children.end(), [](const PlanNode &a, const PlanNode &b)
+                { return a.estimate < b.estimate; });
+
+    plan.exclusions.erase(remove_if(plan.exclusions.begin(), plan.exclusions.end(),
+                                    [](const PlanNode &exclusion)
+                                    { return !exclusion.estimate; }),
+                          plan.exclusions.end());
+
+    if (plan.children.size() == 1 && plan.exclusions.empty() && plan.constraints.empty())
+    {
+        PlanNode child = move(plan.children[0]);
+        plan = move(child);
+        return;
+    }
+
+    plan.estimate = plan.children[0].estimate;
+
+    bool allBitmaps = all_of(plan.children.begin(), plan.children.end(), [this](const PlanNode &child)
+                             { return isBitmapLeaf(child, postings); });
+
+    if (plan.children.size() > 1 && allBitmaps)
+        plan.strategy = PLAN_BITMAP;
+    else if (plan.children.size() > 1 &&
+             plan.children[1].estimate / plan.children[0].estimate >= GALLOPING_RATIO)
+        plan.strategy = PLAN_GALLOPING;
+    else
+        plan.strategy = PLAN_MERGE;
+
+    // Un bitmap se consulta; una lista mucho más larga que los candidatos se
+    // recorre saltando
+    for (auto &exclusion : plan.exclusions)
+    {
+        if (isBitmapLeaf(exclusion, postings))
+            exclusion.filterStrategy = PLAN_BITMAP;
+        else if (exclusion.estimate / plan.estimate >= GALLOPING_RATIO)
+            exclusion.filterStrategy = PLAN_GALLOPING;
+        else
+            exclusion.filterStrategy = PLAN_MERGE;
+    }
+}
+
+/**
+ * @brief Orders the operands of an OR and chooses how to join them: si pueden
+ *        sumar muchas páginas, en un bitmap
+ *
+ * @param plan
+ */
+void QueryPlan::finishOr(PlanNode &plan) const
+{
+    removeDuplicateLeaves(plan.children);
+
+    plan.children.erase(remove_if(plan.children.begin(), plan.children.end(),
+                                  [](const PlanNode &child)
+                                  { return !child.estimate; }),
+                        plan.children.end());
+
+    if (plan.children.empty())
+    {
+        setEmpty(plan);
+        return;
+    }
+
+    if (plan.children.size() == 1)
+    {
+        PlanNode child = move(plan.children[0]);
+        plan = move(child);
+        return;
+    }
+
+    stable_sort(plan.children.begin(), plan.children.end(), [](const PlanNode &a, const PlanNode &b)
+                { return a.estimate < b.estimate; });
+
+    uint64_t estimateSum = 0;
+    for (auto &child : plan.children)
+        estimateSum += child.estimate;
+
+    plan.estimate = (uint32_t)min(estimateSum, (uint64_t)documentCount);
+    plan.strategy = (estimateSum * DENSE_UNION_RATIO >= documentCount) ? PLAN_BITMAP : PLAN_MERGE;
+}
+
+/**
+ * @brief Skips the NOT that are one inside another
+ *
+ * @param node
+ * @param isNegated     if there was an odd number of them
+ * @return uint32_t     the first node that is not a NOT
+ */
+uint32_t QueryPlan::skipNegations(uint32_t node, bool &isNegated) const
+{
+    isNegated = false;
+    while (query.nodes[node].type == QUERY_NOT)
+    {
+        node = query.nodes[node].children[0];
+        isNegated = !isNegated;
+    }
+
+    return node;
+}
+
+PlanNode QueryPlan::getLeaf(uint32_t term) const
+{
+    PlanNode leaf;
+    setEmpty(leaf);
+    leaf.type = QUERY_WORD;
+    leaf.term = term;
+    leaf.estimate = postings[term].getDocumentFrequency();
+
+    return leaf;
+}
+
+void QueryPlan::runNode(const PlanNode &plan, const ConstraintFilter &filterConstraint,
+                        vector<DocId> &results) const
+{
+    if (plan.type == QUERY_WORD)
+        postings[plan.term].decodeAll(results);
+    else if (plan.type == QUERY_AND)
+        runAnd(plan, filterConstraint, results);
+    else
+        runOr(plan, filterConstraint, results);
+}
+
+/**
+ * @brief Intersects the operands of an AND, and then filters the candidates
+ *        by its constraints and exclusions
+ *
+ * @param plan
+ * @param filterConstraint
+ * @param results
+ */
+void QueryPlan::runAnd(const PlanNode &plan, const ConstraintFilter &filterConstraint,
+                       vector<DocId> &results) const
+{
+    results.clear();
+
+    if (!plan.estimate)
+        return;
+
+    if (plan.strategy == PLAN_BITMAP)
+    {
+        vector<PostingReader> lists;
+        for (auto &child : plan.children)
+            lists.push_back(postings[child.term]);
+
+        intersectPostings(lists, results);
+    }
+    else
+    {
+        runNode(plan.children[0], filterConstraint, results);
+        for (size_t i = 1; i < plan.children.size() && !results.empty(); i++)
+            intersectChild(plan.children[i], plan.strategy, filterConstraint, results);
+    }
+
+    for (auto constraint : plan.constraints)
+        results.resize(filterConstraint(constraint, results.data(), results.size()));
+
+    for (auto &exclusion : plan.exclusions)
+        excludeChild(exclusion, filterConstraint, results);
+}
+
+/**
+ * @brief Joins the operands of an OR
+ *
+ * @param plan
+ * @param filterConstraint
+ * @param results
+ */
+void QueryPlan::runOr(const PlanNode &plan, const ConstraintFilter &filterConstraint,
+                      vector<DocId> &results) const
+{
+    results.clear();
+
+    if (plan.children.empty())
+        return;
+
+    vector<DocId> childResults;
+
+    if (plan.strategy == PLAN_BITMAP)
+    {
+        vector<uint8_t> bitmap((documentCount + 7) / 8, 0);
+        DocId buffer[POSTING_BLOCK_SIZE];
+
+        for (auto &child : plan.children)
+        {
+            if (isBitmapLeaf(child, postings))
+            {
+                const PostingReader &list = postings[child.term];
+                for (size_t i = 0; i < list.getBitmapSize(); i++)
+                    bitmap[i] |= list.getBitmap()[i];
+            }
+            else if (child.type == QUERY_WORD)
+            {
+                const PostingReader &list = postings[child.term];
+                for (size_t block = 0; block < list.getBlockCount(); block++)
+                {
+                    size_t count;
+                    const DocId *docIds = list.getBlock(block, buffer, count);
+                    setBits(docIds, count, bitmap);
+                }
+            }
+            else
+            {
+                runNode(child, filterConstraint, childResults);
+                setBits(childResults.data(), childResults.size(), bitmap);
+            }
+        }
+
+        appendBitmapDocIds(bitmap.data(), 0, bitmap.size(), results);
+        return;
+    }
+
+    // De la más corta a la más larga, para no recorrer la unión muchas veces
+    vector<DocId> merged;
+    runNode(plan.children[0], filterConstraint, results);
+
+    for (size_t i = 1; i < plan.children.size(); i++)
+    {
+        runNode(plan.children[i], filterConstraint, childResults);
+
+        merged.clear();
+        set_union(results.begin(), results.end(), childResults.begin(), childResults.end(),
+                  back_inserter(merged));
+        results.swap(merged);
+    }
+}
+
+/**
+ * @brief Keeps the candidates that an operand of an AND also finds
+ *
+ * @param child
+ * @param strategy          of the AND
+ * @param filterConstraint
+ * @param candidates
+ */
+void QueryPlan::intersectChild(const PlanNode &child, PlanStrategy strategy,
+                               const ConstraintFilter &filterConstraint,
+                               vector<DocId> &candidates) const
+{
+    size_t count = 0;
+
+    if (isBitmapLeaf(child, postings))
+    {
+        const PostingReader &list = postings[child.term];
+        for (auto docId : candidates)
+        {
+            if (list.contains(docId))
+                candidates[count++] = docId;
+        }
+    }
+    else if (child.type == QUERY_WORD && strategy == PLAN_GALLOPING)
+    {
+        // El cursor saltea los bloques que no tienen candidatos sin decodificarlos
+        PostingCursor cursor(postings[child.term]);
+        for (auto docId : candidates)
+        {
+            if (cursor.moveTo(docId) == docId)
+                candidates[count++] = docId;
+        }
+    }
+    else
+    {
+        vector<DocId> childResults;
+        runNode(child, filterConstraint, childResults);
+
+        if (strategy == PLAN_GALLOPING && candidates.size() <= childResults.size())
+            count = intersectGalloping(candidates.data(), candidates.size(),
+                                       childResults.data(), childResults.size(), candidates.data());
+        else if (strategy == PLAN_GALLOPING)
+        {
+            count = intersectGalloping(childResults.data(), childResults.size(),
+                                       candidates.data(), candidates.size(), childResults.data());
+            childResults.resize(count);
+            candidates.swap(childResults);
+        }
+        else
+            count = intersectBlocks(candidates.data(), candidates.size(),
+                                    childResults.data(), childResults.size(), candidates.data());
+    }
+
+    candidates.resize(count);
+}
+
+/**
+ * @brief Removes the candidates that an excluded operand finds
+ *
+ * @param child
+ * @param filterConstraint
+ * @param candidates
+ */
+void QueryPlan::excludeChild(const PlanNode &child, const ConstraintFilter &filterConstraint,
+                             vector<DocId> &candidates) const
+{
+    size_t count = 0;
+
+    if (child.filterStrategy == PLAN_BITMAP)
+    {
+        const PostingReader &list = postings[child.term];
+        for (auto docId : candidates)
+        {
+            if (!list.contains(docId))
+                candidates[count++] = docId;
+        }
+    }
+    else if (child.type == QUERY_WORD && child.filterStrategy == PLAN_GALLOPING)
+    {
+        PostingCursor cursor(postings[child.term]);
+        for (auto docId : candidates)
+        {
+            if (cursor.moveTo(docId) != docId)
+                candidates[count++] = docId;
+        }
+    }
+    else
+    {
+        vector<DocId> excluded;
+        runNode(child, filterConstraint, excluded);
+
+        // Con galloping, cada candidato se busca desde donde quedó el anterior
+        size_t j = 0;
+        for (auto docId : candidates)
+        {
+            if (child.filterStrategy == PLAN_GALLOPING)
+                j = lower_bound(excluded.begin() + j, excluded.end(), docId) - excluded.begin();
+            else
+            {
+                while (j < excluded.size() && excluded[j] < docId)
+                    j++;
+            }
+
+            if (j == excluded.size() || excluded[j] != docId)
+                candidates[count++] = docId;
+        }
+    }
+
+    candidates.resize(count);
+}
+
+void QueryPlan::describeNode(const PlanNode &plan, string &text) const
+{
+    if (plan.type == QUERY_WORD)
+    {
+        text += query.terms[plan.term];
+        return;
+    }
+
+    if (!plan.estimate)
+    {
+        text += "NONE";
+        return;
+    }
+
+    text += (plan.type == QUERY_AND) ? "AND/" : "OR/";
+    text += getStrategyName(plan.strategy);
+    text += "(";
+
+    for (size_t i = 0; i < plan.children.size(); i++)
+    {
+        if (i)
+            text += " ";
+        describeNode(plan.children[i], text);
+    }
+
+    for (auto constraint : plan.constraints)
+        text += " CONSTRAINT(" + to_string(constraint) + ")";
+
+    for (auto &exclusion : plan.exclusions)
+    {
+        text += " NOT/";
+        text += getStrategyName(exclusion.filterStrategy);
+        text += "(";
+        describeNode(exclusion, text);
+        text += ")";
+    }
+
+    text += ")";
+}
+
+static bool isBitmapLeaf(const PlanNode &plan, const vector<PostingReader> &postings)
+{
+    return plan.type == QUERY_WORD && postings[plan.term].isBitmap();
+}
+
+/**
+ * @brief Keeps only the first leaf of each term
+ *
+ * @param nodes
+ */
+static void removeDuplicateLeaves(vector<PlanNode> &nodes)
+{
+    vector<uint32_t> terms;
+    size_t count = 0;
+
+    for (auto &node : nodes)
+    {
+        if (node.type == QUERY_WORD)
+        {
+            if (find(terms.begin(), terms.end(), node.term) != terms.end())
+                continue;
+
+            terms.push_back(node.term);
+        }
+
+        if (&nodes[count] != &node)
+            nodes[count] = move(node);
+        count++;
+    }
+
+    nodes.resize(count);
+}
+
+/**
+ * @brief Makes a plan that finds no page
+ *
+ * @param plan
+ */
+static void setEmpty(PlanNode &plan)
+{
+    plan.type = QUERY_OR;
+    plan.term = 0;
+    plan.strategy = PLAN_MERGE;
+    plan.filterStrategy = PLAN_MERGE;
+    plan.estimate = 0;
+    plan.children.clear();
+    plan.exclusions.clear();
+    plan.constraints.clear();
+}
+
+static void setBits(const DocId *docIds, size_t count, vector<uint8_t> &bitmap)
+{
+    for (size_t i = 0; i < count; i++)
+        bitmap[docIds[i] / 8] |= (uint8_t)(1 << (docIds[i] % 8));
+}
+
+static const char *getStrategyName(PlanStrategy strategy)
+{
+    switch (strategy)
+    {
+    case PLAN_GALLOPING:
+        return "galloping";
+    case PLAN_BITMAP:
+        return "bitmap";
+    default:
+        return "merge";
+    }
+}
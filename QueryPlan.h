@@ -0,0 +1,98 @@
+/**
+ * @file QueryPlan.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Plans and runs searches with boolean operators
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef QUERYPLAN_H
+#define QUERYPLAN_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "PostingCodec.h"
+#include "PostingIntersection.h"
+#include "SearchQuery.h"
+
+// Cómo se combinan las listas de un operador
+enum PlanStrategy
+{
+    PLAN_MERGE,         // se recorren las listas enteras, a la par
+    PLAN_GALLOPING,     // cada docId de la más corta se busca saltando por las otras
+    PLAN_BITMAP,        // se marcan o se consultan bits, uno por página
+};
+
+// Un paso del plan: un término, o la intersección o la unión de otros pasos
+struct PlanNode
+{
+    QueryNodeType type;                 // QUERY_WORD, QUERY_AND o QUERY_OR
+    uint32_t term;                      // en SearchQuery::terms, solo en QUERY_WORD
+    PlanStrategy strategy;
+    PlanStrategy filterStrategy;        // cómo se saca de su AND, si es una exclusión
+    uint32_t estimate;                  // a lo sumo cuántas páginas encuentra
+    std::vector<PlanNode> children;     // por estimate creciente
+    std::vector<PlanNode> exclusions;   // solo en QUERY_AND: los NOT, que se sacan al final
+    std::vector<uint32_t> constraints;  // solo en QUERY_AND: frases y NEAR/k, que se filtran al final
+};
+
+// Deja, al principio de docIds, las páginas donde se cumple una restricción de
+// la búsqueda (ver SearchIndex::filterPositions())
+typedef std::function<size_t(uint32_t constraint, DocId *docIds, size_t count)> ConstraintFilter;
+
+/**
+ * @brief How to find the pages of one index that match the tree of a search
+ *
+ * El plan se arma con las frecuencias de los términos en el índice. Los AND y
+ * OR anidados se aplanan, y sus operandos se ordenan de la lista más corta a
+ * la más larga: un AND empieza por la más corta y nunca tiene más candidatos
+ * que ella. Los NOT, las frases y los NEAR/k no se evalúan donde aparecen: se
+ * aplican al final de su AND, sobre los candidatos que quedan. Para cada
+ * operador se elige cómo combinar las listas según sus largos.
+ */
+class QueryPlan
+{
+public:
+    QueryPlan(const SearchQuery &query, const std::vector<PostingReader> &postings,
+              uint32_t documentCount);
+
+    void run(const ConstraintFilter &filterConstraint, std::vector<DocId> &results) const;
+
+    uint32_t getEstimate() const;
+    std::string describe() const;
+
+private:
+    void planNode(uint32_t node, PlanNode &plan) const;
+    void planWord(uint32_t word, PlanNode &plan) const;
+    void planAnd(const QueryNode &queryNode, PlanNode &plan) const;
+    void planOr(const QueryNode &queryNode, PlanNode &plan) const;
+    void finishAnd(PlanNode &plan) const;
+    void finishOr(PlanNode &plan) const;
+    uint32_t skipNegations(uint32_t node, bool &isNegated) const;
+    PlanNode getLeaf(uint32_t term) const;
+
+    void runNode(const PlanNode &plan, const ConstraintFilter &filterConstraint,
+                 std::vector<DocId> &results) const;
+    void runAnd(const PlanNode &plan, const ConstraintFilter &filterConstraint,
+                std::vector<DocId> &results) const;
+    void runOr(const PlanNode &plan, const ConstraintFilter &filterConstraint,
+               std::vector<DocId> &results) const;
+    void intersectChild(const PlanNode &child, PlanStrategy strategy, const ConstraintFilter &filterConstraint,
+                        std::vector<DocId> &candidates) const;
+    void excludeChild(const PlanNode &child, const ConstraintFilter &filterConstraint,
+                      std::vector<DocId> &candidates) const;
+
+    void describeNode(const PlanNode &plan, std::string &text) const;
+
+    const SearchQuery &query;
+    const std::vector<PostingReader> &postings;     // una por término; vacía si no está
+    uint32_t documentCount;
+    PlanNode root;
+};
+
+#endif
@@ -0,0 +1,2442 @@
+/**
+ * @file SearchIndex.cpp
+ * @authors Marc S. Ressl, Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief EDAoogle inverted index
+ * @version 0.1
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <unordered_map>
+
+#include "HtmlTokenizer.h"
+#include "PostingIntersection.h"
+#include "SearchIndex.h"
+#include "TextNormalizer.h"
+
+using namespace std;
+
+static const char INDEX_MAGIC[8] = {'E', 'D', 'A', 'o', 'o', 'g', 'l', 'e'};
+
+// Se cambia cada vez que se modifica el formato del índice
+static const uint32_t INDEX_VERSION = 10;
+
+// Los términos más largos no se indexan
+static const size_t MAX_TERM_LENGTH = UINT16_MAX;
+
+// Parámetros de BM25
+static const float BM25_K1 = 1.2F;
+static const float BM25_B = 0.75F;
+
+// Las frecuencias se guardan en un byte; BM25 satura mucho antes
+static const uint32_t MAX_FREQUENCY = UINT8_MAX;
+
+// Las cotas pasadas a las estadísticas de varios índices se agrandan un poco,
+// para que el redondeo no las deje debajo de un puntaje
+static const float BOUND_ROUNDING_MARGIN = 1.0001F;
+
+// Valor inicial de FNV-1a
+static const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+// Variantes de una palabra con "~" que se buscan, las más cercanas y comunes
+static const size_t MAX_FUZZY_VARIANTS = 32;
+
+// Cada arena pide bloques de al menos este tamaño
+static const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+// Lo que se libera dentro de una arena y es a lo sumo de este tamaño se reusa,
+// como las listas que crecen; lo más grande queda libre hasta el final
+static const size_t ARENA_MAX_POOLED_SIZE = 64 * 1024;
+
+// Las postings de un término mientras se arma el índice. Sus listas salen de la
+// misma arena que el nodo del término
+struct TermPostings
+{
+    typedef pmr::polymorphic_allocator<char> allocator_type;
+
+    TermPostings(const allocator_type &allocator = allocator_type()) : postings(allocator),
+                                                                       positions(allocator)
+    {
+    }
+
+    TermPostings(const TermPostings &other, const allocator_type &allocator = allocator_type())
+        : postings(other.postings, allocator), positions(other.positions, allocator)
+    {
+    }
+
+    TermPostings &operator=(const TermPostings &other) = default;
+
+    PostingList postings;
+    pmr::vector<uint8_t> positions; // las de cada posting, en el mismo orden (ver encodePositions())
+};
+
+typedef pmr::unordered_map<pmr::string, TermPostings> PartialIndex;
+
+/**
+ * @brief A partial index with its own arena, from which its nodes, terms and
+ *        posting lists are allocated
+ *
+ * Armar el índice crea millones de objetos chicos: así no se pide cada uno al
+ * heap, quedan juntos en memoria, y se liberan todos de una vez al destruir el
+ * índice parcial. Solo lo puede usar un hilo a la vez.
+ */
+struct PartialIndexArena
+{
+    PartialIndexArena() : arena(ARENA_BLOCK_SIZE),
+                          pool(pmr::pool_options{0, ARENA_MAX_POOLED_SIZE}, &arena),
+                          terms(&pool)
+    {
+    }
+
+    pmr::monotonic_buffer_resource arena;
+    pmr::unsynchronized_pool_resource pool;
+    PartialIndex terms;
+};
+
+static uint64_t getFileStamps(const vector<filesystem::path> &fileList, vector<ParsedDocument> &documents);
+static uint64_t computeSourceStamp(const vector<filesystem::path> &fileList);
+static uint64_t hashFileStamp(const filesystem::path &filePath, const ParsedDocument &document,
+                              uint64_t hash);
+static uint64_t hashBytes(const void *data, size_t size, uint64_t hash);
+static size_t getTermBlockCount(size_t termCount);
+static bool findNextFuzzyTerm(const LevenshteinAutomaton &automaton, const string &text,
+                              const vector<uint8_t> &states, size_t depth, uint32_t after, string &next);
+static uint64_t getBlockCount(uint64_t count);
+static void writeImage(const vector<ParsedDocument> &documents, const vector<const PartialIndex *> &shards,
+                       uint64_t sourceStamp, PostingCodec codec, bool storePositions,
+                       vector<char> &image);
+static float computeIdf(uint32_t documentFrequency, uint32_t documentCount);
+static float computeLengthNorm(uint32_t length, float averageLength);
+static float computeTermScore(float idf, float frequency, float lengthNorm);
+static bool isBetterResult(const SearchResult &a, const SearchResult &b);
+static void addResult(vector<SearchResult> &heap, size_t maxResults, const SearchResult &result);
+static void removeDeleted(vector<DocId> &docIds, const vector<DocId> &deletedDocIds);
+static void indexFile(const filesystem::path &filePath, DocId docId, bool storePositions,
+                      ParsedDocument &document, vector<unique_ptr<PartialIndexArena>> &shards);
+static void mergePostings(TermPostings &termPostings, const TermPostings &newPostings);
+static void runInParallel(unsigned int threadCount, const function<void(unsigned int)> &task);
+
+SearchIndex::SearchIndex()
+{
+    header = NULL;
+    documentEntries = NULL;
+    termBlocks = NULL;
+    strings = NULL;
+    termData = NULL;
+    postingBytes = NULL;
+    frequencies = NULL;
+    blockScores = NULL;
+    positionBlocks = NULL;
+    positionData = NULL;
+}
+
+/**
+ * @brief makes a search index that contains all the words that appear
+ *        on the available pages
+ *
+ * Los docIds salen del orden alfabético de los archivos, así que el resultado
+ * no depende de la cantidad de hilos (ver buildImage()).
+ *
+ * Si se pasa el índice anterior, las páginas con el mismo tamaño y la misma
+ * fecha que tenían en él no se vuelven a leer: sus postings se copian del
+ * índice anterior con los docIds nuevos. Las páginas borradas o cambiadas
+ * quedan afuera, y solo se leen las cambiadas y las nuevas. Si el índice
+ * anterior no tiene las posiciones que se piden, o las tiene y no se piden, se
+ * leen todas.
+ *
+ * @param wikiPath      directory that contains the .html pages
+ * @param options       number of worker threads, posting list codec and if
+ *                      positions are stored
+ * @param previous      an index of the same pages built before, or NULL. It
+ *                      can't be this index
+ * @return size_t       number of pages that were read
+ */
+size_t SearchIndex::build(const string &wikiPath, const SearchIndexOptions &options,
+                          const SearchIndex *previous)
+{
+    vector<filesystem::path> fileList = listPages(wikiPath);
+
+    vector<ParsedDocument> documents(fileList.size());
+
+    // Las fechas se toman antes de leer las páginas: si una cambia mientras se
+    // lee, la próxima actualización la vuelve a leer
+    uint64_t sourceStamp = getFileStamps(fileList, documents);
+
+    vector<const SearchIndex *> sources;
+    vector<vector<DocId>> newDocIds;
+    vector<size_t> filesToRead;
+
+    if (previous && previous->header && previous->hasPositions() == options.storePositions)
+    {
+        // newDocIds[0][docId anterior]: el docId nuevo, o POSTING_END si la
+        // página se borró o cambió
+        sources.push_back(previous);
+        newDocIds.emplace_back(previous->header->documentCount, POSTING_END);
+
+        unordered_map<string_view, DocId> previousDocIds;
+        for (DocId docId = 0; docId < previous->header->documentCount; docId++)
+            previousDocIds[previous->getDocument(docId).path] = docId;
+
+        for (size_t i = 0; i < fileList.size(); i++)
+        {
+            ParsedDocument &document = documents[i];
+            document.path = getDocumentPath(fileList[i]);
+
+            auto previousDocId = previousDocIds.find(document.path);
+            if (previousDocId == previousDocIds.end())
+            {
+                filesToRead.push_back(i);
+                continue;
+            }
+
+            const DocumentEntry &entry = previous->documentEntries[previousDocId->second];
+            if (entry.fileSize != document.fileSize ||
+                entry.modificationTime != document.modificationTime)
+            {
+                filesToRead.push_back(i);
+                continue;
+            }
+
+            document.title = previous->getString(entry.titleOffset, entry.titleLength);
+            document.length = entry.length;
+            newDocIds[0][previousDocId->second] = (DocId)i;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < fileList.size(); i++)
+            filesToRead.push_back(i);
+    }
+
+    buildImage(fileList, filesToRead, documents, sources, newDocIds, sourceStamp, options);
+
+    return filesToRead.size();
+}
+
+/**
+ * @brief Makes an index of some pages only, to add it as a segment (ver
+ *        SegmentedIndex.h)
+ *
+ * @param pageList  absolute paths of the .html pages
+ * @param options
+ */
+void SearchIndex::buildPages(const vector<filesystem::path> &pageList, const SearchIndexOptions &options)
+{
+    vector<filesystem::path> fileList = pageList;
+    sort(fileList.begin(), fileList.end());
+
+    vector<ParsedDocument> documents(fileList.size());
+    uint64_t sourceStamp = getFileStamps(fileList, documents);
+
+    vector<size_t> filesToRead(fileList.size());
+    for (size_t i = 0; i < fileList.size(); i++)
+        filesToRead[i] = i;
+
+    buildImage(fileList, filesToRead, documents, {}, {}, sourceStamp, options);
+}
+
+/**
+ * @brief Makes one index with the pages of several, without reading the
+ *        pages again. Las páginas quedan en el orden de los índices
+ *
+ * @param segments          indexes to merge. None can be this index
+ * @param deletedDocIds     for each index, pages to leave out, in ascending order
+ * @param options
+ */
+void SearchIndex::merge(const vector<const SearchIndex *> &segments,
+                        const vector<const vector<DocId> *> &deletedDocIds,
+                        const SearchIndexOptions &options)
+{
+    vector<ParsedDocument> documents;
+    vector<vector<DocId>> newDocIds(segments.size());
+
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        const SearchIndex &segment = *segments[i];
+        const vector<DocId> &deleted = *deletedDocIds[i];
+        size_t nextDeleted = 0;
+
+        newDocIds[i].assign(segment.getDocumentCount(), POSTING_END);
+
+        for (DocId docId = 0; docId < segment.getDocumentCount(); docId++)
+        {
+            if (nextDeleted < deleted.size() && deleted[nextDeleted] == docId)
+            {
+                nextDeleted++;
+                continue;
+            }
+
+            Document document = segment.getDocument(docId);
+
+            newDocIds[i][docId] = (DocId)documents.size();
+            documents.push_back({string(document.path), string(document.title), document.length,
+                                 document.fileSize, document.modificationTime});
+        }
+    }
+
+    buildImage({}, {}, documents, segments, newDocIds, 0, options);
+}
+
+/**
+ * @brief Reads the pages that changed, copies the postings of the rest from
+ *        other indexes and lays out the new index
+ *
+ * Cada hilo toma el siguiente archivo libre y lo indexa en su propio índice
+ * parcial, repartido en shards según el hash del término. Después cada hilo
+ * junta un shard de todos los índices parciales, y le agrega los términos de
+ * ese shard que se copian de los otros índices.
+ *
+ * Las posiciones solo se guardan si todos los otros índices las tienen.
+ *
+ * @param fileList      all the pages, in docId order
+ * @param filesToRead   positions in fileList of the pages to read
+ * @param documents     one per docId. The ones that are not read must be complete
+ * @param sources       indexes to copy postings from. None can be this index
+ * @param newDocIds     for each source, the docId of each of its pages in the
+ *                      new index, or POSTING_END to leave it out. They must
+ *                      grow with the docIds of the source
+ * @param sourceStamp
+ * @param options
+ */
+void SearchIndex::buildImage(const vector<filesystem::path> &fileList,
+                             const vector<size_t> &filesToRead, vector<ParsedDocument> &documents,
+                             const vector<const SearchIndex *> &sources,
+                             const vector<vector<DocId>> &newDocIds,
+                             uint64_t sourceStamp, const SearchIndexOptions &options)
+{
+    clear();
+
+    bool storePositions = options.storePositions;
+    for (auto source : sources)
+    {
+        if (source->header && !source->hasPositions())
+            storePositions = false;
+    }
+
+    unsigned int threadCount = options.threadCount;
+
+    if (threadCount < 1)
+        threadCount = 1;
+    if (threadCount > documents.size())
+        threadCount = max<size_t>(documents.size(), 1);
+
+    // partialIndexes[hilo][shard], cada uno con su arena
+    vector<vector<unique_ptr<PartialIndexArena>>> partialIndexes(threadCount);
+    for (auto &threadIndexes : partialIndexes)
+    {
+        for (unsigned int shard = 0; shard < threadCount; shard++)
+            threadIndexes.push_back(make_unique<PartialIndexArena>());
+    }
+
+    atomic<size_t> nextFile(0);
+
+    runInParallel(threadCount, [&](unsigned int thread)
+                  {
+                      // Cada hilo recibe los archivos en orden creciente, así que
+                      // sus posting lists quedan ordenadas
+                      size_t i;
+                      while ((i = nextFile++) < filesToRead.size())
+                      {
+                          size_t file = filesToRead[i];
+                          indexFile(fileList[file], (DocId)file, storePositions, documents[file],
+                                    partialIndexes[thread]);
+                      } });
+
+    runInParallel(threadCount, [&](unsigned int shard)
+                  {
+                      // Cada shard se junta en la arena del primer hilo; las de
+                      // los demás se liberan a medida que se copian
+                      PartialIndex &mergedShard = partialIndexes[0][shard]->terms;
+
+                      for (size_t thread = 1; thread < partialIndexes.size(); thread++)
+                      {
+                          for (auto &entry : partialIndexes[thread][shard]->terms)
+                              mergePostings(mergedShard[entry.first], entry.second);
+
+                          partialIndexes[thread][shard].reset();
+                      }
+
+                      hash<string_view> hashTerm;
+                      vector<DocId> docIds;
+                      TermPostings keptPostings;
+                      pmr::string termText;
+
+                      for (size_t source = 0; source < sources.size(); source++)
+                      {
+                          const SearchIndex &index = *sources[source];
+                          if (!index.header)
+                              continue;
+
+                          for (TermCursor cursor(index); !cursor.isAtEnd(); cursor.next())
+                          {
+                              string_view text = cursor.getText();
+                              if (hashTerm(text) % threadCount != shard)
+                                  continue;
+
+                              const TermEntry &term = cursor.getEntry();
+
+                              index.getPostings(term).decodeAll(docIds);
+                              const uint8_t *termFrequencies = index.frequencies + term.frequenciesOffset;
+
+                              // Las posiciones se copian sin decodificarlas
+                              const uint8_t *termPositions = NULL;
+                              if (storePositions)
+                                  termPositions = index.positionData + index.positionBlocks[term.positionBlocksOffset];
+
+                              keptPostings.postings.clear();
+                              keptPostings.positions.clear();
+                              for (size_t j = 0; j < docIds.size(); j++)
+                              {
+                                  DocId newDocId = newDocIds[source][docIds[j]];
+                                  const uint8_t *nextPositions = storePositions ? skipPositions(termPositions) : NULL;
+
+                                  if (newDocId != POSTING_END)
+                                  {
+                                      keptPostings.postings.push_back({newDocId, termFrequencies[j]});
+                                      keptPostings.positions.insert(keptPostings.positions.end(),
+                                                                    termPositions, nextPositions);
+                                  }
+
+                                  termPositions = nextPositions;
+                              }
+
+                              if (!keptPostings.postings.empty())
+                              {
+                                  termText.assign(text.begin(), text.end());
+                                  mergePostings(mergedShard[termText], keptPostings);
+                              }
+                          }
+                      }
+
+                      for (auto &entry : mergedShard)
+                      {
+                          entry.second.postings.shrink_to_fit();
+                          entry.second.positions.shrink_to_fit();
+                      } });
+
+    // Los shards no comparten términos
+    vector<const PartialIndex *> shards;
+    for (auto &shard : partialIndexes[0])
+        shards.push_back(&shard->terms);
+
+    writeImage(documents, shards, sourceStamp, options.codec, storePositions, builtImage);
+
+    // El índice ya está en builtImage: las arenas se liberan enteras
+    partialIndexes.clear();
+
+    open(builtImage.data(), builtImage.size());
+}
+
+/**
+ * @brief Find the pages that contain all the words given in the string "searchString" and
+ *        completes the "results" vector.
+ *
+ * Only reads the index, so it can be called from several threads at once.
+ *
+ * @param searchString
+ * @param results       docIds of the matching pages, in ascending order
+ */
+void SearchIndex::match(const string &searchString, vector<DocId> &results) const
+{
+    results.clear();
+
+    // Si falta alguna palabra, ninguna página las contiene a todas
+    vector<TermEntry> terms;
+    if (findTerms(searchString, terms))
+        intersectTerms(terms, results);
+}
+
+/**
+ * @brief Finds the pages that contain the words of "searchString", ranked by
+ *        BM25
+ *
+ * Solo se ordenan los offset + count mejores, con un heap de ese tamaño, en
+ * lugar de todas las coincidencias. Las frases tienen que estar siempre (ver
+ * rank()).
+ *
+ * @param searchString
+ * @param mode          if pages need all the words or any of them
+ * @param offset        number of best results to skip
+ * @param count         maximum number of results
+ * @param results       best results from offset on, by decreasing score
+ * @return size_t       number of matching pages
+ */
+size_t SearchIndex::search(const string &searchString, SearchMode mode,
+                           size_t offset, size_t count, vector<SearchResult> &results) const
+{
+    SearchQuery query;
+    parseSearchQuery(searchString, query);
+    expandFuzzyTerms(query, {this});
+
+    SearchStatistics statistics;
+    statistics.documentCount = getDocumentCount();
+    statistics.totalDocumentLength = getTotalDocumentLength();
+    for (auto term : query.terms)
+        statistics.documentFrequencies.push_back(getDocumentFrequency(term, vector<DocId>()));
+
+    size_t matchCount = rank(query, mode, statistics, vector<DocId>(), offset + count, results);
+
+    results.erase(results.begin(), results.begin() + min(offset, results.size()));
+
+    return matchCount;
+}
+
+/**
+ * @brief Starts producing the pages that match a search, in docId order and
+ *        without ranking them, for result sets too large to rank at once
+ *
+ * Las frases no se comprueban: se buscan sus palabras sueltas, y
+ * filterPositions() deja las páginas que tienen las frases.
+ *
+ * @param searchString
+ * @param mode
+ * @param matches       valid while the index is not changed
+ */
+void SearchIndex::openMatches(const string &searchString, SearchMode mode, PostingStream &matches) const
+{
+    SearchQuery query;
+    parseSearchQuery(searchString, query);
+
+    // Sin variantes: no habría dónde guardar sus uniones
+    vector<vector<uint8_t>> unionPostings;
+    query.maxEdits.assign(query.maxEdits.size(), 0);
+
+    openMatches(query, mode, matches, unionPostings);
+}
+
+/**
+ * @brief Ranks the pages of this index that contain the terms by BM25, with
+ *        the statistics of all the indexes that are searched together
+ *
+ * Las frases y los NEAR/k valen en los dos modos: sus palabras tienen que
+ * estar, y donde la búsqueda las pide. Si el índice no tiene las posiciones,
+ * alcanza con que estén.
+ *
+ * Si la búsqueda tiene operadores, el modo no importa: las páginas son las
+ * que encuentra su QueryPlan, y los términos excluidos no suman puntaje.
+ *
+ * @param query
+ * @param mode              if pages need all the terms or any of them
+ * @param statistics        of all the indexes searched together
+ * @param deletedDocIds     pages of this index to skip, in ascending order
+ * @param maxResults
+ * @param results           best results, by decreasing score
+ * @param timing            if not NULL, the time of each part is added to it
+ * @return size_t           number of matching pages that are not deleted
+ */
+size_t SearchIndex::rank(const SearchQuery &query, SearchMode mode,
+                         const SearchStatistics &statistics, const vector<DocId> &deletedDocIds,
+                         size_t maxResults, vector<SearchResult> &results,
+                         SearchTiming *timing) const
+{
+    results.clear();
+
+    if (!header)
+        return 0;
+
+    auto t1 = chrono::steady_clock::now();
+
+    float averageLength = (float)statistics.totalDocumentLength / statistics.documentCount;
+    float ownAverageLength = getAverageLength();
+
+    vector<TermEntry> entries;
+    findQueryTerms(query, entries);
+
+    vector<ScoredTerm> scoredTerms;
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const TermEntry &entry = entries[i];
+        if (!entry.documentFrequency || !query.termWeights[i])
+            continue;
+
+        float idf = computeIdf(statistics.documentFrequencies[i], (uint32_t)statistics.documentCount) *
+                    query.termWeights[i];
+        float ownIdf = computeIdf(entry.documentFrequency, header->documentCount);
+
+        // Un puntaje de BM25 crece a lo sumo como el idf, y como el largo
+        // promedio cuando este es mayor. Con las propias estadísticas queda 1
+        float boundScale = (idf / ownIdf) * max(1.0F, averageLength / ownAverageLength);
+        if (boundScale != 1)
+            boundScale *= BOUND_ROUNDING_MARGIN;
+
+        scoredTerms.push_back({entry, idf, boundScale});
+    }
+
+    size_t matchCount;
+
+    if (!query.nodes.empty())
+    {
+        vector<PostingReader> postings;
+        getQueryPostings(entries, postings);
+        QueryPlan plan(query, postings, header->documentCount);
+
+        auto t2 = chrono::steady_clock::now();
+
+        vector<DocId> matches;
+        runQueryPlan(plan, query, matches);
+        removeDeleted(matches, deletedDocIds);
+        scoreMatches(scoredTerms, matches, averageLength, maxResults, results);
+        matchCount = matches.size();
+
+        auto t3 = chrono::steady_clock::now();
+        if (timing)
+        {
+            timing->planningTime += chrono::duration<double, milli>(t2 - t1).count();
+            timing->executionTime += chrono::duration<double, milli>(t3 - t2).count();
+        }
+
+        return matchCount;
+    }
+
+    auto t2 = chrono::steady_clock::now();
+
+    // Cada palabra requerida se satisface con ella o con alguna variante
+    size_t wordCount = query.variants.size();
+    vector<bool> isRequired(wordCount, mode == SEARCH_ALL_WORDS);
+    for (auto &constraint : query.constraints)
+    {
+        for (auto termIndex : constraint.termIndexes)
+            isRequired[termIndex] = true;
+    }
+
+    vector<vector<uint8_t>> unionPostings;
+    vector<PostingReader> requiredPostings;
+    bool hasRequiredWords = true;
+    for (size_t word = 0; hasRequiredWords && word < wordCount; word++)
+    {
+        if (isRequired[word])
+            hasRequiredWords = addWordPostings(query, word, entries, unionPostings, requiredPostings);
+    }
+
+    if (!hasRequiredWords)
+        matchCount = 0;
+    else if (mode == SEARCH_ALL_WORDS || !query.constraints.empty())
+        matchCount = rankAllTerms(scoredTerms, requiredPostings, query, averageLength, deletedDocIds,
+                                  maxResults, results);
+    else
+        matchCount = rankAnyTerm(scoredTerms, averageLength, deletedDocIds, maxResults, results);
+
+    auto t3 = chrono::steady_clock::now();
+    if (timing)
+    {
+        timing->planningTime += chrono::duration<double, milli>(t2 - t1).count();
+        timing->executionTime += chrono::duration<double, milli>(t3 - t2).count();
+    }
+
+    return matchCount;
+}
+
+/**
+ * @brief Starts producing the pages that contain the words, in docId order
+ *
+ * @param query
+ * @param mode
+ * @param matches           valid while the index and unionPostings exist
+ * @param unionPostings     for the words with variants
+ */
+void SearchIndex::openMatches(const SearchQuery &query, SearchMode mode, PostingStream &matches,
+                              vector<vector<uint8_t>> &unionPostings) const
+{
+    vector<TermEntry> entries;
+    findQueryTerms(query, entries);
+
+    unionPostings.clear();
+    vector<PostingReader> lists;
+
+    // Con operadores, las páginas del plan se guardan como una lista más
+    if (!query.nodes.empty())
+    {
+        vector<PostingReader> postings;
+        getQueryPostings(entries, postings);
+        QueryPlan plan(query, postings, header ? header->documentCount : 0);
+
+        vector<DocId> docIds;
+        if (header)
+            runQueryPlan(plan, query, docIds);
+
+        unionPostings.emplace_back();
+        size_t offset;
+        PostingEncoding encoding = encodePostings(docIds.data(), docIds.size(), POSTING_CODEC_RAW,
+                                                  header ? header->documentCount : 0,
+                                                  unionPostings.back(), offset);
+        lists.push_back(PostingReader(unionPostings.back().data() + offset, (uint32_t)docIds.size(),
+                                      encoding, header ? header->documentCount : 0));
+
+        matches.open(lists, false);
+        return;
+    }
+
+    if (mode == SEARCH_ANY_WORD)
+    {
+        for (auto &entry : entries)
+        {
+            if (entry.documentFrequency)
+                lists.push_back(getPostings(entry));
+        }
+    }
+    else
+    {
+        for (size_t word = 0; word < query.variants.size(); word++)
+        {
+            if (!addWordPostings(query, word, entries, unionPostings, lists))
+            {
+                lists.clear();
+                break;
+            }
+        }
+
+        // Con todas las palabras conviene que la lista más corta proponga los candidatos
+        sort(lists.begin(), lists.end(), [](const PostingReader &a, const PostingReader &b)
+             { return a.getDocumentFrequency() < b.getDocumentFrequency(); });
+    }
+
+    matches.open(lists, mode == SEARCH_ANY_WORD);
+}
+
+/**
+ * @brief Looks up every term of a query
+ *
+ * @param query
+ * @param entries   one per term; with documentFrequency 0 if it is not indexed
+ */
+void SearchIndex::findQueryTerms(const SearchQuery &query, vector<TermEntry> &entries) const
+{
+    entries.assign(query.terms.size(), TermEntry());
+
+    for (size_t i = 0; i < query.terms.size(); i++)
+    {
+        if (!findTerm(query.terms[i], entries[i]))
+            entries[i].documentFrequency = 0;
+    }
+}
+
+/**
+ * @brief Adds the pages that contain a word of the query, or any of its
+ *        variants. La unión de varias listas se codifica como una lista más
+ *
+ * @param query
+ * @param word
+ * @param entries           from findQueryTerms()
+ * @param unionPostings     where the unions are kept while the lists are used
+ * @param lists
+ * @return true if the word or some variant is indexed
+ */
+bool SearchIndex::addWordPostings(const SearchQuery &query, size_t word, const vector<TermEntry> &entries,
+                                  vector<vector<uint8_t>> &unionPostings,
+                                  vector<PostingReader> &lists) const
+{
+    vector<PostingReader> wordLists;
+    if (entries[word].documentFrequency)
+        wordLists.push_back(getPostings(entries[word]));
+    for (auto termIndex : query.variants[word])
+    {
+        if (entries[termIndex].documentFrequency)
+            wordLists.push_back(getPostings(entries[termIndex]));
+    }
+
+    if (wordLists.size() <= 1)
+    {
+        lists.insert(lists.end(), wordLists.begin(), wordLists.end());
+        return !wordLists.empty();
+    }
+
+    PostingStream stream;
+    stream.open(wordLists, true);
+
+    vector<DocId> docIds;
+    DocId buffer[POSTING_BLOCK_SIZE];
+    size_t count;
+    while ((count = stream.next(buffer, POSTING_BLOCK_SIZE)) > 0)
+        docIds.insert(docIds.end(), buffer, buffer + count);
+
+    // Cada unión en su propio vector, que no se mueve al agregar otros
+    unionPostings.emplace_back();
+    size_t offset;
+    PostingEncoding encoding = encodePostings(docIds.data(), docIds.size(), POSTING_CODEC_RAW,
+                                              header->documentCount, unionPostings.back(), offset);
+    lists.push_back(PostingReader(unionPostings.back().data() + offset, (uint32_t)docIds.size(),
+                                  encoding, header->documentCount));
+
+    return true;
+}
+
+/**
+ * @brief The posting list of each term of a query
+ *
+ * @param entries   from findQueryTerms()
+ * @param postings  empty for the terms that are not indexed
+ */
+void SearchIndex::getQueryPostings(const vector<TermEntry> &entries, vector<PostingReader> &postings) const
+{
+    uint32_t documentCount = header ? header->documentCount : 0;
+
+    postings.clear();
+    for (auto &entry : entries)
+    {
+        if (entry.documentFrequency)
+            postings.push_back(getPostings(entry));
+        else
+            postings.push_back(PostingReader(NULL, 0, POSTING_ENCODING_RAW, documentCount));
+    }
+}
+
+/**
+ * @brief Finds the pages of a search with operators
+ *
+ * @param plan
+ * @param query
+ * @param matches   docIds in ascending order, including the deleted ones
+ */
+void SearchIndex::runQueryPlan(const QueryPlan &plan, const SearchQuery &query, vector<DocId> &matches) const
+{
+    plan.run([this, &query](uint32_t constraint, DocId *docIds, size_t count)
+             { return filterPositions(query, constraint, docIds, count); },
+             matches);
+}
+
+/**
+ * @brief Keeps the pages where the phrases and NEAR/k of the query are. Si el
+ *        índice no tiene las posiciones, no saca ninguna. Con operadores, el
+ *        plan ya filtró cada una donde aparece (ver QueryPlan.h)
+ *
+ * @param query
+ * @param docIds    pages of this index that contain the words of the
+ *                  phrases, in ascending order
+ * @param count
+ * @return size_t   number of pages kept, at the start of docIds
+ */
+size_t SearchIndex::filterPositions(const SearchQuery &query, DocId *docIds, size_t count) const
+{
+    if (!query.nodes.empty())
+        return count;
+
+    for (uint32_t constraint = 0; count && constraint < query.constraints.size(); constraint++)
+        count = filterPositions(query, constraint, docIds, count);
+
+    return count;
+}
+
+/**
+ * @brief Keeps the pages where one phrase or NEAR/k of the query is
+ *
+ * @param query
+ * @param constraint    in query.constraints
+ * @param docIds        pages of this index, in ascending order
+ * @param count
+ * @return size_t       number of pages kept, at the start of docIds
+ */
+size_t SearchIndex::filterPositions(const SearchQuery &query, uint32_t constraint,
+                                    DocId *docIds, size_t count) const
+{
+    if (!hasPositions())
+        return count;
+
+    // Un cursor por palabra; las páginas van en orden creciente
+    const PhraseConstraint &phrase = query.constraints[constraint];
+    vector<TermEntry> entries;
+    vector<PostingCursor> cursors;
+    vector<PositionCursor> positionCursors;
+
+    // Cada cursor apunta a su propio buffer: con reserve() no se mueven
+    cursors.reserve(phrase.termIndexes.size());
+
+    for (auto termIndex : phrase.termIndexes)
+    {
+        TermEntry entry;
+        if (!findTerm(query.terms[termIndex], entry))
+            return 0;
+
+        entries.push_back(entry);
+        cursors.emplace_back(getPostings(entry));
+        positionCursors.push_back({NULL, 0});
+    }
+
+    vector<vector<uint32_t>> positions(entries.size());
+    size_t keptCount = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        DocId docId = docIds[i];
+        bool isMatch = true;
+
+        for (size_t word = 0; isMatch && word < entries.size(); word++)
+        {
+            PostingCursor &cursor = cursors[word];
+            isMatch = cursor.moveTo(docId) == docId;
+            if (isMatch)
+                getPositions(entries[word], cursor.getPosition(), positionCursors[word], positions[word]);
+        }
+
+        if (isMatch && matchesPositions(phrase, positions))
+            docIds[keptCount++] = docId;
+    }
+
+    return keptCount;
+}
+
+/**
+ * @brief Deletes every document and posting list
+ *
+ */
+void SearchIndex::clear()
+{
+    vector<char>().swap(builtImage);
+    mappedImage.close();
+
+    header = NULL;
+    documentEntries = NULL;
+    termBlocks = NULL;
+    strings = NULL;
+    termData = NULL;
+    postingBytes = NULL;
+    frequencies = NULL;
+    blockScores = NULL;
+    positionBlocks = NULL;
+    positionData = NULL;
+}
+
+/**
+ * @brief Finds the terms the automaton accepts
+ *
+ * Se recorre el diccionario en orden guardando el estado de cada prefijo, así
+ * que de cada término solo se leen los caracteres que no comparte con el
+ * anterior. Cuando un prefijo ya no puede coincidir, se saltea hasta el menor
+ * término que el autómata todavía podría aceptar (ver findNextFuzzyTerm()).
+ *
+ * @param automaton
+ * @param word          of the query, to fill the variants
+ * @param variants      the terms are added at the end
+ */
+void SearchIndex::findFuzzyTerms(const LevenshteinAutomaton &automaton, uint32_t word,
+                                 vector<TermVariant> &variants) const
+{
+    size_t stateSize = automaton.getStateSize();
+
+    // El estado después de cada byte del término actual
+    vector<uint8_t> states(stateSize);
+    automaton.start(states.data());
+
+    string previous;
+    size_t validLength = 0;     // de previous, con estados calculados
+
+    TermCursor cursor(*this);
+    while (!cursor.isAtEnd())
+    {
+        string_view text = cursor.getText();
+
+        // Los estados del prefijo común ya están, hasta el último caracter entero
+        size_t length = 0;
+        while (length < validLength && length < text.size() && text[length] == previous[length])
+            length++;
+        while (length > 0 && length < text.size() && ((unsigned char)text[length] & 0xc0) == 0x80)
+            length--;
+
+        states.resize((text.size() + 1) * stateSize);
+
+        bool isDead = false;
+        size_t start = 0;
+        uint32_t codepoint = 0;
+        while (length < text.size() && !isDead)
+        {
+            start = length;
+
+            size_t characterLength = decodeUtf8(text, start, codepoint);
+            if (!characterLength)
+            {
+                codepoint = (unsigned char)text[start];
+                characterLength = 1;
+            }
+
+            // Los bytes del medio de un caracter no cambian el estado
+            const uint8_t *startState = states.data() + start * stateSize;
+            for (length = start + 1; length < start + characterLength; length++)
+                memcpy(states.data() + length * stateSize, startState, stateSize);
+
+            uint8_t *state = states.data() + length * stateSize;
+            automaton.step(startState, codepoint, state);
+            isDead = !automaton.canMatch(state);
+        }
+
+        previous = text;
+        validLength = length;
+
+        if (isDead)
+        {
+            string next;
+            if (!findNextFuzzyTerm(automaton, previous, states, start, codepoint, next))
+                break;
+
+            cursor.moveTo(next);
+            continue;
+        }
+
+        const uint8_t *state = states.data() + length * stateSize;
+        if (automaton.isMatch(state))
+            variants.push_back({word, previous, automaton.getDistance(state),
+                                cursor.getEntry().documentFrequency});
+
+        cursor.next();
+    }
+}
+
+Document SearchIndex::getDocument(DocId docId) const
+{
+    const DocumentEntry &entry = documentEntries[docId];
+
+    return {getString(entry.pathOffset, entry.pathLength),
+            getString(entry.titleOffset, entry.titleLength),
+            entry.length,
+            entry.fileSize,
+            entry.modificationTime};
+}
+
+size_t SearchIndex::getDocumentCount() const
+{
+    return header ? header->documentCount : 0;
+}
+
+uint64_t SearchIndex::getTotalDocumentLength() const
+{
+    return header ? header->totalDocumentLength : 0;
+}
+
+/**
+ * @brief Number of pages that contain a term
+ *
+ * @param term              normalized
+ * @param deletedDocIds     pages not to count
+ * @return uint32_t
+ */
+uint32_t SearchIndex::getDocumentFrequency(string_view term, const vector<DocId> &deletedDocIds) const
+{
+    TermEntry entry;
+    if (!findTerm(term, entry))
+        return 0;
+
+    uint32_t documentFrequency = entry.documentFrequency;
+
+    PostingReader postings = getPostings(entry);
+    for (auto docId : deletedDocIds)
+    {
+        if (postings.contains(docId))
+            documentFrequency--;
+    }
+
+    return documentFrequency;
+}
+
+size_t SearchIndex::getTermCount() const
+{
+    return header ? header->termCount : 0;
+}
+
+/**
+ * @brief Size of the terms and their data, with the block table
+ *
+ * @return size_t
+ */
+size_t SearchIndex::getTermDictionaryBytes() const
+{
+    return header ? (header->stringsOffset - header->termBlocksOffset) +
+                        (header->postingsOffset - header->termDataOffset)
+                  : 0;
+}
+
+PostingCodec SearchIndex::getCodec() const
+{
+    return header ? (PostingCodec)header->codec : POSTING_CODEC_VARINT;
+}
+
+/**
+ * @brief Size of all the encoded posting lists
+ *
+ * @return size_t
+ */
+size_t SearchIndex::getPostingBytes() const
+{
+    return header ? header->frequenciesOffset - header->postingsOffset : 0;
+}
+
+bool SearchIndex::hasPositions() const
+{
+    return header && header->positionsOffset;
+}
+
+/**
+ * @brief Size of the positions of every posting, with their block table
+ *
+ * @return size_t
+ */
+size_t SearchIndex::getPositionBytes() const
+{
+    return hasPositions() ? header->fileSize - header->positionBlocksOffset : 0;
+}
+
+/**
+ * @brief Saves in disk the search index
+ *
+ * Se escribe primero a un archivo temporal y después se renombra, para que un
+ * corte a mitad de camino no deje un índice incompleto.
+ *
+ * @param filename
+ * @return true if the index was saved
+ */
+bool SearchIndex::save(const string &filename) const
+{
+    if (!header)
+        return false;
+
+    string temporaryFilename = filename + ".tmp";
+
+    {
+        ofstream file(temporaryFilename, ios::binary);
+
+        if (!file.is_open())
+            return false;
+
+        file.write((const char *)header, header->fileSize);
+
+        if (!file.good())
+            return false;
+    }
+
+    error_code error;
+    filesystem::rename(temporaryFilename, filename, error);
+
+    return !error;
+}
+
+/**
+ * @brief Checks if the index exists and in that case, maps it in memory, even
+ *        if the pages changed since it was built
+ *
+ * @param filename
+ * @return true if the index was read
+ * @return false if the index does not exist, is corrupt or has an old format
+ */
+bool SearchIndex::load(const string &filename)
+{
+    clear();
+
+    if (!mappedImage.open(filename))
+        return false;
+
+    if (!open(mappedImage.getData(), mappedImage.getSize()))
+    {
+        cout << "Índice corrupto o de otra versión" << endl;
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Checks if the index exists and in that case, maps it in memory
+ *
+ * @param filename
+ * @param wikiPath  directory the index was built from
+ * @return true if the index was read
+ * @return false if the index does not exist, is corrupt, has an old format or
+ *               the pages changed since it was built
+ */
+bool SearchIndex::load(const string &filename, const string &wikiPath)
+{
+    if (!load(filename))
+        return false;
+
+    if (!isUpToDate(wikiPath))
+    {
+        cout << "Índice desactualizado" << endl;
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Checks if any page was added, changed or deleted since the index was
+ *        built. Only looks at the sizes and dates of the pages
+ *
+ * @param wikiPath
+ * @return true if the index has the current pages
+ */
+bool SearchIndex::isUpToDate(const string &wikiPath) const
+{
+    return header && header->sourceStamp == computeSourceStamp(listPages(wikiPath));
+}
+
+/**
+ * @brief Validates an index image and points the accessors to it
+ *
+ * @param imageData
+ * @param imageSize
+ * @return true if the image is valid
+ */
+bool SearchIndex::open(const char *imageData, size_t imageSize)
+{
+    if (imageSize < sizeof(IndexHeader))
+        return false;
+
+    const IndexHeader *imageHeader = (const IndexHeader *)imageData;
+
+    if (memcmp(imageHeader->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) ||
+        imageHeader->version != INDEX_VERSION ||
+        imageHeader->fileSize != imageSize)
+        return false;
+
+    if (imageHeader->documentsOffset + imageHeader->documentCount * sizeof(DocumentEntry) > imageSize ||
+        imageHeader->termBlocksOffset + getTermBlockCount(imageHeader->termCount) * sizeof(TermBlock) > imageSize ||
+        imageHeader->stringsOffset > imageSize ||
+        imageHeader->termDataOffset > imageSize ||
+        imageHeader->postingsOffset > imageSize ||
+        imageHeader->frequenciesOffset > imageSize ||
+        imageHeader->blockScoresOffset > imageSize ||
+        imageHeader->positionBlocksOffset > imageSize ||
+        imageHeader->positionsOffset > imageSize)
+        return false;
+
+    uint64_t checksum = hashBytes(imageData + sizeof(IndexHeader),
+                                  imageSize - sizeof(IndexHeader),
+                                  HASH_SEED);
+    if (checksum != imageHeader->checksum)
+        return false;
+
+    header = imageHeader;
+    documentEntries = (const DocumentEntry *)(imageData + header->documentsOffset);
+    termBlocks = (const TermBlock *)(imageData + header->termBlocksOffset);
+    strings = imageData + header->stringsOffset;
+    termData = (const uint8_t *)(imageData + header->termDataOffset);
+    postingBytes = (const uint8_t *)(imageData + header->postingsOffset);
+    frequencies = (const uint8_t *)(imageData + header->frequenciesOffset);
+    blockScores = (const float *)(imageData + header->blockScoresOffset);
+
+    if (header->positionsOffset)
+    {
+        positionBlocks = (const uint64_t *)(imageData + header->positionBlocksOffset);
+        positionData = (const uint8_t *)(imageData + header->positionsOffset);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Splits a search in words and looks them up
+ *
+ * @param searchString
+ * @param terms         one entry per indexed word, in the order of the search
+ * @return true if every word is indexed
+ */
+bool SearchIndex::findTerms(const string &searchString, vector<TermEntry> &terms) const
+{
+    terms.clear();
+
+    bool allTermsFound = true;
+
+    string normalizedString;
+    vector<string_view> words;
+    normalizeTerms(searchString, normalizedString, words);
+
+    for (auto word : words)
+    {
+        TermEntry term;
+        if (findTerm(word, term))
+            terms.push_back(term);
+        else
+            allTermsFound = false;
+    }
+
+    return allTermsFound;
+}
+
+/**
+ * @brief Finds the pages that contain all the terms
+ *
+ * @param terms
+ * @param results   docIds in ascending order
+ */
+void SearchIndex::intersectTerms(const vector<TermEntry> &terms, vector<DocId> &results) const
+{
+    // Se separan todas las coincidencias para cada palabra
+    vector<PostingReader> partialResults;
+    for (auto &term : terms)
+        partialResults.push_back(getPostings(term));
+
+    // Solo se aceptan los docIds comunes a todas las coincidencias
+    intersectPostings(partialResults, results);
+}
+
+/**
+ * @brief Scores every page that contains the required terms and the phrases
+ *        of the query
+ *
+ * @param terms             all the terms of the query found in this index
+ * @param requiredPostings  one list per word every page needs
+ * @param query
+ * @param averageLength     of all the indexes searched together
+ * @param deletedDocIds     pages to skip, in ascending order
+ * @param maxResults
+ * @param results       best results, by decreasing score
+ * @return size_t       number of matching pages
+ */
+size_t SearchIndex::rankAllTerms(const vector<ScoredTerm> &terms,
+                                 vector<PostingReader> &requiredPostings,
+                                 const SearchQuery &query, float averageLength,
+                                 const vector<DocId> &deletedDocIds, size_t maxResults,
+                                 vector<SearchResult> &results) const
+{
+    vector<DocId> matches;
+    intersectPostings(requiredPostings, matches);
+    removeDeleted(matches, deletedDocIds);
+    matches.resize(filterPositions(query, matches.data(), matches.size()));
+
+    scoreMatches(terms, matches, averageLength, maxResults, results);
+
+    return matches.size();
+}
+
+/**
+ * @brief Scores the pages with the terms they contain
+ *
+ * @param terms
+ * @param matches           docIds in ascending order
+ * @param averageLength     of all the indexes searched together
+ * @param maxResults
+ * @param results           best results, by decreasing score
+ */
+void SearchIndex::scoreMatches(const vector<ScoredTerm> &terms, const vector<DocId> &matches,
+                               float averageLength, size_t maxResults,
+                               vector<SearchResult> &results) const
+{
+    if (matches.empty() || !maxResults)
+        return;
+
+    // La parte de BM25 que depende solo del largo de cada página
+    vector<float> lengthNorms(matches.size());
+    for (size_t i = 0; i < matches.size(); i++)
+        lengthNorms[i] = computeLengthNorm(documentEntries[matches[i]].length, averageLength);
+
+    vector<float> scores(matches.size(), 0);
+
+    for (auto &term : terms)
+    {
+        PostingCursor cursor(getPostings(term.entry));
+
+        const uint8_t *termFrequencies = frequencies + term.entry.frequenciesOffset;
+
+        // Con una frase en el modo OR, o con un OR, las otras palabras pueden faltar
+        for (size_t i = 0; i < matches.size(); i++)
+        {
+            if (cursor.moveTo(matches[i]) == matches[i])
+                scores[i] += computeTermScore(term.idf, termFrequencies[cursor.getPosition()], lengthNorms[i]);
+        }
+    }
+
+    for (size_t i = 0; i < matches.size(); i++)
+        addResult(results, maxResults, {matches[i], scores[i]});
+
+    sort_heap(results.begin(), results.end(), isBetterResult);
+}
+
+/**
+ * @brief Scores the pages that contain any of the terms, with Block-Max WAND
+ *
+ * Se recorren las listas en orden de docId. Una página solo se puntúa si la
+ * suma de los mayores puntajes de sus términos, primero en toda la lista y
+ * después en el bloque que la contiene, supera al peor resultado del heap; si
+ * no, se saltean todas las páginas hasta el final de esos bloques. Así la
+ * mayoría de las páginas de los términos frecuentes no se puntúan.
+ *
+ * @param terms
+ * @param averageLength     of all the indexes searched together
+ * @param deletedDocIds     pages to skip, in ascending order
+ * @param maxResults
+ * @param results       best results, by decreasing score
+ * @return size_t       number of matching pages
+ */
+size_t SearchIndex::rankAnyTerm(const vector<ScoredTerm> &terms, float averageLength,
+                                const vector<DocId> &deletedDocIds, size_t maxResults,
+                                vector<SearchResult> &results) const
+{
+    vector<PostingReader> postings;
+    for (auto &term : terms)
+        postings.push_back(getPostings(term.entry));
+
+    size_t matchCount = countPostingUnion(postings, header ? header->documentCount : 0);
+
+    // Las páginas borradas son pocas: se descuentan una por una
+    for (auto docId : deletedDocIds)
+    {
+        if (any_of(postings.begin(), postings.end(), [docId](const PostingReader &list)
+                   { return list.contains(docId); }))
+            matchCount--;
+    }
+
+    if (!matchCount || !maxResults)
+        return matchCount;
+
+    size_t termCount = terms.size();
+
+    // Cada cursor apunta a su propio buffer: con reserve() no se mueven
+    vector<PostingCursor> cursors;
+    cursors.reserve(termCount);
+
+    vector<float> idfs(termCount);
+
+    // Los términos ordenados por el docId actual de su cursor
+    vector<size_t> order(termCount);
+
+    for (size_t i = 0; i < termCount; i++)
+    {
+        cursors.emplace_back(postings[i]);
+        cursors[i].moveTo(0);
+
+        idfs[i] = terms[i].idf;
+        order[i] = i;
+    }
+
+    auto getMaxScore = [&](size_t term)
+    { return terms[term].entry.maxScore * terms[term].boundScale; };
+
+    auto getBlockScore = [&](size_t term, DocId docId)
+    { return blockScores[terms[term].entry.blockScoresOffset + cursors[term].findBlock(docId)] *
+             terms[term].boundScale; };
+
+    float threshold = 0;
+
+    while (true)
+    {
+        sort(order.begin(), order.end(),
+             [&](size_t a, size_t b)
+             { return cursors[a].getDocId() < cursors[b].getDocId(); });
+
+        // El pivote es el primer docId que podría superar al peor resultado
+        float upperBound = 0;
+        size_t pivot = termCount;
+        for (size_t i = 0; i < termCount && cursors[order[i]].getDocId() != POSTING_END; i++)
+        {
+            upperBound += getMaxScore(order[i]);
+            if (upperBound > threshold)
+            {
+                pivot = i;
+                break;
+            }
+        }
+
+        if (pivot == termCount)
+            break;
+
+        DocId pivotDocId = cursors[order[pivot]].getDocId();
+        while (pivot + 1 < termCount && cursors[order[pivot + 1]].getDocId() == pivotDocId)
+            pivot++;
+
+        float blockUpperBound = 0;
+        for (size_t i = 0; i <= pivot; i++)
+            blockUpperBound += getBlockScore(order[i], pivotDocId);
+
+        if (blockUpperBound > threshold)
+        {
+            if (cursors[order[0]].getDocId() == pivotDocId)
+            {
+                float lengthNorm = computeLengthNorm(documentEntries[pivotDocId].length, averageLength);
+                float score = 0;
+
+                for (size_t i = 0; i <= pivot; i++)
+                {
+                    size_t term = order[i];
+                    uint8_t frequency = frequencies[terms[term].entry.frequenciesOffset + cursors[term].getPosition()];
+
+                    score += computeTermScore(idfs[term], frequency, lengthNorm);
+                    cursors[term].moveTo(pivotDocId + 1);
+                }
+
+                if (!binary_search(deletedDocIds.begin(), deletedDocIds.end(), pivotDocId))
+                    addResult(results, maxResults, {pivotDocId, score});
+            }
+            else
+            {
+                // Se adelanta hasta el pivote un término que está antes
+                size_t i = pivot;
+                while (cursors[order[i]].getDocId() == pivotDocId)
+                    i--;
+
+                cursors[order[i]].moveTo(pivotDocId);
+            }
+        }
+        else
+        {
+            // Ninguna página antes de que termine alguno de estos bloques, o
+            // antes del siguiente término, puede entrar
+            uint64_t nextDocId = (pivot + 1 < termCount) ? cursors[order[pivot + 1]].getDocId() : POSTING_END;
+            size_t bestTerm = order[0];
+
+            for (size_t i = 0; i <= pivot; i++)
+            {
+                size_t term = order[i];
+                DocId blockMax = cursors[term].getBlockMax(cursors[term].findBlock(pivotDocId));
+
+                nextDocId = min(nextDocId, (uint64_t)blockMax + 1);
+                if (getMaxScore(term) > getMaxScore(bestTerm))
+                    bestTerm = term;
+            }
+
+            cursors[bestTerm].moveTo((DocId)min(nextDocId, (uint64_t)POSTING_END));
+        }
+
+        if (results.size() == maxResults)
+            threshold = results.front().score;
+    }
+
+    sort_heap(results.begin(), results.end(), isBetterResult);
+
+    return matchCount;
+}
+
+float SearchIndex::getAverageLength() const
+{
+    return (float)header->totalDocumentLength / header->documentCount;
+}
+
+/**
+ * @brief Looks up a term: bisects the blocks and reads only one
+ *
+ * @param term
+ * @param entry
+ * @return true if the term is indexed
+ */
+bool SearchIndex::findTerm(string_view term, TermEntry &entry) const
+{
+    if (!header || term.empty())
+        return false;
+
+    TermCursor cursor(*this, term);
+    if (cursor.isAtEnd() || cursor.getText() != term)
+        return false;
+
+    entry = cursor.getEntry();
+
+    return true;
+}
+
+/**
+ * @brief The first term of a block, which is stored whole
+ *
+ * @param block
+ * @return string_view
+ */
+string_view SearchIndex::getBlockFirstTerm(size_t block) const
+{
+    uint32_t prefixLength;
+    uint32_t suffixLength;
+
+    const uint8_t *input = termData + termBlocks[block].dataOffset;
+    input = readVarint(input, prefixLength);
+    input = readVarint(input, suffixLength);
+
+    return string_view((const char *)input, suffixLength);
+}
+
+string_view SearchIndex::getString(uint32_t offset, uint32_t length) const
+{
+    return string_view(strings + offset, length);
+}
+
+PostingReader SearchIndex::getPostings(const TermEntry &term) const
+{
+    return PostingReader(postingBytes + term.postingsOffset, term.documentFrequency,
+                         (PostingEncoding)term.encoding, header->documentCount);
+}
+
+/**
+ * @brief Decodes the positions of a term in one page. Solo se saltean las
+ *        listas anteriores del mismo bloque, desde donde quedó el cursor si
+ *        está en ese bloque
+ *
+ * @param term
+ * @param posting       number of the posting in the list (ver
+ *                      PostingCursor::getPosition())
+ * @param cursor        where the previous call for the term stopped, or
+ *                      input == NULL
+ * @param positions
+ */
+void SearchIndex::getPositions(const TermEntry &term, size_t posting, PositionCursor &cursor,
+                               vector<uint32_t> &positions) const
+{
+    size_t block = posting / POSTING_BLOCK_SIZE;
+
+    if (!cursor.input || cursor.posting > posting || cursor.posting / POSTING_BLOCK_SIZE != block)
+    {
+        cursor.input = positionData + positionBlocks[term.positionBlocksOffset + block];
+        cursor.posting = block * POSTING_BLOCK_SIZE;
+    }
+
+    for (; cursor.posting < posting; cursor.posting++)
+        cursor.input = skipPositions(cursor.input);
+
+    cursor.input = decodePositions(cursor.input, positions);
+    cursor.posting++;
+}
+
+/**
+ * @brief Positions the cursor on the first term not less than the given one
+ *
+ * @param index
+ * @param term  empty to start from the first term
+ */
+TermCursor::TermCursor(const SearchIndex &index, string_view term)
+    : index(&index), termIndex(0), input(NULL), entry()
+{
+    size_t termCount = index.getTermCount();
+    if (!termCount)
+        return;
+
+    // El último bloque que empieza antes del término
+    size_t blockCount = getTermBlockCount(termCount);
+    size_t low = 0;
+    size_t high = blockCount;
+    while (high - low > 1)
+    {
+        size_t middle = (low + high) / 2;
+        if (index.getBlockFirstTerm(middle) <= term)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    termIndex = low * TERM_BLOCK_SIZE;
+    input = index.termData + index.termBlocks[low].dataOffset;
+    readTerm();
+
+    while (!isAtEnd() && string_view(text) < term)
+        next();
+}
+
+bool TermCursor::isAtEnd() const
+{
+    return termIndex >= index->getTermCount();
+}
+
+void TermCursor::next()
+{
+    termIndex++;
+    if (!isAtEnd())
+        readTerm();
+}
+
+/**
+ * @brief Skips the rest of the terms of the current block
+ *
+ */
+void TermCursor::nextBlock()
+{
+    termIndex = (termIndex / TERM_BLOCK_SIZE + 1) * TERM_BLOCK_SIZE;
+    if (!isAtEnd())
+        readTerm();
+}
+
+/**
+ * @brief Advances to the first term not less than the given one
+ *
+ * Como suele estar cerca, se buscan los bloques siguientes con saltos que se
+ * duplican, y recién después se bisecta.
+ *
+ * @param term  not less than the current term
+ */
+void TermCursor::moveTo(string_view term)
+{
+    size_t blockCount = getTermBlockCount(index->getTermCount());
+    size_t block = termIndex / TERM_BLOCK_SIZE;
+
+    if (isAtEnd() || string_view(text) >= term)
+        return;
+
+    // El último bloque que empieza antes del término está en [low, high)
+    size_t low = block;
+    size_t high = block + 1;
+    for (size_t step = 1; high < blockCount && index->getBlockFirstTerm(high) <= term; step *= 2)
+    {
+        low = high;
+        high = min(high + step, blockCount);
+    }
+
+    while (high - low > 1)
+    {
+        size_t middle = (low + high) / 2;
+        if (index->getBlockFirstTerm(middle) <= term)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    if (low != block)
+    {
+        termIndex = low * TERM_BLOCK_SIZE;
+        readTerm();
+    }
+
+    while (!isAtEnd() && string_view(text) < term)
+        next();
+}
+
+/**
+ * @brief The highest document frequency of the terms of the current block
+ *
+ * @return uint32_t
+ */
+uint32_t TermCursor::getBlockMaxFrequency() const
+{
+    return index->termBlocks[termIndex / TERM_BLOCK_SIZE].maxDocumentFrequency;
+}
+
+string_view TermCursor::getText() const
+{
+    return text;
+}
+
+const TermEntry &TermCursor::getEntry() const
+{
+    return entry;
+}
+
+/**
+ * @brief Decodes the term at termIndex, which starts at input
+ *
+ */
+void TermCursor::readTerm()
+{
+    if (termIndex % TERM_BLOCK_SIZE == 0)
+    {
+        const TermBlock &block = index->termBlocks[termIndex / TERM_BLOCK_SIZE];
+
+        input = index->termData + block.dataOffset;
+        entry.postingsOffset = block.postingsOffset;
+        entry.frequenciesOffset = block.frequenciesOffset;
+        entry.blockScoresOffset = block.blockScoresOffset;
+        entry.positionBlocksOffset = block.positionBlocksOffset;
+    }
+    else
+    {
+        // Se saltean los datos del término anterior
+        bool isBitmap = entry.encoding == POSTING_ENCODING_BITMAP;
+
+        entry.frequenciesOffset += entry.documentFrequency;
+        entry.blockScoresOffset += getBlockCount(isBitmap ? index->header->documentCount
+                                                          : entry.documentFrequency);
+        if (index->hasPositions())
+            entry.positionBlocksOffset += getBlockCount(entry.documentFrequency);
+    }
+
+    uint32_t prefixLength;
+    uint32_t suffixLength;
+    uint32_t postingsDelta;
+
+    input = readVarint(input, prefixLength);
+    input = readVarint(input, suffixLength);
+    text.resize(prefixLength);
+    text.append((const char *)input, suffixLength);
+    input += suffixLength;
+
+    input = readVarint(input, entry.documentFrequency);
+    entry.encoding = *input++;
+    input = readVarint(input, postingsDelta);
+    entry.postingsOffset += postingsDelta;
+
+    memcpy(&entry.maxScore, input, sizeof(float));
+    input += sizeof(float);
+}
+
+/**
+ * @brief Lists the pages to index, sorted so that docIds do not depend on the
+ *        order in which the file system returns them
+ *
+ * @param wikiPath
+ * @return vector<filesystem::path>
+ */
+vector<filesystem::path> listPages(const string &wikiPath)
+{
+    vector<filesystem::path> fileList;
+
+    error_code error;
+    for (auto &file : filesystem::directory_iterator(filesystem::absolute(wikiPath), error))
+    {
+        if (filesystem::is_regular_file(file.path()))
+            fileList.push_back(file.path());
+    }
+    sort(fileList.begin(), fileList.end());
+
+    return fileList;
+}
+
+/**
+ * @brief Path of a page as it is shown in the results, from "/wiki" on
+ *
+ * @param filePath
+ * @return string
+ */
+string getDocumentPath(const filesystem::path &filePath)
+{
+    string path = filePath.string();
+
+    return path.substr(path.find("/wiki"));
+}
+
+/**
+ * @brief Adds to a query the variants of its fuzzy words, from all the
+ *        indexes searched together
+ *
+ * @param query
+ * @param indexes
+ */
+void expandFuzzyTerms(SearchQuery &query, const vector<const SearchIndex *> &indexes)
+{
+    vector<TermVariant> variants;
+
+    for (size_t word = 0; word < query.maxEdits.size(); word++)
+    {
+        if (!query.maxEdits[word])
+            continue;
+
+        LevenshteinAutomaton automaton(query.terms[word], query.maxEdits[word]);
+
+        vector<TermVariant> wordVariants;
+        for (auto index : indexes)
+            index->findFuzzyTerms(automaton, (uint32_t)word, wordVariants);
+
+        // Un término de varios índices se cuenta una sola vez
+        sort(wordVariants.begin(), wordVariants.end(), [](const TermVariant &a, const TermVariant &b)
+             { return a.term < b.term; });
+
+        vector<TermVariant> uniqueVariants;
+        for (auto &variant : wordVariants)
+        {
+            if (!uniqueVariants.empty() && uniqueVariants.back().term == variant.term)
+                uniqueVariants.back().documentFrequency += variant.documentFrequency;
+            else if (variant.distance)
+                uniqueVariants.push_back(move(variant));
+        }
+
+        sort(uniqueVariants.begin(), uniqueVariants.end(), [](const TermVariant &a, const TermVariant &b)
+             { return a.distance < b.distance ||
+                      (a.distance == b.distance && (a.documentFrequency > b.documentFrequency ||
+                                                    (a.documentFrequency == b.documentFrequency && a.term < b.term))); });
+        if (uniqueVariants.size() > MAX_FUZZY_VARIANTS)
+            uniqueVariants.resize(MAX_FUZZY_VARIANTS);
+
+        variants.insert(variants.end(), uniqueVariants.begin(), uniqueVariants.end());
+    }
+
+    if (!variants.empty())
+        addTermVariants(query, variants);
+}
+
+/**
+ * @brief Reads the size and modification time of a page
+ *
+ * @param filePath
+ * @param document  entry of the document table to complete
+ */
+void getFileStamp(const filesystem::path &filePath, ParsedDocument &document)
+{
+    error_code error;
+    document.fileSize = filesystem::file_size(filePath, error);
+    document.modificationTime = filesystem::last_write_time(filePath, error).time_since_epoch().count();
+}
+
+/**
+ * @brief Reads the size and modification time of every page
+ *
+ * @param fileList
+ * @param documents     one per page, to complete
+ * @return uint64_t     the source stamp of the pages (ver computeSourceStamp())
+ */
+static uint64_t getFileStamps(const vector<filesystem::path> &fileList, vector<ParsedDocument> &documents)
+{
+    uint64_t hash = HASH_SEED;
+
+    for (size_t i = 0; i < fileList.size(); i++)
+    {
+        getFileStamp(fileList[i], documents[i]);
+        hash = hashFileStamp(fileList[i], documents[i], hash);
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Hashes the name, size and modification time of every page, to detect
+ *        if an index on disk is out of date
+ *
+ * @param fileList
+ * @return uint64_t
+ */
+static uint64_t computeSourceStamp(const vector<filesystem::path> &fileList)
+{
+    uint64_t hash = HASH_SEED;
+
+    ParsedDocument document;
+    for (auto &file : fileList)
+    {
+        getFileStamp(file, document);
+        hash = hashFileStamp(file, document, hash);
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Adds the name, size and modification time of a page to a hash
+ *
+ * @param filePath
+ * @param document  with the size and modification time of the page
+ * @param hash
+ * @return uint64_t
+ */
+static uint64_t hashFileStamp(const filesystem::path &filePath, const ParsedDocument &document,
+                              uint64_t hash)
+{
+    string filename = filePath.filename().string();
+
+    hash = hashBytes(filename.data(), filename.size(), hash);
+    hash = hashBytes(&document.fileSize, sizeof(document.fileSize), hash);
+    hash = hashBytes(&document.modificationTime, sizeof(document.modificationTime), hash);
+
+    return hash;
+}
+
+/**
+ * @brief FNV-1a hash
+ *
+ * @param data
+ * @param size
+ * @param hash  previous hash, to continue hashing
+ * @return uint64_t
+ */
+static uint64_t hashBytes(const void *data, size_t size, uint64_t hash)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static size_t getTermBlockCount(size_t termCount)
+{
+    return (termCount + TERM_BLOCK_SIZE - 1) / TERM_BLOCK_SIZE;
+}
+
+// Bloques de POSTING_BLOCK_SIZE, como los de PostingReader
+static uint64_t getBlockCount(uint64_t count)
+{
+    return (count + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+}
+
+/**
+ * @brief Finds the smallest string after a term that the automaton could
+ *        still accept
+ *
+ * Se cambia el caracter que hizo imposible la coincidencia por el siguiente
+ * que no la impide; si no hay ninguno, el caracter anterior, y así hacia
+ * atrás. Todo lo que queda en el medio empieza con un prefijo sin salida.
+ *
+ * @param automaton
+ * @param text      the term
+ * @param states    after each byte of the term, up to depth
+ * @param depth     where the character that made it impossible starts
+ * @param after     that character
+ * @param next
+ * @return true if there is one
+ */
+static bool findNextFuzzyTerm(const LevenshteinAutomaton &automaton, const string &text,
+                              const vector<uint8_t> &states, size_t depth, uint32_t after, string &next)
+{
+    size_t stateSize = automaton.getStateSize();
+
+    while (true)
+    {
+        uint32_t codepoint;
+        if (automaton.findNextCodepoint(states.data() + depth * stateSize, after, codepoint))
+        {
+            char bytes[4];
+            next.assign(text, 0, depth);
+            next.append(bytes, encodeUtf8(codepoint, bytes));
+
+            return true;
+        }
+
+        if (!depth)
+            return false;
+
+        do
+            depth--;
+        while (depth > 0 && ((unsigned char)text[depth] & 0xc0) == 0x80);
+
+        if (!decodeUtf8(text, depth, after))
+            after = (unsigned char)text[depth];
+    }
+}
+
+/**
+ * @brief Lays out the documents and posting lists in the binary index format
+ *
+ * @param documents
+ * @param shards        partial indexes without terms in common
+ * @param sourceStamp
+ * @param codec
+ * @param storePositions
+ * @param image         the resulting index
+ */
+static void writeImage(const vector<ParsedDocument> &documents, const vector<const PartialIndex *> &shards,
+                       uint64_t sourceStamp, PostingCodec codec, bool storePositions,
+                       vector<char> &image)
+{
+    size_t termCount = 0;
+    for (auto shard : shards)
+        termCount += shard->size();
+
+    vector<const PartialIndex::value_type *> sortedTerms;
+    sortedTerms.reserve(termCount);
+    for (auto shard : shards)
+    {
+        for (auto &entry : *shard)
+        {
+            if (entry.first.size() <= MAX_TERM_LENGTH)
+                sortedTerms.push_back(&entry);
+        }
+    }
+    sort(sortedTerms.begin(), sortedTerms.end(),
+         [](const PartialIndex::value_type *a, const PartialIndex::value_type *b)
+         { return a->first < b->first; });
+
+    string stringData;
+    vector<DocumentEntry> documentEntries(documents.size());
+    vector<TermBlock> termBlocks;
+    vector<uint8_t> termData;
+    vector<uint8_t> postingData;
+    vector<uint8_t> frequencyData;
+    vector<float> blockScoreData;
+    vector<uint64_t> positionBlockData;
+    vector<uint8_t> positionData;
+    vector<DocId> docIds;
+    uint64_t totalDocumentLength = 0;
+
+    for (size_t i = 0; i < documents.size(); i++)
+    {
+        documentEntries[i].pathOffset = (uint32_t)stringData.size();
+        documentEntries[i].pathLength = (uint32_t)documents[i].path.size();
+        stringData += documents[i].path;
+
+        documentEntries[i].titleOffset = (uint32_t)stringData.size();
+        documentEntries[i].titleLength = (uint32_t)documents[i].title.size();
+        stringData += documents[i].title;
+
+        documentEntries[i].length = documents[i].length;
+        documentEntries[i].reserved = 0;
+        documentEntries[i].fileSize = documents[i].fileSize;
+        documentEntries[i].modificationTime = documents[i].modificationTime;
+        totalDocumentLength += documents[i].length;
+    }
+
+    // Igual que SearchIndex::getAverageLength(), para que las cotas coincidan
+    float averageLength = (float)totalDocumentLength / documents.size();
+
+    uint64_t previousPostingsOffset = 0;
+    for (size_t i = 0; i < sortedTerms.size(); i++)
+    {
+        const pmr::string &term = sortedTerms[i]->first;
+        const PostingList &postingList = sortedTerms[i]->second.postings;
+
+        TermEntry entry;
+        docIds.clear();
+        entry.frequenciesOffset = frequencyData.size();
+        for (auto &posting : postingList)
+        {
+            docIds.push_back(posting.docId);
+            frequencyData.push_back((uint8_t)min(posting.frequency, MAX_FREQUENCY));
+        }
+
+        size_t offset;
+        entry.encoding = (uint8_t)encodePostings(docIds.data(), docIds.size(),
+                                                          codec, (uint32_t)documents.size(),
+                                                          postingData, offset);
+        entry.documentFrequency = (uint32_t)postingList.size();
+        entry.postingsOffset = offset;
+
+        // Mismos bloques que PostingReader: de docIds en los bitmaps, de
+        // postings en el resto
+        bool isBitmap = entry.encoding == POSTING_ENCODING_BITMAP;
+        size_t blockCount = getBlockCount(isBitmap ? documents.size() : postingList.size());
+
+        entry.blockScoresOffset = blockScoreData.size();
+        blockScoreData.resize(blockScoreData.size() + blockCount, 0);
+
+        float *termBlockScores = blockScoreData.data() + entry.blockScoresOffset;
+        float idf = computeIdf((uint32_t)postingList.size(), (uint32_t)documents.size());
+
+        entry.maxScore = 0;
+        for (size_t j = 0; j < postingList.size(); j++)
+        {
+            const Posting &posting = postingList[j];
+
+            float lengthNorm = computeLengthNorm(documents[posting.docId].length, averageLength);
+            float score = computeTermScore(idf, frequencyData[entry.frequenciesOffset + j], lengthNorm);
+
+            float &blockScore = termBlockScores[(isBitmap ? posting.docId : j) / POSTING_BLOCK_SIZE];
+            blockScore = max(blockScore, score);
+            entry.maxScore = max(entry.maxScore, score);
+        }
+
+        entry.positionBlocksOffset = positionBlockData.size();
+        if (storePositions)
+        {
+            const pmr::vector<uint8_t> &termPositions = sortedTerms[i]->second.positions;
+
+            const uint8_t *input = termPositions.data();
+            for (size_t j = 0; j < postingList.size(); j++)
+            {
+                if (j % POSTING_BLOCK_SIZE == 0)
+                    positionBlockData.push_back(positionData.size() + (input - termPositions.data()));
+
+                input = skipPositions(input);
+            }
+
+            positionData.insert(positionData.end(), termPositions.begin(), termPositions.end());
+        }
+
+        // Los offsets de los términos que siguen en el bloque se deducen de
+        // los tamaños, salvo el de las postings, que puede tener relleno
+        size_t prefixLength = 0;
+        uint64_t postingsDelta = 0;
+        if (i % TERM_BLOCK_SIZE == 0)
+            termBlocks.push_back({termData.size(), entry.postingsOffset, entry.frequenciesOffset,
+                                  entry.blockScoresOffset, entry.positionBlocksOffset, 0, 0});
+        else
+        {
+            const pmr::string &previousTerm = sortedTerms[i - 1]->first;
+            while (prefixLength < term.size() && prefixLength < previousTerm.size() &&
+                   term[prefixLength] == previousTerm[prefixLength])
+                prefixLength++;
+
+            postingsDelta = entry.postingsOffset - previousPostingsOffset;
+        }
+        previousPostingsOffset = entry.postingsOffset;
+
+        termBlocks.back().maxDocumentFrequency = max(termBlocks.back().maxDocumentFrequency,
+                                                     entry.documentFrequency);
+
+        writeVarint((uint32_t)prefixLength, termData);
+        writeVarint((uint32_t)(term.size() - prefixLength), termData);
+        termData.insert(termData.end(), term.begin() + prefixLength, term.end());
+        writeVarint(entry.documentFrequency, termData);
+        termData.push_back(entry.encoding);
+        writeVarint((uint32_t)postingsDelta, termData);
+
+        uint8_t maxScoreBytes[sizeof(float)];
+        memcpy(maxScoreBytes, &entry.maxScore, sizeof(float));
+        termData.insert(termData.end(), maxScoreBytes, maxScoreBytes + sizeof(float));
+    }
+
+    auto align = [](uint64_t offset)
+    { return (offset + 7) & ~(uint64_t)7; };
+
+    IndexHeader header = {};
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.documentCount = (uint32_t)documentEntries.size();
+    header.termCount = (uint32_t)sortedTerms.size();
+    header.codec = codec;
+    header.totalDocumentLength = totalDocumentLength;
+    header.sourceStamp = sourceStamp;
+    header.documentsOffset = align(sizeof(IndexHeader));
+    header.termBlocksOffset = align(header.documentsOffset + documentEntries.size() * sizeof(DocumentEntry));
+    header.stringsOffset = align(header.termBlocksOffset + termBlocks.size() * sizeof(TermBlock));
+    header.termDataOffset = header.stringsOffset + stringData.size();
+    header.postingsOffset = align(header.termDataOffset + termData.size());
+    header.frequenciesOffset = header.postingsOffset + postingData.size();
+    header.blockScoresOffset = align(header.frequenciesOffset + frequencyData.size());
+    header.fileSize = header.blockScoresOffset + blockScoreData.size() * sizeof(float);
+    if (storePositions)
+    {
+        header.positionBlocksOffset = align(header.fileSize);
+        header.positionsOffset = header.positionBlocksOffset + positionBlockData.size() * sizeof(uint64_t);
+        header.fileSize = header.positionsOffset + positionData.size();
+    }
+
+    image.assign(header.fileSize, 0);
+    memcpy(image.data() + header.documentsOffset, documentEntries.data(), documentEntries.size() * sizeof(DocumentEntry));
+    memcpy(image.data() + header.termBlocksOffset, termBlocks.data(), termBlocks.size() * sizeof(TermBlock));
+    memcpy(image.data() + header.stringsOffset, stringData.data(), stringData.size());
+    memcpy(image.data() + header.termDataOffset, termData.data(), termData.size());
+    memcpy(image.data() + header.postingsOffset, postingData.data(), postingData.size());
+    memcpy(image.data() + header.frequenciesOffset, frequencyData.data(), frequencyData.size());
+    memcpy(image.data() + header.blockScoresOffset, blockScoreData.data(), blockScoreData.size() * sizeof(float));
+    if (storePositions)
+    {
+        memcpy(image.data() + header.positionBlocksOffset, positionBlockData.data(), positionBlockData.size() * sizeof(uint64_t));
+        memcpy(image.data() + header.positionsOffset, positionData.data(), positionData.size());
+    }
+
+    header.checksum = hashBytes(image.data() + sizeof(IndexHeader),
+                                image.size() - sizeof(IndexHeader),
+                                HASH_SEED);
+    memcpy(image.data(), &header, sizeof(IndexHeader));
+}
+
+/**
+ * @brief Inverse document frequency, as in BM25: rare terms weigh more
+ *
+ * @param documentFrequency
+ * @param documentCount
+ * @return float
+ */
+static float computeIdf(uint32_t documentFrequency, uint32_t documentCount)
+{
+    return log(1 + (documentCount - documentFrequency + 0.5F) / (documentFrequency + 0.5F));
+}
+
+/**
+ * @brief The part of BM25 that depends only on the length of the page
+ *
+ * @param length
+ * @param averageLength
+ * @return float
+ */
+static float computeLengthNorm(uint32_t length, float averageLength)
+{
+    return BM25_K1 * (1 - BM25_B + BM25_B * length / averageLength);
+}
+
+/**
+ * @brief BM25 score of one term in one page
+ *
+ * @param idf
+ * @param frequency     times the term appears in the page
+ * @param lengthNorm
+ * @return float
+ */
+static float computeTermScore(float idf, float frequency, float lengthNorm)
+{
+    return idf * frequency * (BM25_K1 + 1) / (frequency + lengthNorm);
+}
+
+/**
+ * @brief Best score first; with the same score, the lower docId
+ *
+ */
+static bool isBetterResult(const SearchResult &a, const SearchResult &b)
+{
+    return a.score > b.score || (a.score == b.score && a.docId < b.docId);
+}
+
+/**
+ * @brief Keeps the best maxResults results in a heap, with the worst on top
+ *
+ * @param heap
+ * @param maxResults
+ * @param result
+ */
+static void addResult(vector<SearchResult> &heap, size_t maxResults, const SearchResult &result)
+{
+    if (heap.size() < maxResults)
+    {
+        heap.push_back(result);
+        push_heap(heap.begin(), heap.end(), isBetterResult);
+    }
+    else if (maxResults && isBetterResult(result, heap.front()))
+    {
+        pop_heap(heap.begin(), heap.end(), isBetterResult);
+        heap.back() = result;
+        push_heap(heap.begin(), heap.end(), isBetterResult);
+    }
+}
+
+/**
+ * @brief Removes the deleted pages from a list of docIds
+ *
+ * @param docIds            in ascending order
+ * @param deletedDocIds     in ascending order
+ */
+static void removeDeleted(vector<DocId> &docIds, const vector<DocId> &deletedDocIds)
+{
+    if (deletedDocIds.empty())
+        return;
+
+    auto end = set_difference(docIds.begin(), docIds.end(),
+                              deletedDocIds.begin(), deletedDocIds.end(), docIds.begin());
+    docIds.erase(end, docIds.end());
+}
+
+/**
+ * @brief Adds the words of one page to the partial index of the current thread
+ *
+ * @param filePath
+ * @param docId
+ * @param storePositions
+ * @param document  entry of the document table to complete
+ * @param shards    partial index of the current thread
+ */
+static void indexFile(const filesystem::path &filePath, DocId docId, bool storePositions,
+                      ParsedDocument &document, vector<unique_ptr<PartialIndexArena>> &shards)
+{
+    document.path = getDocumentPath(filePath);
+    document.length = 0;
+
+    MappedFile file;
+    if (!file.open(filePath.string()))
+        return;
+
+    HtmlTokenizer tokenizer(string_view(file.getData(), file.getSize()));
+
+    hash<string_view> hashTerm;
+
+    // Se reutilizan los mismos buffers para todas las palabras
+    string normalizedToken;
+    vector<string_view> terms;
+    pmr::string word;
+    string_view token;
+
+    // Cada aparición de cada término, para escribir sus posiciones al final
+    vector<pair<TermPostings *, uint32_t>> occurrences;
+
+    while (tokenizer.next(token))
+    {
+        // Una palabra como "«Agua»" o "1/2" puede dar más de un término
+        normalizeTerms(token, normalizedToken, terms);
+
+        for (auto term : terms)
+        {
+            word.assign(term);
+
+            // Los documentos de un hilo se recorren en orden de docId, así que
+            // alcanza con mirar el último para contar las repeticiones
+            TermPostings &termPostings = shards[hashTerm(word) % shards.size()]->terms[word];
+            PostingList &postingList = termPostings.postings;
+            if (postingList.empty() || postingList.back().docId != docId)
+                postingList.push_back({docId, 1});
+            else
+                postingList.back().frequency++;
+
+            if (storePositions)
+                occurrences.push_back({&termPostings, document.length});
+
+            document.length++;
+        }
+    }
+
+    document.title = tokenizer.getTitle();
+
+    // Las apariciones de un mismo término quedan juntas y en orden. Los nodos
+    // de unordered_map no se mueven, así que los punteros siguen valiendo
+    sort(occurrences.begin(), occurrences.end());
+
+    vector<uint32_t> positions;
+    vector<uint8_t> encodedPositions;
+    for (size_t i = 0; i < occurrences.size();)
+    {
+        TermPostings *termPostings = occurrences[i].first;
+
+        positions.clear();
+        for (; i < occurrences.size() && occurrences[i].first == termPostings; i++)
+            positions.push_back(occurrences[i].second);
+
+        encodedPositions.clear();
+        encodePositions(positions.data(), positions.size(), encodedPositions);
+        termPostings->positions.insert(termPostings->positions.end(),
+                                       encodedPositions.begin(), encodedPositions.end());
+    }
+}
+
+/**
+ * @brief Adds postings to a posting list, keeping it sorted by docId. Las dos
+ *        listas ya están ordenadas y no tienen docIds en común
+ *
+ * @param termPostings
+ * @param newPostings
+ */
+static void mergePostings(TermPostings &termPostings, const TermPostings &newPostings)
+{
+    PostingList &postingList = termPostings.postings;
+
+    if (postingList.empty())
+    {
+        termPostings = newPostings;
+        return;
+    }
+
+    // Con posiciones, las dos listas se recorren juntas para llevar las de
+    // cada posting
+    if (!newPostings.positions.empty())
+    {
+        // En la misma arena, para poder intercambiarlas
+        PostingList mergedPostings(postingList.get_allocator());
+        pmr::vector<uint8_t> mergedPositions(termPostings.positions.get_allocator());
+        mergedPostings.reserve(postingList.size() + newPostings.postings.size());
+        mergedPositions.reserve(termPostings.positions.size() + newPostings.positions.size());
+
+        const uint8_t *positions[2] = {termPostings.positions.data(), newPostings.positions.data()};
+        const PostingList *lists[2] = {&postingList, &newPostings.postings};
+        size_t next[2] = {0, 0};
+
+        while (next[0] < lists[0]->size() || next[1] < lists[1]->size())
+        {
+            int list = (next[1] == lists[1]->size() ||
+                        (next[0] < lists[0]->size() && (*lists[0])[next[0]].docId < (*lists[1])[next[1]].docId))
+                           ? 0
+                           : 1;
+
+            mergedPostings.push_back((*lists[list])[next[list]++]);
+
+            const uint8_t *end = skipPositions(positions[list]);
+            mergedPositions.insert(mergedPositions.end(), positions[list], end);
+            positions[list] = end;
+        }
+
+        postingList.swap(mergedPostings);
+        termPostings.positions.swap(mergedPositions);
+        return;
+    }
+
+    size_t middle = postingList.size();
+
+    postingList.insert(postingList.end(), newPostings.postings.begin(), newPostings.postings.end());
+    inplace_merge(postingList.begin(), postingList.begin() + middle, postingList.end(),
+                  [](const Posting &a, const Posting &b)
+                  { return a.docId < b.docId; });
+}
+
+/**
+ * @brief Runs task(0) ... task(threadCount - 1), each one on its own thread
+ *
+ * @param threadCount
+ * @param task
+ */
+static void runInParallel(unsigned int threadCount, const function<void(unsigned int)> &task)
+{
+    vector<thread> threads;
+
+    for (unsigned int i = 1; i < threadCount; i++)
+        threads.emplace_back(task, i);
+
+    task(0);
+
+    for (auto &thread : threads)
+        thread.join();
+}
@@ -0,0 +1,337 @@
+/**
+ * @file SearchIndex.h
+ * @authors Marc S. Ressl, Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief EDAoogle inverted index
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LevenshteinAutomaton.h"
+#include "MappedFile.h"
+#include "PostingCodec.h"
+#include "PostingIntersection.h"
+#include "QueryPlan.h"
+#include "SearchQuery.h"
+
+struct Posting
+{
+    DocId docId;
+    uint32_t frequency;
+};
+
+// Mientras se arma el índice, sale de la arena de su término (ver SearchIndex::buildImage())
+typedef std::pmr::vector<Posting> PostingList;
+
+struct SearchIndexOptions
+{
+    unsigned int threadCount;
+    PostingCodec codec;
+    bool storePositions;    // para buscar frases (ver SearchQuery.h)
+};
+
+struct Document
+{
+    std::string_view path;
+    std::string_view title;
+    uint32_t length;
+    uint64_t fileSize;
+    int64_t modificationTime;
+};
+
+// Una página mientras se arma el índice
+struct ParsedDocument
+{
+    std::string path;
+    std::string title;
+    uint32_t length;
+    uint64_t fileSize;
+    int64_t modificationTime;
+};
+
+enum SearchMode
+{
+    SEARCH_ALL_WORDS,   // AND
+    SEARCH_ANY_WORD,    // OR
+};
+
+struct SearchResult
+{
+    DocId docId;
+    float score;
+};
+
+// Cuánto tardó cada parte de una búsqueda, en milisegundos
+struct SearchTiming
+{
+    double parseTime;       // separarla en términos y operadores
+    double planningTime;    // buscar los términos y decidir cómo recorrer las listas
+    double executionTime;   // recorrerlas y puntuar las páginas
+};
+
+/*
+ * Lo que BM25 necesita saber de todas las páginas que se buscan juntas. Con un
+ * solo índice son sus propios datos; con varios segmentos (ver
+ * SegmentedIndex.h), la suma de los de todos.
+ */
+struct SearchStatistics
+{
+    uint64_t documentCount;
+    uint64_t totalDocumentLength;
+    std::vector<uint32_t> documentFrequencies;  // una por término de la búsqueda
+};
+
+std::vector<std::filesystem::path> listPages(const std::string &wikiPath);
+std::string getDocumentPath(const std::filesystem::path &filePath);
+void getFileStamp(const std::filesystem::path &filePath, ParsedDocument &document);
+
+/*
+ * Formato binario del índice. Es el mismo en memoria y en disco, así que al
+ * leerlo alcanza con mapear el archivo. Las secciones están alineadas a 8 bytes
+ * y los enteros se guardan en el orden de bytes de la máquina.
+ *
+ *   IndexHeader
+ *   DocumentEntry[documentCount]
+ *   TermBlock[termBlockCount]      uno cada TERM_BLOCK_SIZE términos
+ *   strings                        paths y títulos, sin '\0'
+ *   terms                          ordenados, en front coding (ver TermCursor)
+ *   postings                       según el codec (ver PostingCodec.h)
+ *   frequencies                    un uint8_t por posting, en el mismo orden
+ *   blockScores                    un float por bloque de cada posting list: el
+ *                                  mayor puntaje BM25 del término en el bloque
+ *   positionBlocks                 solo si se guardan las posiciones: un uint64_t
+ *                                  por cada POSTING_BLOCK_SIZE postings, dónde
+ *                                  empiezan sus posiciones
+ *   positions                      las posiciones de cada posting, en el mismo
+ *                                  orden (ver encodePositions())
+ */
+struct IndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t documentCount;
+    uint32_t termCount;
+    uint32_t codec;
+    uint64_t totalDocumentLength;   // para el largo promedio de BM25
+    uint64_t sourceStamp;   // hash de nombres, tamaños y fechas de los .html
+    uint64_t checksum;      // de todo lo que sigue al encabezado
+    uint64_t fileSize;
+    uint64_t documentsOffset;
+    uint64_t termBlocksOffset;
+    uint64_t stringsOffset;
+    uint64_t termDataOffset;
+    uint64_t postingsOffset;
+    uint64_t frequenciesOffset;
+    uint64_t blockScoresOffset;
+    uint64_t positionBlocksOffset;  // 0 si no se guardan las posiciones
+    uint64_t positionsOffset;
+};
+
+struct DocumentEntry
+{
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t titleOffset;
+    uint32_t titleLength;
+    uint32_t length;
+    uint32_t reserved;
+    uint64_t fileSize;              // para saber si la página cambió
+    int64_t modificationTime;
+};
+
+// Lo que se sabe de un término. En el índice se guarda comprimido, y TermCursor
+// lo reconstruye
+struct TermEntry
+{
+    uint32_t documentFrequency;
+    uint8_t encoding;
+    float maxScore;                 // el mayor puntaje BM25 del término
+    uint64_t postingsOffset;
+    uint64_t frequenciesOffset;     // en postings, no en bytes
+    uint64_t blockScoresOffset;     // en bloques, no en bytes
+    uint64_t positionBlocksOffset;  // en bloques, no en bytes
+};
+
+// Dónde empieza cada bloque de términos, y los datos de su primer término que
+// los siguientes acumulan
+struct TermBlock
+{
+    uint64_t dataOffset;            // en terms
+    uint64_t postingsOffset;
+    uint64_t frequenciesOffset;
+    uint64_t blockScoresOffset;
+    uint64_t positionBlocksOffset;
+    uint32_t maxDocumentFrequency;  // de los términos del bloque
+    uint32_t reserved;
+};
+
+// Una palabra que empieza como la que se está escribiendo
+struct TermCompletion
+{
+    std::string term;
+    uint32_t documentFrequency;
+};
+
+// Términos por bloque del diccionario
+const size_t TERM_BLOCK_SIZE = 16;
+
+class SearchIndex
+{
+public:
+    SearchIndex();
+
+    size_t build(const std::string &wikiPath, const SearchIndexOptions &options,
+                 const SearchIndex *previous = NULL);
+    void buildPages(const std::vector<std::filesystem::path> &pageList, const SearchIndexOptions &options);
+    void merge(const std::vector<const SearchIndex *> &segments,
+               const std::vector<const std::vector<DocId> *> &deletedDocIds,
+               const SearchIndexOptions &options);
+    bool save(const std::string &filename) const;
+    bool load(const std::string &filename);
+    bool load(const std::string &filename, const std::string &wikiPath);
+    bool isUpToDate(const std::string &wikiPath) const;
+    void clear();
+
+    void match(const std::string &searchString, std::vector<DocId> &results) const;
+    size_t search(const std::string &searchString, SearchMode mode,
+                  size_t offset, size_t count, std::vector<SearchResult> &results) const;
+    void openMatches(const std::string &searchString, SearchMode mode, PostingStream &matches) const;
+
+    size_t rank(const SearchQuery &query, SearchMode mode,
+                const SearchStatistics &statistics, const std::vector<DocId> &deletedDocIds,
+                size_t maxResults, std::vector<SearchResult> &results,
+                SearchTiming *timing = NULL) const;
+    void openMatches(const SearchQuery &query, SearchMode mode, PostingStream &matches,
+                     std::vector<std::vector<uint8_t>> &unionPostings) const;
+    size_t filterPositions(const SearchQuery &query, DocId *docIds, size_t count) const;
+    size_t filterPositions(const SearchQuery &query, uint32_t constraint, DocId *docIds, size_t count) const;
+    void findFuzzyTerms(const LevenshteinAutomaton &automaton, uint32_t word,
+                        std::vector<TermVariant> &variants) const;
+
+    Document getDocument(DocId docId) const;
+    size_t getDocumentCount() const;
+    uint64_t getTotalDocumentLength() const;
+    uint32_t getDocumentFrequency(std::string_view term, const std::vector<DocId> &deletedDocIds) const;
+    size_t getTermCount() const;
+    size_t getTermDictionaryBytes() const;
+    PostingCodec getCodec() const;
+    size_t getPostingBytes() const;
+    bool hasPositions() const;
+    size_t getPositionBytes() const;
+
+private:
+    friend class TermCursor;
+
+    // Un término de la búsqueda, con su peso según las estadísticas de todas
+    // las páginas que se buscan juntas
+    struct ScoredTerm
+    {
+        TermEntry entry;
+        float idf;
+        float boundScale;   // para pasar las cotas de este índice a esas estadísticas
+    };
+
+    // Hasta dónde se leyeron las posiciones de un término, para seguir desde
+    // ahí con el posting siguiente
+    struct PositionCursor
+    {
+        const uint8_t *input;
+        size_t posting;
+    };
+
+    void buildImage(const std::vector<std::filesystem::path> &fileList,
+                    const std::vector<size_t> &filesToRead, std::vector<ParsedDocument> &documents,
+                    const std::vector<const SearchIndex *> &sources,
+                    const std::vector<std::vector<DocId>> &newDocIds,
+                    uint64_t sourceStamp, const SearchIndexOptions &options);
+    bool open(const char *imageData, size_t imageSize);
+    bool findTerms(const std::string &searchString, std::vector<TermEntry> &terms) const;
+    bool findTerm(std::string_view term, TermEntry &entry) const;
+    std::string_view getBlockFirstTerm(size_t block) const;
+    void intersectTerms(const std::vector<TermEntry> &terms, std::vector<DocId> &results) const;
+    void findQueryTerms(const SearchQuery &query, std::vector<TermEntry> &entries) const;
+    bool addWordPostings(const SearchQuery &query, size_t word, const std::vector<TermEntry> &entries,
+                         std::vector<std::vector<uint8_t>> &unionPostings,
+                         std::vector<PostingReader> &lists) const;
+    void getQueryPostings(const std::vector<TermEntry> &entries, std::vector<PostingReader> &postings) const;
+    void runQueryPlan(const QueryPlan &plan, const SearchQuery &query, std::vector<DocId> &matches) const;
+    size_t rankAllTerms(const std::vector<ScoredTerm> &terms,
+                        std::vector<PostingReader> &requiredPostings,
+                        const SearchQuery &query, float averageLength,
+                        const std::vector<DocId> &deletedDocIds, size_t maxResults,
+                        std::vector<SearchResult> &results) const;
+    void scoreMatches(const std::vector<ScoredTerm> &terms, const std::vector<DocId> &matches,
+                      float averageLength, size_t maxResults,
+                      std::vector<SearchResult> &results) const;
+    size_t rankAnyTerm(const std::vector<ScoredTerm> &terms, float averageLength,
+                       const std::vector<DocId> &deletedDocIds, size_t maxResults,
+                       std::vector<SearchResult> &results) const;
+    float getAverageLength() const;
+    std::string_view getString(uint32_t offset, uint32_t length) const;
+    PostingReader getPostings(const TermEntry &term) const;
+    void getPositions(const TermEntry &term, size_t posting, PositionCursor &cursor,
+                      std::vector<uint32_t> &positions) const;
+
+    // El índice vive en uno de los dos: recién armado o mapeado de disco
+    std::vector<char> builtImage;
+    MappedFile mappedImage;
+
+    const IndexHeader *header;
+    const DocumentEntry *documentEntries;
+    const TermBlock *termBlocks;
+    const char *strings;
+    const uint8_t *termData;
+    const uint8_t *postingBytes;
+    const uint8_t *frequencies;
+    const float *blockScores;
+    const uint64_t *positionBlocks;
+    const uint8_t *positionData;
+};
+
+/**
+ * @brief Walks the terms of an index in alphabetical order
+ *
+ * Los términos se guardan en bloques de TERM_BLOCK_SIZE. Cada uno guarda solo
+ * lo que no comparte con el anterior (front coding), y sus datos sin los
+ * offsets, que salen de sumar los tamaños de los anteriores del bloque. El
+ * primero de cada bloque está completo, así que para buscar un término se
+ * bisecta entre los bloques y se recorre uno solo.
+ */
+class TermCursor
+{
+public:
+    TermCursor(const SearchIndex &index, std::string_view term = std::string_view());
+
+    bool isAtEnd() const;
+    void next();
+    void nextBlock();
+    void moveTo(std::string_view term);
+    uint32_t getBlockMaxFrequency() const;
+
+    std::string_view getText() const;
+    const TermEntry &getEntry() const;
+
+private:
+    void readTerm();
+
+    const SearchIndex *index;
+    size_t termIndex;
+    const uint8_t *input;   // donde empieza el término siguiente
+    std::string text;
+    TermEntry entry;
+};
+
+void expandFuzzyTerms(SearchQuery &query, const std::vector<const SearchIndex *> &indexes);
+
+#endif
@@ -0,0 +1,761 @@
+/**
+ * @file SearchQuery.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Searches with quoted phrases, NEAR/k, fuzzy words and boolean operators
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "LevenshteinAutomaton.h"
+#include "SearchQuery.h"
+#include "TextNormalizer.h"
+
+using namespace std;
+
+static const string_view NEAR_OPERATOR = "NEAR/";
+static const string_view AND_OPERATOR = "AND";
+static const string_view OR_OPERATOR = "OR";
+static const string_view NOT_OPERATOR = "NOT";
+static const char EXCLUDE_OPERATOR = '-';
+static const char FUZZY_OPERATOR = '~';
+
+// Una restricción que no se pudo armar
+static const uint32_t NO_CONSTRAINT = UINT32_MAX;
+
+enum QueryTokenType
+{
+    TOKEN_WORDS,    // lo que sale de normalizar una palabra
+    TOKEN_PHRASE,
+    TOKEN_NEAR,
+    TOKEN_AND,
+    TOKEN_OR,
+    TOKEN_NOT,
+    TOKEN_OPEN,
+    TOKEN_CLOSE,
+};
+
+// Una parte de la búsqueda, para armar su árbol
+struct QueryToken
+{
+    QueryTokenType type;
+    size_t firstWord;   // las palabras de TOKEN_WORDS, [firstWord, lastWord)
+    size_t lastWord;
+    uint32_t constraint;    // la de TOKEN_PHRASE o TOKEN_NEAR, en SearchQuery::constraints
+};
+
+/**
+ * @brief Builds the tree of a search with operators, by recursive descent
+ *
+ * De menor a mayor prioridad: OR, AND (explícito o entre palabras seguidas) y
+ * NOT o "-". Lo que no tiene sentido, como un OR al principio o un paréntesis
+ * que no abre, se ignora.
+ */
+class QueryTreeParser
+{
+public:
+    QueryTreeParser(const vector<QueryToken> &tokens, const vector<uint32_t> &wordTerms,
+                    vector<QueryNode> &nodes);
+
+    bool parse();
+
+private:
+    bool parseOr(uint32_t &node);
+    bool parseAnd(uint32_t &node);
+    bool parseUnary(uint32_t &node);
+    bool addNode(QueryNodeType type, const vector<uint32_t> &children, uint32_t &node);
+    uint32_t addLeaf(QueryNodeType type, uint32_t value);
+
+    const vector<QueryToken> &tokens;
+    const vector<uint32_t> &wordTerms;  // el término de cada palabra
+    vector<QueryNode> &nodes;
+    size_t position;
+};
+
+// Con "~" sin número, las palabras más largas que estas toleran más cambios
+static const size_t FUZZY_ONE_EDIT_LENGTH = 3;
+static const size_t FUZZY_TWO_EDITS_LENGTH = 6;
+
+// Más cifras no tienen sentido para una distancia en palabras
+static const size_t MAX_DISTANCE_DIGITS = 6;
+
+static bool parseNearOperator(string_view word, uint32_t &distance);
+static bool parseBooleanOperator(string_view word, QueryTokenType &type);
+static void setExcludedWeights(SearchQuery &query);
+static void markIncludedTerms(const SearchQuery &query, uint32_t node, bool isNegated,
+                              vector<bool> &isIncluded);
+static bool parseFuzzyOperator(string_view &word, uint32_t &maxEdits);
+static uint32_t getDefaultMaxEdits(string_view term);
+static bool matchesPhrase(const vector<vector<uint32_t>> &positions);
+static bool matchesNear(const vector<uint32_t> &a, const vector<uint32_t> &b, uint32_t maxDistance);
+
+/**
+ * @brief Splits a search in normalized terms, and finds its phrases
+ *
+ * Las frases van entre comillas; si falta la comilla final, la frase sigue
+ * hasta el final de la búsqueda. NEAR/k une la palabra anterior con la
+ * siguiente, y tiene que estar en mayúsculas, para que "near" se pueda buscar
+ * como palabra. Una frase de una sola palabra es solo esa palabra.
+ *
+ * Una palabra seguida de "~" acepta también términos a una o dos ediciones,
+ * según su largo; con "~1" o "~2", a esa cantidad. Las palabras de las frases
+ * y de NEAR/k no, porque sus posiciones se buscan exactas.
+ *
+ * Fuera de las frases, AND, OR y NOT en mayúsculas, un "-" delante de una
+ * palabra y los paréntesis combinan las partes de la búsqueda; entre dos
+ * partes sin operador va AND. Si hay alguno, se arma el árbol en query.nodes.
+ *
+ * @param searchString
+ * @param query
+ */
+void parseSearchQuery(const string &searchString, SearchQuery &query)
+{
+    query.buffer.clear();
+    query.terms.clear();
+    query.constraints.clear();
+    query.maxEdits.clear();
+    query.variants.clear();
+    query.termWeights.clear();
+    query.nodes.clear();
+
+    // Las palabras en el orden de la búsqueda, con lo que las une
+    vector<string> words;
+    vector<uint32_t> wordEdits;
+    vector<pair<size_t, size_t>> phrases;       // [primera, última + 1) en words
+    vector<pair<size_t, uint32_t>> nearWords;   // la palabra que sigue a NEAR/k, y k
+    vector<QueryToken> tokens;
+    bool hasOperators = false;
+
+    string normalizedWord;
+    vector<string_view> wordTerms;
+
+    bool isInPhrase = false;
+    size_t phraseStart = 0;
+    size_t position = 0;
+
+    while (position <= searchString.size())
+    {
+        if (position == searchString.size() || searchString[position] == '"')
+        {
+            // La restricción de la frase se numera después
+            if (isInPhrase && words.size() - phraseStart > 1)
+            {
+                phrases.push_back({phraseStart, words.size()});
+                tokens.push_back({TOKEN_PHRASE, phraseStart, words.size(), (uint32_t)phrases.size() - 1});
+            }
+            else if (isInPhrase && words.size() > phraseStart)
+                tokens.push_back({TOKEN_WORDS, phraseStart, words.size(), NO_CONSTRAINT});
+
+            isInPhrase = !isInPhrase;
+            phraseStart = words.size();
+            position++;
+            continue;
+        }
+
+        if (!isInPhrase && (searchString[position] == '(' || searchString[position] == ')'))
+        {
+            tokens.push_back({searchString[position] == '(' ? TOKEN_OPEN : TOKEN_CLOSE, 0, 0, NO_CONSTRAINT});
+            hasOperators = true;
+            position++;
+            continue;
+        }
+
+        size_t end = searchString.find_first_of(isInPhrase ? " \t\r\n\"" : " \t\r\n\"()", position);
+        if (end == string::npos)
+            end = searchString.size();
+
+        string_view word = string_view(searchString).substr(position, end - position);
+        position = (end == position) ? position + 1 : end;
+
+        uint32_t distance;
+        if (!isInPhrase && parseNearOperator(word, distance))
+        {
+            nearWords.push_back({words.size(), distance});
+            tokens.push_back({TOKEN_NEAR, 0, 0, (uint32_t)nearWords.size() - 1});
+            continue;
+        }
+
+        QueryTokenType operatorType;
+        if (!isInPhrase && parseBooleanOperator(word, operatorType))
+        {
+            tokens.push_back({operatorType, 0, 0, NO_CONSTRAINT});
+            hasOperators = true;
+            continue;
+        }
+
+        // "-palabra" es NOT palabra, y lo mismo antes de una frase o de un
+        // paréntesis; un "-" suelto no excluye nada
+        if (!isInPhrase && word.size() == 1 && word[0] == EXCLUDE_OPERATOR && end < searchString.size() &&
+            (searchString[end] == '"' || searchString[end] == '('))
+        {
+            tokens.push_back({TOKEN_NOT, 0, 0, NO_CONSTRAINT});
+            hasOperators = true;
+            continue;
+        }
+
+        bool isExcluded = !isInPhrase && word.size() > 1 && word[0] == EXCLUDE_OPERATOR;
+        if (isExcluded)
+            word = word.substr(1);
+
+        uint32_t maxEdits = 0;
+        bool isFuzzy = parseFuzzyOperator(word, maxEdits) && !isInPhrase;
+
+        size_t firstWord = words.size();
+        normalizeTerms(word, normalizedWord, wordTerms);
+        for (auto term : wordTerms)
+        {
+            words.emplace_back(term);
+            wordEdits.push_back(!isFuzzy ? 0 : maxEdits ? maxEdits : getDefaultMaxEdits(term));
+        }
+
+        if (!isInPhrase && words.size() > firstWord)
+        {
+            if (isExcluded)
+            {
+                tokens.push_back({TOKEN_NOT, 0, 0, NO_CONSTRAINT});
+                hasOperators = true;
+            }
+            tokens.push_back({TOKEN_WORDS, firstWord, words.size(), NO_CONSTRAINT});
+        }
+    }
+
+    vector<string> sortedWords = words;
+    sort(sortedWords.begin(), sortedWords.end());
+    sortedWords.erase(unique(sortedWords.begin(), sortedWords.end()), sortedWords.end());
+
+    // Primero se arma todo el buffer, para que no se mueva
+    for (auto &word : sortedWords)
+        query.buffer += word;
+
+    size_t offset = 0;
+    for (auto &word : sortedWords)
+    {
+        query.terms.push_back(string_view(query.buffer).substr(offset, word.size()));
+        offset += word.size();
+    }
+
+    auto getTermIndex = [&](size_t word)
+    {
+        return (uint32_t)(lower_bound(sortedWords.begin(), sortedWords.end(), words[word]) - sortedWords.begin());
+    };
+
+    // Si una palabra se repite, con la mayor tolerancia
+    query.maxEdits.assign(sortedWords.size(), 0);
+    query.variants.resize(sortedWords.size());
+    query.termWeights.assign(sortedWords.size(), 1);
+    for (size_t word = 0; word < words.size(); word++)
+    {
+        uint32_t &maxEdits = query.maxEdits[getTermIndex(word)];
+        maxEdits = max(maxEdits, wordEdits[word]);
+    }
+
+    for (auto &phrase : phrases)
+    {
+        PhraseConstraint constraint;
+        constraint.maxDistance = 0;
+        for (size_t word = phrase.first; word < phrase.second; word++)
+            constraint.termIndexes.push_back(getTermIndex(word));
+
+        query.constraints.push_back(move(constraint));
+    }
+
+    // Un NEAR/k al principio o al final no une nada
+    vector<uint32_t> nearConstraints(nearWords.size(), NO_CONSTRAINT);
+    for (size_t i = 0; i < nearWords.size(); i++)
+    {
+        auto &nearWord = nearWords[i];
+        if (nearWord.first == 0 || nearWord.first >= words.size())
+            continue;
+
+        nearConstraints[i] = (uint32_t)query.constraints.size();
+        query.constraints.push_back({{getTermIndex(nearWord.first - 1), getTermIndex(nearWord.first)},
+                                     nearWord.second});
+    }
+
+    for (auto &constraint : query.constraints)
+    {
+        for (auto termIndex : constraint.termIndexes)
+            query.maxEdits[termIndex] = 0;
+    }
+
+    if (!hasOperators)
+        return;
+
+    // Los tokens pasan a apuntar a las restricciones
+    for (auto &token : tokens)
+    {
+        if (token.type == TOKEN_NEAR)
+            token.constraint = nearConstraints[token.constraint];
+    }
+
+    vector<uint32_t> wordTermIndexes;
+    for (size_t word = 0; word < words.size(); word++)
+        wordTermIndexes.push_back(getTermIndex(word));
+
+    QueryTreeParser parser(tokens, wordTermIndexes, query.nodes);
+    if (parser.parse())
+        setExcludedWeights(query);
+}
+
+/**
+ * @brief Adds the terms of the pages that can replace fuzzy words
+ *
+ * Una variante que ya es un término de la búsqueda no se repite: queda como
+ * variante de cada palabra, pero se puntúa una sola vez, con el mayor peso.
+ *
+ * @param query
+ * @param variants
+ */
+void addTermVariants(SearchQuery &query, const vector<TermVariant> &variants)
+{
+    vector<string> terms(query.terms.begin(), query.terms.end());
+    for (auto &variant : variants)
+    {
+        // Cuanto más lejos, menos pesa. Las de una palabra excluida, nada
+        float weight = query.termWeights[variant.word] ? 1.0F / (1 + variant.distance) : 0;
+
+        size_t termIndex = find(terms.begin(), terms.end(), variant.term) - terms.begin();
+        if (termIndex == terms.size())
+        {
+            terms.push_back(variant.term);
+            query.termWeights.push_back(weight);
+        }
+        else
+            query.termWeights[termIndex] = max(query.termWeights[termIndex], weight);
+
+        vector<uint32_t> &wordVariants = query.variants[variant.word];
+        if (termIndex != variant.word &&
+            find(wordVariants.begin(), wordVariants.end(), termIndex) == wordVariants.end())
+            wordVariants.push_back((uint32_t)termIndex);
+    }
+
+    // Los términos apuntan al buffer, que se vuelve a armar entero
+    query.buffer.clear();
+    for (auto &term : terms)
+        query.buffer += term;
+
+    query.terms.clear();
+    size_t offset = 0;
+    for (auto &term : terms)
+    {
+        query.terms.push_back(string_view(query.buffer).substr(offset, term.size()));
+        offset += term.size();
+    }
+}
+
+/**
+ * @brief Checks if the positions of the words of a page satisfy a phrase
+ *
+ * @param constraint
+ * @param positions     for each term of the constraint, its positions in the
+ *                      page, in ascending order
+ * @return true if the words are where the constraint wants them
+ */
+bool matchesPositions(const PhraseConstraint &constraint, const vector<vector<uint32_t>> &positions)
+{
+    if (!constraint.maxDistance)
+        return matchesPhrase(positions);
+
+    return matchesNear(positions[0], positions[1], constraint.maxDistance);
+}
+
+QueryTreeParser::QueryTreeParser(const vector<QueryToken> &tokens, const vector<uint32_t> &wordTerms,
+                                 vector<QueryNode> &nodes) : tokens(tokens),
+                                                             wordTerms(wordTerms),
+                                                             nodes(nodes)
+{
+    position = 0;
+}
+
+/**
+ * @brief Builds the tree of every token. Un paréntesis que cierra de más
+ *        separa dos partes, que se unen con AND
+ *
+ * @return true if there is a tree, whose root is the last node
+ */
+bool QueryTreeParser::parse()
+{
+    vector<uint32_t> parts;
+
+    while (position < tokens.size())
+    {
+        uint32_t part;
+        if (parseOr(part))
+            parts.push_back(part);
+
+        if (position < tokens.size() && tokens[position].type == TOKEN_CLOSE)
+            position++;
+    }
+
+    uint32_t root;
+    if (!addNode(QUERY_AND, parts, root))
+    {
+        nodes.clear();
+        return false;
+    }
+
+    // La raíz tiene que ser el último nodo
+    if (root != nodes.size() - 1)
+        nodes.push_back(QueryNode(nodes[root]));
+
+    return true;
+}
+
+/**
+ * @brief Parses parts joined by OR
+ *
+ * @param node
+ * @return true if there was some part
+ */
+bool QueryTreeParser::parseOr(uint32_t &node)
+{
+    vector<uint32_t> children;
+
+    while (true)
+    {
+        uint32_t child;
+        if (parseAnd(child))
+            children.push_back(child);
+
+        if (position == tokens.size() || tokens[position].type != TOKEN_OR)
+            break;
+
+        position++;
+    }
+
+    return addNode(QUERY_OR, children, node);
+}
+
+/**
+ * @brief Parses parts joined by AND, until an OR or a closing parenthesis.
+ *        Un NEAR/k agrega su restricción entre las partes
+ *
+ * @param node
+ * @return true if there was some part
+ */
+bool QueryTreeParser::parseAnd(uint32_t &node)
+{
+    vector<uint32_t> children;
+
+    while (position < tokens.size())
+    {
+        const QueryToken &token = tokens[position];
+        if (token.type == TOKEN_OR || token.type == TOKEN_CLOSE)
+            break;
+
+        if (token.type == TOKEN_AND || token.type == TOKEN_NEAR)
+        {
+            if (token.type == TOKEN_NEAR && token.constraint != NO_CONSTRAINT)
+                children.push_back(addLeaf(QUERY_CONSTRAINT, token.constraint));
+
+            position++;
+            continue;
+        }
+
+        uint32_t child;
+        if (parseUnary(child))
+            children.push_back(child);
+    }
+
+    return addNode(QUERY_AND, children, node);
+}
+
+/**
+ * @brief Parses a word, a phrase, a part in parentheses, or NOT followed by
+ *        one of them
+ *
+ * @param node
+ * @return true if there was one
+ */
+bool QueryTreeParser::parseUnary(uint32_t &node)
+{
+    const QueryToken &token = tokens[position++];
+
+    switch (token.type)
+    {
+    case TOKEN_NOT:
+    {
+        // Un NOT sin nada después no niega nada
+        if (position == tokens.size() || tokens[position].type == TOKEN_OR ||
+            tokens[position].type == TOKEN_AND || tokens[position].type == TOKEN_CLOSE ||
+            tokens[position].type == TOKEN_NEAR)
+            return false;
+
+        uint32_t child;
+        if (!parseUnary(child))
+            return false;
+
+        return addNode(QUERY_NOT, {child}, node);
+    }
+
+    case TOKEN_OPEN:
+    {
+        bool hasPart = parseOr(node);
+        if (position < tokens.size() && tokens[position].type == TOKEN_CLOSE)
+            position++;
+
+        return hasPart;
+    }
+
+    case TOKEN_WORDS:
+    {
+        // Una palabra que se normaliza en varias, como "e-mail", las pide a todas
+        vector<uint32_t> children;
+        for (size_t word = token.firstWord; word < token.lastWord; word++)
+            children.push_back(addLeaf(QUERY_WORD, wordTerms[word]));
+
+        return addNode(QUERY_AND, children, node);
+    }
+
+    case TOKEN_PHRASE:
+        node = addLeaf(QUERY_CONSTRAINT, token.constraint);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Adds an operator node. Con un solo hijo, es ese hijo
+ *
+ * @param type
+ * @param children
+ * @param node
+ * @return true if there was some child
+ */
+bool QueryTreeParser::addNode(QueryNodeType type, const vector<uint32_t> &children, uint32_t &node)
+{
+    if (children.empty())
+        return false;
+
+    if (children.size() == 1 && type != QUERY_NOT)
+    {
+        node = children[0];
+        return true;
+    }
+
+    node = (uint32_t)nodes.size();
+    nodes.push_back({type, 0, children});
+
+    return true;
+}
+
+uint32_t QueryTreeParser::addLeaf(QueryNodeType type, uint32_t value)
+{
+    nodes.push_back({type, value, {}});
+
+    return (uint32_t)nodes.size() - 1;
+}
+
+/**
+ * @brief Recognizes "NEAR/k"
+ *
+ * @param word
+ * @param distance  k, at least 1
+ * @return true if the word is the operator
+ */
+static bool parseNearOperator(string_view word, uint32_t &distance)
+{
+    if (word.size() <= NEAR_OPERATOR.size() ||
+        word.size() > NEAR_OPERATOR.size() + MAX_DISTANCE_DIGITS ||
+        word.substr(0, NEAR_OPERATOR.size()) != NEAR_OPERATOR)
+        return false;
+
+    distance = 0;
+    for (auto c : word.substr(NEAR_OPERATOR.size()))
+    {
+        if (c < '0' || c > '9')
+            return false;
+
+        distance = distance * 10 + (c - '0');
+    }
+
+    return distance > 0;
+}
+
+/**
+ * @brief Recognizes AND, OR and NOT, which have to be in uppercase
+ *
+ * @param word
+ * @param type
+ * @return true if the word is an operator
+ */
+static bool parseBooleanOperator(string_view word, QueryTokenType &type)
+{
+    if (word == AND_OPERATOR)
+        type = TOKEN_AND;
+    else if (word == OR_OPERATOR)
+        type = TOKEN_OR;
+    else if (word == NOT_OPERATOR)
+        type = TOKEN_NOT;
+    else
+        return false;
+
+    return true;
+}
+
+/**
+ * @brief Gives no weight to the terms that are only excluded: una página no
+ *        es mejor por no tenerlos
+ *
+ * @param query
+ */
+static void setExcludedWeights(SearchQuery &query)
+{
+    vector<bool> isIncluded(query.terms.size(), false);
+    markIncludedTerms(query, (uint32_t)query.nodes.size() - 1, false, isIncluded);
+
+    for (size_t i = 0; i < query.terms.size(); i++)
+    {
+        if (!isIncluded[i])
+            query.termWeights[i] = 0;
+    }
+}
+
+/**
+ * @brief Marks the terms of a subtree that are not below a NOT, or are below
+ *        two
+ *
+ * @param query
+ * @param node
+ * @param isNegated     if the subtree is below a NOT
+ * @param isIncluded
+ */
+static void markIncludedTerms(const SearchQuery &query, uint32_t node, bool isNegated,
+                              vector<bool> &isIncluded)
+{
+    const QueryNode &queryNode = query.nodes[node];
+
+    if (queryNode.type == QUERY_WORD)
+        isIncluded[queryNode.value] = isIncluded[queryNode.value] || !isNegated;
+    else if (queryNode.type == QUERY_CONSTRAINT)
+    {
+        for (auto termIndex : query.constraints[queryNode.value].termIndexes)
+            isIncluded[termIndex] = isIncluded[termIndex] || !isNegated;
+    }
+
+    for (auto child : queryNode.children)
+        markIncludedTerms(query, child, isNegated != (queryNode.type == QUERY_NOT), isIncluded);
+}
+
+/**
+ * @brief Recognizes "~", "~1" or "~2" at the end of a word, and removes it
+ *
+ * @param word
+ * @param maxEdits  0 if it has no number, to choose it by the length
+ * @return true if the word is fuzzy
+ */
+static bool parseFuzzyOperator(string_view &word, uint32_t &maxEdits)
+{
+    size_t position = word.rfind(FUZZY_OPERATOR);
+    if (position == string_view::npos || word.size() - position > 2)
+        return false;
+
+    maxEdits = 0;
+    if (position + 1 < word.size())
+    {
+        char digit = word[position + 1];
+        if (digit < '0' || digit > '9')
+            return false;
+
+        maxEdits = min((uint32_t)(digit - '0'), MAX_EDIT_DISTANCE);
+        if (!maxEdits)
+        {
+            word = word.substr(0, position);
+            return false;
+        }
+    }
+
+    word = word.substr(0, position);
+
+    return true;
+}
+
+/**
+ * @brief Edits tolerated for a word: a change in a very short word makes
+ *        almost any other
+ *
+ * @param term
+ * @return uint32_t
+ */
+static uint32_t getDefaultMaxEdits(string_view term)
+{
+    size_t length = 0;
+    for (auto c : term)
+        length += ((unsigned char)c & 0xc0) != 0x80;
+
+    if (length >= FUZZY_TWO_EDITS_LENGTH)
+        return MAX_EDIT_DISTANCE;
+    if (length >= FUZZY_ONE_EDIT_LENGTH)
+        return 1;
+
+    return 0;
+}
+
+/**
+ * @brief Looks for the words one after the other. Cada lista se recorre una
+ *        sola vez, porque las posiciones buscadas crecen con la del primer
+ *        término
+ *
+ * @param positions
+ * @return true if the phrase is in the page
+ */
+static bool matchesPhrase(const vector<vector<uint32_t>> &positions)
+{
+    vector<size_t> next(positions.size(), 0);
+
+    for (auto first : positions[0])
+    {
+        bool isMatch = true;
+
+        for (size_t word = 1; isMatch && word < positions.size(); word++)
+        {
+            const vector<uint32_t> &list = positions[word];
+            size_t &i = next[word];
+
+            uint32_t target = first + (uint32_t)word;
+            while (i < list.size() && list[i] < target)
+                i++;
+
+            isMatch = i < list.size() && list[i] == target;
+        }
+
+        if (isMatch)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Looks for two positions at most maxDistance apart, advancing always
+ *        the smaller one
+ *
+ * @param a
+ * @param b
+ * @param maxDistance
+ * @return true if the words are near
+ */
+static bool matchesNear(const vector<uint32_t> &a, const vector<uint32_t> &b, uint32_t maxDistance)
+{
+    size_t i = 0, j = 0;
+
+    while (i < a.size() && j < b.size())
+    {
+        uint32_t distance = (a[i] < b[j]) ? b[j] - a[i] : a[i] - b[j];
+        if (distance <= maxDistance)
+            return true;
+
+        if (a[i] < b[j])
+            i++;
+        else
+            j++;
+    }
+
+    return false;
+}
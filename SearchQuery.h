@@ -0,0 +1,90 @@
+/**
+ * @file SearchQuery.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Searches with quoted phrases, NEAR/k, fuzzy words and boolean operators
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef SEARCHQUERY_H
+#define SEARCHQUERY_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Palabras que tienen que aparecer cerca en la página. Una frase entre comillas
+ * las pide seguidas y en el mismo orden; "a NEAR/k b" pide que entre a y b haya
+ * a lo sumo k - 1 palabras, en cualquier orden.
+ */
+struct PhraseConstraint
+{
+    std::vector<uint32_t> termIndexes;  // en SearchQuery::terms, en el orden de la búsqueda
+    uint32_t maxDistance;               // 0 para una frase
+};
+
+// Un término de las páginas parecido a una palabra de la búsqueda
+struct TermVariant
+{
+    uint32_t word;          // en SearchQuery::terms
+    std::string term;
+    uint32_t distance;              // de edición
+    uint32_t documentFrequency;     // para quedarse con las más comunes
+};
+
+enum QueryNodeType
+{
+    QUERY_WORD,         // una palabra, o alguna de sus variantes
+    QUERY_CONSTRAINT,   // las palabras de una frase o de un NEAR/k, donde las pide
+    QUERY_AND,
+    QUERY_OR,
+    QUERY_NOT,          // un solo hijo
+};
+
+// Un nodo del árbol de una búsqueda con operadores
+struct QueryNode
+{
+    QueryNodeType type;
+    uint32_t value;                 // la palabra, o la restricción en constraints
+    std::vector<uint32_t> children; // en SearchQuery::nodes
+};
+
+/**
+ * @brief A search split in normalized terms, and the phrases they form
+ *
+ * Los primeros términos son las palabras de la búsqueda. Una palabra con "~"
+ * también se satisface con sus variantes, que se agregan después.
+ *
+ * Si la búsqueda usa AND, OR, NOT, "-" o paréntesis, nodes tiene su árbol, y
+ * es lo único que decide qué páginas coinciden (ver QueryPlan.h).
+ */
+struct SearchQuery
+{
+    SearchQuery() = default;
+
+    // Los términos apuntan al buffer
+    SearchQuery(const SearchQuery &) = delete;
+    SearchQuery &operator=(const SearchQuery &) = delete;
+
+    std::string buffer;
+    std::vector<std::string_view> terms;    // sin repetir; las palabras, ordenadas
+    std::vector<PhraseConstraint> constraints;
+
+    std::vector<uint32_t> maxEdits;                 // por palabra; 0 si no tiene "~"
+    std::vector<std::vector<uint32_t>> variants;    // por palabra, en terms
+    std::vector<float> termWeights;                 // por término; menos para las variantes, 0 si solo se excluye
+
+    std::vector<QueryNode> nodes;   // vacío si no hay operadores; la raíz es el último
+};
+
+void parseSearchQuery(const std::string &searchString, SearchQuery &query);
+void addTermVariants(SearchQuery &query, const std::vector<TermVariant> &variants);
+
+bool matchesPositions(const PhraseConstraint &constraint,
+                      const std::vector<std::vector<uint32_t>> &positions);
+
+#endif
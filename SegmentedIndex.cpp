@@ -0,0 +1,954 @@
+/**
+ * @file SegmentedIndex.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Search index split in immutable segments
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "SegmentedIndex.h"
+#include "TextNormalizer.h"
+
+using namespace std;
+
+static const string MANIFEST_FILENAME = "segments.txt";
+static const string SEGMENT_PREFIX = "segment_";
+static const string SEGMENT_EXTENSION = ".bin";
+
+// Se mezclan de a tantos segmentos de un mismo nivel. El nivel 0 es el de los
+// segmentos de menos de SMALL_SEGMENT_SIZE * MERGE_FACTOR páginas, y cada
+// nivel siguiente es MERGE_FACTOR veces más grande
+static const size_t MERGE_FACTOR = 4;
+static const size_t SMALL_SEGMENT_SIZE = 16;
+
+static void setDeletedDocIds(IndexSegment &segment, vector<DocId> deletedDocIds);
+static unsigned int getSegmentLevel(const IndexSegment &segment);
+static size_t getLiveDocumentCount(const IndexSegment &segment);
+static bool isBetterCompletion(const TermCompletion &a, const TermCompletion &b);
+
+IndexSnapshot::IndexSnapshot()
+{
+    documentCount = 0;
+}
+
+/**
+ * @brief Finds the pages that contain the words of "searchString" in all the
+ *        segments, ranked by BM25 as if they were one index
+ *
+ * @param searchString
+ * @param mode          if pages need all the words or any of them
+ * @param offset        number of best results to skip
+ * @param count         maximum number of results
+ * @param results       best results from offset on, by decreasing score
+ * @param timing        if not NULL, how long it took to parse, plan and run it
+ * @return size_t       number of matching pages
+ */
+size_t IndexSnapshot::search(const string &searchString, SearchMode mode,
+                             size_t offset, size_t count, vector<SearchResult> &results,
+                             SearchTiming *timing) const
+{
+    results.clear();
+
+    auto t1 = chrono::steady_clock::now();
+
+    SearchQuery query;
+    parseSearchQuery(searchString, query);
+
+    auto t2 = chrono::steady_clock::now();
+
+    expandFuzzyTerms(query, getIndexes());
+    const vector<string_view> &terms = query.terms;
+
+    // Las estadísticas no cuentan las páginas borradas, así que los puntajes
+    // son los mismos que con un solo índice de las páginas vigentes
+    SearchStatistics statistics;
+    statistics.documentCount = documentCount;
+    statistics.totalDocumentLength = 0;
+    statistics.documentFrequencies.assign(terms.size(), 0);
+
+    for (auto &segment : segments)
+    {
+        statistics.totalDocumentLength += segment->index->getTotalDocumentLength() - segment->deletedLength;
+
+        for (size_t i = 0; i < terms.size(); i++)
+            statistics.documentFrequencies[i] += segment->index->getDocumentFrequency(terms[i],
+                                                                                      segment->deletedDocIds);
+    }
+
+    // Cada segmento suma lo que tarda en planear y en ejecutar su parte
+    if (timing)
+    {
+        timing->parseTime = chrono::duration<double, milli>(t2 - t1).count();
+        timing->planningTime = chrono::duration<double, milli>(chrono::steady_clock::now() - t2).count();
+        timing->executionTime = 0;
+    }
+
+    size_t maxResults = offset + count;
+    size_t matchCount = 0;
+    vector<SearchResult> segmentResults;
+
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        matchCount += segments[i]->index->rank(query, mode, statistics, segments[i]->deletedDocIds,
+                                               maxResults, segmentResults, timing);
+
+        for (auto &result : segmentResults)
+            results.push_back({docIdBases[i] + result.docId, result.score});
+    }
+
+    // Los mejores de cada segmento se ordenan juntos, igual que en SearchIndex
+    sort(results.begin(), results.end(), [](const SearchResult &a, const SearchResult &b)
+         { return a.score > b.score || (a.score == b.score && a.docId < b.docId); });
+
+    results.resize(min(maxResults, results.size()));
+    results.erase(results.begin(), results.begin() + min(offset, results.size()));
+
+    return matchCount;
+}
+
+/**
+ * @brief Starts producing the pages that match a search, in docId order and
+ *        without ranking them
+ *
+ * @param searchString
+ * @param mode
+ * @param matches       valid while the snapshot exists
+ */
+void IndexSnapshot::openMatches(const string &searchString, SearchMode mode, IndexMatches &matches) const
+{
+    matches.snapshot = this;
+    parseSearchQuery(searchString, matches.query);
+    expandFuzzyTerms(matches.query, getIndexes());
+    matches.mode = mode;
+
+    matches.segment = 0;
+    matches.openSegment();
+}
+
+/**
+ * @brief Finds the most frequent terms that start with the last word of a
+ *        prefix
+ *
+ * Los términos de cada segmento se recorren juntos en orden alfabético, desde
+ * el prefijo, sumando las frecuencias de los que se repiten; solo se guardan
+ * los que entran entre los mejores. Un término no puede estar en más páginas
+ * que la mayor frecuencia de su bloque más las páginas de los otros segmentos:
+ * los bloques en los que eso no alcanza para entrar se saltean enteros. Las
+ * frecuencias guardadas incluyen las
+ * páginas borradas, así que si hay alguna se recalculan solo las de los
+ * elegidos: hasta la próxima mezcla, el orden es aproximado.
+ *
+ * @param prefix
+ * @param count         most completions to return
+ * @param completions   by decreasing frequency, then alphabetically
+ */
+void IndexSnapshot::findCompletions(const string &prefix, size_t count,
+                                    vector<TermCompletion> &completions) const
+{
+    completions.clear();
+
+    string normalizedPrefix;
+    vector<string_view> prefixTerms;
+    normalizeTerms(prefix, normalizedPrefix, prefixTerms);
+
+    if (prefixTerms.empty() || !count)
+        return;
+
+    string_view term = prefixTerms.back();
+
+    vector<TermCursor> cursors;
+    cursors.reserve(segments.size());
+    for (auto &segment : segments)
+        cursors.emplace_back(*segment->index, term);
+
+    auto isInPrefix = [&](const TermCursor &cursor)
+    { return !cursor.isAtEnd() && cursor.getText().substr(0, term.size()) == term; };
+
+    size_t totalDocumentCount = 0;
+    for (auto &segment : segments)
+        totalDocumentCount += segment->index->getDocumentCount();
+
+    // El término actual se copia, porque los cursores reusan su texto
+    string text;
+
+    while (true)
+    {
+        if (completions.size() == count)
+        {
+            for (size_t i = 0; i < cursors.size(); i++)
+            {
+                uint64_t otherDocumentCount = totalDocumentCount - segments[i]->index->getDocumentCount();
+                while (isInPrefix(cursors[i]) &&
+                       cursors[i].getBlockMaxFrequency() + otherDocumentCount <=
+                           completions.front().documentFrequency)
+                    cursors[i].nextBlock();
+            }
+        }
+
+        // El menor de los términos actuales, que puede estar en varios segmentos
+        const TermCursor *first = NULL;
+        for (auto &cursor : cursors)
+        {
+            if (isInPrefix(cursor) && (!first || cursor.getText() < first->getText()))
+                first = &cursor;
+        }
+
+        if (!first)
+            break;
+
+        text = first->getText();
+        uint32_t documentFrequency = 0;
+        for (auto &cursor : cursors)
+        {
+            if (isInPrefix(cursor) && cursor.getText() == text)
+                documentFrequency += cursor.getEntry().documentFrequency;
+        }
+
+        // El heap tiene el peor arriba
+        if (completions.size() < count)
+        {
+            completions.push_back({text, documentFrequency});
+            push_heap(completions.begin(), completions.end(), isBetterCompletion);
+        }
+        else if (documentFrequency > completions.front().documentFrequency)
+        {
+            pop_heap(completions.begin(), completions.end(), isBetterCompletion);
+            completions.back() = {text, documentFrequency};
+            push_heap(completions.begin(), completions.end(), isBetterCompletion);
+        }
+
+        for (auto &cursor : cursors)
+        {
+            if (isInPrefix(cursor) && cursor.getText() == text)
+                cursor.next();
+        }
+    }
+
+    if (any_of(segments.begin(), segments.end(), [](const shared_ptr<const IndexSegment> &segment)
+               { return !segment->deletedDocIds.empty(); }))
+    {
+        for (auto &completion : completions)
+        {
+            completion.documentFrequency = 0;
+            for (auto &segment : segments)
+                completion.documentFrequency += segment->index->getDocumentFrequency(completion.term,
+                                                                                     segment->deletedDocIds);
+        }
+
+        completions.erase(remove_if(completions.begin(), completions.end(),
+                                    [](const TermCompletion &completion)
+                                    { return !completion.documentFrequency; }),
+                          completions.end());
+    }
+
+    sort(completions.begin(), completions.end(), isBetterCompletion);
+}
+
+/**
+ * @brief The index of each segment, as searched together
+ *
+ * @return vector<const SearchIndex *>
+ */
+vector<const SearchIndex *> IndexSnapshot::getIndexes() const
+{
+    vector<const SearchIndex *> indexes;
+    for (auto &segment : segments)
+        indexes.push_back(segment->index.get());
+
+    return indexes;
+}
+
+Document IndexSnapshot::getDocument(DocId docId) const
+{
+    size_t segment = upper_bound(docIdBases.begin(), docIdBases.end(), docId) - docIdBases.begin() - 1;
+
+    return segments[segment]->index->getDocument(docId - docIdBases[segment]);
+}
+
+/**
+ * @brief Number of pages, without the deleted ones
+ *
+ * @return size_t
+ */
+size_t IndexSnapshot::getDocumentCount() const
+{
+    return documentCount;
+}
+
+size_t IndexSnapshot::getSegmentCount() const
+{
+    return segments.size();
+}
+
+const IndexSegment &IndexSnapshot::getSegment(size_t segment) const
+{
+    return *segments[segment];
+}
+
+/**
+ * @brief Adds a segment after the others. Solo mientras se arma el snapshot
+ *
+ * @param segment
+ */
+void IndexSnapshot::addSegment(shared_ptr<const IndexSegment> segment)
+{
+    DocId docIdBase = 0;
+    if (!segments.empty())
+        docIdBase = docIdBases.back() + (DocId)segments.back()->index->getDocumentCount();
+
+    documentCount += getLiveDocumentCount(*segment);
+
+    docIdBases.push_back(docIdBase);
+    segments.push_back(move(segment));
+}
+
+IndexMatches::IndexMatches()
+{
+    snapshot = NULL;
+    mode = SEARCH_ALL_WORDS;
+    segment = 0;
+    nextDeleted = 0;
+}
+
+/**
+ * @brief Finds the next pages that match
+ *
+ * @param docIds    where to write them
+ * @param maxCount
+ * @return size_t   number of pages found. 0 means there are no more
+ */
+size_t IndexMatches::next(DocId *docIds, size_t maxCount)
+{
+    if (!snapshot)
+        return 0;
+
+    size_t count = 0;
+
+    while (count < maxCount && segment < snapshot->segments.size())
+    {
+        size_t found = matches.next(docIds + count, maxCount - count);
+        if (!found)
+        {
+            segment++;
+            openSegment();
+            continue;
+        }
+
+        found = snapshot->segments[segment]->index->filterPositions(query, docIds + count, found);
+
+        // Las páginas borradas se saltean; las dos listas están ordenadas
+        const vector<DocId> &deletedDocIds = snapshot->segments[segment]->deletedDocIds;
+        DocId docIdBase = snapshot->docIdBases[segment];
+        size_t end = count + found;
+
+        for (size_t i = count; i < end; i++)
+        {
+            DocId docId = docIds[i];
+
+            while (nextDeleted < deletedDocIds.size() && deletedDocIds[nextDeleted] < docId)
+                nextDeleted++;
+
+            if (nextDeleted < deletedDocIds.size() && deletedDocIds[nextDeleted] == docId)
+                continue;
+
+            docIds[count++] = docIdBase + docId;
+        }
+    }
+
+    return count;
+}
+
+void IndexMatches::openSegment()
+{
+    nextDeleted = 0;
+
+    if (segment < snapshot->segments.size())
+        snapshot->segments[segment]->index->openMatches(query, mode, matches, unionPostings);
+}
+
+/**
+ * @brief Construct a new SegmentedIndex, without segments
+ *
+ * @param indexPath     directory for the segments and the manifest
+ * @param wikiPath      directory that contains the .html pages
+ * @param options       how to build the segments
+ */
+SegmentedIndex::SegmentedIndex(const string &indexPath, const string &wikiPath,
+                               const SearchIndexOptions &options)
+{
+    this->indexPath = indexPath;
+    this->wikiPath = wikiPath;
+    this->options = options;
+    nextSegmentNumber = 0;
+
+    currentSnapshot = new shared_ptr<const IndexSnapshot>(make_shared<IndexSnapshot>());
+    epoch = 0;
+    activeReaders[0] = 0;
+    activeReaders[1] = 0;
+
+    hasNewSegments = false;
+    isStopping = false;
+}
+
+SegmentedIndex::~SegmentedIndex()
+{
+    stopMerging();
+
+    delete currentSnapshot.load();
+}
+
+/**
+ * @brief Maps the segments listed in the manifest
+ *
+ * Si una página está en más de un segmento, vale la del más nuevo. Las páginas
+ * borradas o cambiadas desde que se guardó se corrigen con update().
+ *
+ * @return true if every segment was read and uses the codec and positions of
+ *              the options
+ */
+bool SegmentedIndex::load()
+{
+    lock_guard<mutex> lock(writerMutex);
+
+    ifstream manifest(filesystem::path(indexPath) / MANIFEST_FILENAME);
+    if (!manifest.is_open())
+        return false;
+
+    vector<shared_ptr<IndexSegment>> segments;
+    string filename;
+
+    while (getline(manifest, filename))
+    {
+        if (filename.empty())
+            continue;
+
+        auto index = make_shared<SearchIndex>();
+        if (!index->load((filesystem::path(indexPath) / filename).string()) ||
+            index->getCodec() != options.codec ||
+            index->hasPositions() != options.storePositions)
+            return false;
+
+        auto segment = make_shared<IndexSegment>();
+        segment->index = index;
+        segment->filename = filename;
+        segment->deletedLength = 0;
+        segments.push_back(segment);
+
+        size_t numberStart = SEGMENT_PREFIX.size();
+        uint64_t number = strtoull(filename.c_str() + min(numberStart, filename.size()), NULL, 10);
+        nextSegmentNumber = max(nextSegmentNumber, number + 1);
+    }
+
+    if (segments.empty())
+        return false;
+
+    unordered_set<string_view> newerPaths;
+    for (size_t i = segments.size(); i-- > 0;)
+    {
+        const SearchIndex &index = *segments[i]->index;
+        vector<DocId> deletedDocIds;
+
+        for (DocId docId = 0; docId < index.getDocumentCount(); docId++)
+        {
+            if (!newerPaths.insert(index.getDocument(docId).path).second)
+                deletedDocIds.push_back(docId);
+        }
+
+        setDeletedDocIds(*segments[i], deletedDocIds);
+    }
+
+    // Los segmentos sin páginas vigentes se descartan
+    auto snapshot = make_shared<IndexSnapshot>();
+    for (auto &segment : segments)
+    {
+        if (getLiveDocumentCount(*segment))
+            snapshot->addSegment(segment);
+    }
+
+    publish(snapshot);
+
+    return true;
+}
+
+/**
+ * @brief Makes an index of all the pages, in a single segment
+ *
+ */
+void SegmentedIndex::build()
+{
+    lock_guard<mutex> lock(writerMutex);
+
+    error_code error;
+    filesystem::create_directories(indexPath, error);
+
+    auto index = make_shared<SearchIndex>();
+    index->buildPages(listPages(wikiPath), options);
+
+    auto snapshot = make_shared<IndexSnapshot>();
+    snapshot->addSegment(saveSegment(index));
+
+    saveManifest(*snapshot);
+    publish(snapshot);
+    removeUnusedSegments(*snapshot);
+}
+
+/**
+ * @brief Adds a segment with the pages added or changed since the last
+ *        update, and marks as deleted their previous versions and the deleted
+ *        pages. Solo se leen las páginas con otro tamaño o fecha
+ *
+ * @return size_t   number of pages that were added, changed or deleted
+ */
+size_t SegmentedIndex::update()
+{
+    lock_guard<mutex> lock(writerMutex);
+
+    shared_ptr<const IndexSnapshot> snapshot = getSnapshot();
+    size_t segmentCount = snapshot->segments.size();
+
+    // Segmento y docId de cada página vigente
+    struct LivePage
+    {
+        size_t segment;
+        DocId docId;
+        bool isFound;
+    };
+    unordered_map<string_view, LivePage> livePages;
+
+    for (size_t i = 0; i < segmentCount; i++)
+    {
+        const IndexSegment &segment = *snapshot->segments[i];
+        size_t nextDeleted = 0;
+
+        for (DocId docId = 0; docId < segment.index->getDocumentCount(); docId++)
+        {
+            if (nextDeleted < segment.deletedDocIds.size() && segment.deletedDocIds[nextDeleted] == docId)
+            {
+                nextDeleted++;
+                continue;
+            }
+
+            livePages[segment.index->getDocument(docId).path] = {i, docId, false};
+        }
+    }
+
+    vector<filesystem::path> pagesToRead;
+    vector<vector<DocId>> newDeletedDocIds(segmentCount);
+    size_t deletedCount = 0;
+
+    ParsedDocument page;
+    for (auto &filePath : listPages(wikiPath))
+    {
+        getFileStamp(filePath, page);
+        page.path = getDocumentPath(filePath);
+
+        auto livePage = livePages.find(page.path);
+        if (livePage != livePages.end())
+        {
+            LivePage &location = livePage->second;
+            location.isFound = true;
+
+            Document document = snapshot->segments[location.segment]->index->getDocument(location.docId);
+            if (document.fileSize == page.fileSize && document.modificationTime == page.modificationTime)
+                continue;
+
+            newDeletedDocIds[location.segment].push_back(location.docId);
+        }
+
+        pagesToRead.push_back(filePath);
+    }
+
+    for (auto &livePage : livePages)
+    {
+        if (!livePage.second.isFound)
+        {
+            newDeletedDocIds[livePage.second.segment].push_back(livePage.second.docId);
+            deletedCount++;
+        }
+    }
+
+    if (pagesToRead.empty() && !deletedCount)
+        return 0;
+
+    auto newSnapshot = make_shared<IndexSnapshot>();
+
+    for (size_t i = 0; i < segmentCount; i++)
+    {
+        shared_ptr<const IndexSegment> segment = snapshot->segments[i];
+
+        if (!newDeletedDocIds[i].empty())
+        {
+            vector<DocId> deletedDocIds = segment->deletedDocIds;
+            deletedDocIds.insert(deletedDocIds.end(), newDeletedDocIds[i].begin(), newDeletedDocIds[i].end());
+
+            // Un segmento sin páginas vigentes se descarta
+            if (deletedDocIds.size() == segment->index->getDocumentCount())
+                continue;
+
+            auto changedSegment = make_shared<IndexSegment>(*segment);
+            setDeletedDocIds(*changedSegment, deletedDocIds);
+            segment = changedSegment;
+        }
+
+        newSnapshot->addSegment(segment);
+    }
+
+    if (!pagesToRead.empty())
+    {
+        auto index = make_shared<SearchIndex>();
+        index->buildPages(pagesToRead, options);
+
+        newSnapshot->addSegment(saveSegment(index));
+    }
+
+    saveManifest(*newSnapshot);
+    publish(newSnapshot);
+    removeUnusedSegments(*newSnapshot);
+
+    hasNewSegments = true;
+    mergeCondition.notify_one();
+
+    return pagesToRead.size() + deletedCount;
+}
+
+/**
+ * @brief Merges segments until no level has too many of them
+ *
+ */
+void SegmentedIndex::mergeSegments()
+{
+    lock_guard<mutex> lock(writerMutex);
+
+    while (mergeNextSegments())
+        ;
+}
+
+/**
+ * @brief Starts a thread that merges segments after each update
+ *
+ */
+void SegmentedIndex::startMerging()
+{
+    stopMerging();
+
+    {
+        lock_guard<mutex> lock(writerMutex);
+        isStopping = false;
+        hasNewSegments = true;
+    }
+
+    mergeThread = thread(&SegmentedIndex::runMerges, this);
+}
+
+/**
+ * @brief Stops the merging thread, after the merge in progress
+ *
+ */
+void SegmentedIndex::stopMerging()
+{
+    {
+        lock_guard<mutex> lock(writerMutex);
+        isStopping = true;
+    }
+    mergeCondition.notify_all();
+
+    if (mergeThread.joinable())
+        mergeThread.join();
+}
+
+/**
+ * @brief The segments to search now
+ *
+ * Sin locks: el lector se anota en el contador de la época actual antes de
+ * copiar el shared_ptr, y publish() no libera el anterior hasta que se vacía
+ * el contador de la época en la que se reemplazó. Si la época cambia justo
+ * mientras se anota, vuelve a empezar.
+ *
+ * @return shared_ptr<const IndexSnapshot>
+ */
+shared_ptr<const IndexSnapshot> SegmentedIndex::getSnapshot() const
+{
+    uint64_t readerEpoch;
+
+    while (true)
+    {
+        readerEpoch = epoch.load();
+        activeReaders[readerEpoch & 1]++;
+
+        if (epoch.load() == readerEpoch)
+            break;
+
+        activeReaders[readerEpoch & 1]--;
+    }
+
+    shared_ptr<const IndexSnapshot> snapshot = *currentSnapshot.load();
+
+    activeReaders[readerEpoch & 1]--;
+
+    return snapshot;
+}
+
+const string &SegmentedIndex::getWikiPath() const
+{
+    return wikiPath;
+}
+
+/**
+ * @brief Writes a new segment to disk and maps it, so that the index is not
+ *        kept twice in memory
+ *
+ * @param index     just built
+ * @return shared_ptr<const IndexSegment>
+ */
+shared_ptr<const IndexSegment> SegmentedIndex::saveSegment(shared_ptr<SearchIndex> index)
+{
+    auto segment = make_shared<IndexSegment>();
+    segment->filename = SEGMENT_PREFIX + to_string(nextSegmentNumber++) + SEGMENT_EXTENSION;
+    segment->deletedLength = 0;
+
+    string filename = (filesystem::path(indexPath) / segment->filename).string();
+
+    auto mappedIndex = make_shared<SearchIndex>();
+    if (index->save(filename) && mappedIndex->load(filename))
+        segment->index = mappedIndex;
+    else
+    {
+        cout << "No se pudo guardar el segmento " << filename << endl;
+        segment->index = index;
+    }
+
+    return segment;
+}
+
+/**
+ * @brief Merges the segments with many deleted pages, or else the first
+ *        MERGE_FACTOR segments of the lowest level that has that many
+ *
+ * El segmento mezclado queda en el lugar del más nuevo de los que reemplaza,
+ * para que load() siga sabiendo qué versión de cada página vale.
+ *
+ * @return true if segments were merged
+ */
+bool SegmentedIndex::mergeNextSegments()
+{
+    shared_ptr<const IndexSnapshot> snapshot = getSnapshot();
+    const auto &segments = snapshot->segments;
+
+    vector<size_t> segmentsToMerge;
+
+    for (size_t i = 0; i < segments.size() && segmentsToMerge.empty(); i++)
+    {
+        size_t deletedCount = segments[i]->deletedDocIds.size();
+        if (deletedCount && 2 * deletedCount >= segments[i]->index->getDocumentCount())
+            segmentsToMerge.push_back(i);
+    }
+
+    for (unsigned int level = 0; segmentsToMerge.empty() && segments.size() >= MERGE_FACTOR; level++)
+    {
+        vector<size_t> levelSegments;
+        bool hasLargerSegments = false;
+
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            unsigned int segmentLevel = getSegmentLevel(*segments[i]);
+            if (segmentLevel == level)
+                levelSegments.push_back(i);
+            else if (segmentLevel > level)
+                hasLargerSegments = true;
+        }
+
+        if (levelSegments.size() >= MERGE_FACTOR)
+            segmentsToMerge.assign(levelSegments.begin(), levelSegments.begin() + MERGE_FACTOR);
+        else if (!hasLargerSegments)
+            break;
+    }
+
+    if (segmentsToMerge.empty())
+        return false;
+
+    auto t1 = chrono::high_resolution_clock::now();
+
+    vector<const SearchIndex *> indexes;
+    vector<const vector<DocId> *> deletedDocIds;
+    for (auto i : segmentsToMerge)
+    {
+        indexes.push_back(segments[i]->index.get());
+        deletedDocIds.push_back(&segments[i]->deletedDocIds);
+    }
+
+    auto index = make_shared<SearchIndex>();
+    index->merge(indexes, deletedDocIds, options);
+    shared_ptr<const IndexSegment> mergedSegment = saveSegment(index);
+
+    auto newSnapshot = make_shared<IndexSnapshot>();
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        if (i == segmentsToMerge.back())
+        {
+            if (mergedSegment->index->getDocumentCount())
+                newSnapshot->addSegment(mergedSegment);
+        }
+        else if (find(segmentsToMerge.begin(), segmentsToMerge.end(), i) == segmentsToMerge.end())
+            newSnapshot->addSegment(segments[i]);
+    }
+
+    saveManifest(*newSnapshot);
+    publish(newSnapshot);
+    removeUnusedSegments(*newSnapshot);
+
+    auto t2 = chrono::high_resolution_clock::now();
+    chrono::duration<double, std::milli> mergeTime = t2 - t1;
+
+    cout << "Segmentos mezclados: " << segmentsToMerge.size() << " en uno de "
+         << mergedSegment->index->getDocumentCount() << " páginas, en "
+         << mergeTime.count() << "ms" << endl;
+
+    return true;
+}
+
+/**
+ * @brief Replaces the current snapshot. Solo con writerMutex tomado
+ *
+ * @param snapshot
+ */
+void SegmentedIndex::publish(shared_ptr<const IndexSnapshot> snapshot)
+{
+    auto newSnapshot = new shared_ptr<const IndexSnapshot>(move(snapshot));
+    auto oldSnapshot = currentSnapshot.exchange(newSnapshot);
+
+    // Los lectores que todavía pueden estar copiando oldSnapshot se anotaron
+    // en la época anterior; los que se anoten desde ahora ven newSnapshot
+    uint64_t oldEpoch = epoch++;
+    while (activeReaders[oldEpoch & 1] != 0)
+        this_thread::yield();
+
+    delete oldSnapshot;
+}
+
+/**
+ * @brief Writes the list of segments of a snapshot. Se escribe primero a un
+ *        archivo temporal y después se renombra, como SearchIndex::save()
+ *
+ * @param snapshot
+ * @return true if the manifest was saved
+ */
+bool SegmentedIndex::saveManifest(const IndexSnapshot &snapshot)
+{
+    auto filename = filesystem::path(indexPath) / MANIFEST_FILENAME;
+    auto temporaryFilename = filename;
+    temporaryFilename += ".tmp";
+
+    {
+        ofstream manifest(temporaryFilename);
+        if (!manifest.is_open())
+            return false;
+
+        for (auto &segment : snapshot.segments)
+            manifest << segment->filename << endl;
+
+        if (!manifest.good())
+            return false;
+    }
+
+    error_code error;
+    filesystem::rename(temporaryFilename, filename, error);
+
+    return !error;
+}
+
+/**
+ * @brief Deletes the segment files that the snapshot does not use. Los
+ *        snapshots anteriores que todavía se usan los tienen mapeados, así que
+ *        en Linux siguen valiendo; en Windows no se pueden borrar, y se borran
+ *        en otra actualización
+ *
+ * @param snapshot
+ */
+void SegmentedIndex::removeUnusedSegments(const IndexSnapshot &snapshot)
+{
+    unordered_set<string> usedFilenames;
+    for (auto &segment : snapshot.segments)
+        usedFilenames.insert(segment->filename);
+
+    error_code error;
+    for (auto &file : filesystem::directory_iterator(indexPath, error))
+    {
+        string filename = file.path().filename().string();
+
+        if (filename.compare(0, SEGMENT_PREFIX.size(), SEGMENT_PREFIX) == 0 &&
+            !usedFilenames.count(filename))
+            filesystem::remove(file.path(), error);
+    }
+}
+
+void SegmentedIndex::runMerges()
+{
+    unique_lock<mutex> lock(writerMutex);
+
+    while (true)
+    {
+        mergeCondition.wait(lock, [this]()
+                            { return hasNewSegments || isStopping; });
+        if (isStopping)
+            break;
+
+        hasNewSegments = false;
+        while (!isStopping && mergeNextSegments())
+            ;
+    }
+}
+
+/**
+ * @brief Changes the deleted pages of a segment
+ *
+ * @param segment
+ * @param deletedDocIds     in any order
+ */
+static void setDeletedDocIds(IndexSegment &segment, vector<DocId> deletedDocIds)
+{
+    sort(deletedDocIds.begin(), deletedDocIds.end());
+
+    segment.deletedLength = 0;
+    for (auto docId : deletedDocIds)
+        segment.deletedLength += segment.index->getDocument(docId).length;
+
+    segment.deletedDocIds = move(deletedDocIds);
+}
+
+static unsigned int getSegmentLevel(const IndexSegment &segment)
+{
+    size_t documentCount = getLiveDocumentCount(segment);
+    unsigned int level = 0;
+
+    for (size_t levelSize = SMALL_SEGMENT_SIZE * MERGE_FACTOR; documentCount >= levelSize;
+         levelSize *= MERGE_FACTOR)
+        level++;
+
+    return level;
+}
+
+static size_t getLiveDocumentCount(const IndexSegment &segment)
+{
+    return segment.index->getDocumentCount() - segment.deletedDocIds.size();
+}
+
+/**
+ * @brief More frequent first; with the same frequency, alphabetically
+ *
+ */
+static bool isBetterCompletion(const TermCompletion &a, const TermCompletion &b)
+{
+    return a.documentFrequency > b.documentFrequency ||
+           (a.documentFrequency == b.documentFrequency && a.term < b.term);
+}
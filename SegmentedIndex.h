@@ -0,0 +1,164 @@
+/**
+ * @file SegmentedIndex.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Search index split in immutable segments
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef SEGMENTEDINDEX_H
+#define SEGMENTEDINDEX_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "PostingIntersection.h"
+#include "SearchIndex.h"
+
+// Un índice de algunas páginas, y cuáles de ellas ya no valen
+struct IndexSegment
+{
+    std::shared_ptr<const SearchIndex> index;
+    std::string filename;
+    std::vector<DocId> deletedDocIds;   // en orden creciente
+    uint64_t deletedLength;             // suma de los largos de esas páginas
+};
+
+class IndexMatches;
+
+/**
+ * @brief The segments that are searched together at one moment
+ *
+ * Nunca cambia: cada actualización arma un snapshot nuevo, y las búsquedas que
+ * empezaron con el anterior lo siguen usando hasta terminar. Los docIds son
+ * los de cada segmento, uno a continuación del otro, y solo valen dentro del
+ * mismo snapshot.
+ */
+class IndexSnapshot
+{
+public:
+    IndexSnapshot();
+
+    size_t search(const std::string &searchString, SearchMode mode,
+                  size_t offset, size_t count, std::vector<SearchResult> &results,
+                  SearchTiming *timing = NULL) const;
+    void openMatches(const std::string &searchString, SearchMode mode, IndexMatches &matches) const;
+    void findCompletions(const std::string &prefix, size_t count,
+                         std::vector<TermCompletion> &completions) const;
+
+    Document getDocument(DocId docId) const;
+    size_t getDocumentCount() const;
+    size_t getSegmentCount() const;
+    const IndexSegment &getSegment(size_t segment) const;
+
+private:
+    friend class IndexMatches;
+    friend class SegmentedIndex;
+
+    void addSegment(std::shared_ptr<const IndexSegment> segment);
+    std::vector<const SearchIndex *> getIndexes() const;
+
+    std::vector<std::shared_ptr<const IndexSegment>> segments;
+    std::vector<DocId> docIdBases;      // el primer docId de cada segmento
+    size_t documentCount;
+};
+
+/**
+ * @brief Pages of a snapshot that match a search, in docId order and without
+ *        ranking them, a few at a time
+ */
+class IndexMatches
+{
+public:
+    IndexMatches();
+
+    IndexMatches(const IndexMatches &) = delete;
+    IndexMatches &operator=(const IndexMatches &) = delete;
+
+    size_t next(DocId *docIds, size_t maxCount);
+
+private:
+    friend class IndexSnapshot;
+
+    void openSegment();
+
+    const IndexSnapshot *snapshot;
+    SearchQuery query;
+    SearchMode mode;
+
+    size_t segment;
+    size_t nextDeleted;
+    PostingStream matches;
+    std::vector<std::vector<uint8_t>> unionPostings;    // las de las palabras con variantes
+};
+
+/**
+ * @brief Search index that takes updates while it is searched
+ *
+ * Cada actualización agrega un segmento chico con las páginas nuevas o
+ * cambiadas, y marca como borradas las versiones anteriores. Un hilo aparte
+ * mezcla los segmentos de tamaño parecido, para que no se acumulen. Cada
+ * segmento está en su propio archivo, mapeado en memoria; el manifiesto dice
+ * cuáles forman el índice, del más viejo al más nuevo.
+ *
+ * getSnapshot() no toma ningún lock: los cambios se publican reemplazando un
+ * puntero atómico, y el puntero anterior se libera recién cuando ningún lector
+ * puede estar copiándolo.
+ */
+class SegmentedIndex
+{
+public:
+    SegmentedIndex(const std::string &indexPath, const std::string &wikiPath,
+                   const SearchIndexOptions &options);
+    ~SegmentedIndex();
+
+    SegmentedIndex(const SegmentedIndex &) = delete;
+    SegmentedIndex &operator=(const SegmentedIndex &) = delete;
+
+    bool load();
+    void build();
+    size_t update();
+    void mergeSegments();
+
+    void startMerging();
+    void stopMerging();
+
+    std::shared_ptr<const IndexSnapshot> getSnapshot() const;
+    const std::string &getWikiPath() const;
+
+private:
+    std::shared_ptr<const IndexSegment> saveSegment(std::shared_ptr<SearchIndex> index);
+    bool mergeNextSegments();
+    void publish(std::shared_ptr<const IndexSnapshot> snapshot);
+    bool saveManifest(const IndexSnapshot &snapshot);
+    void removeUnusedSegments(const IndexSnapshot &snapshot);
+    void runMerges();
+
+    std::string indexPath;
+    std::string wikiPath;
+    SearchIndexOptions options;
+    uint64_t nextSegmentNumber;
+
+    // El snapshot actual (ver getSnapshot() y publish())
+    std::atomic<std::shared_ptr<const IndexSnapshot> *> currentSnapshot;
+    std::atomic<uint64_t> epoch;
+    mutable std::atomic<uint32_t> activeReaders[2];
+
+    // Solo para los que cambian el índice: update() y las mezclas
+    std::mutex writerMutex;
+    std::condition_variable mergeCondition;
+    bool hasNewSegments;
+    bool isStopping;
+    std::thread mergeThread;
+};
+
+#endif
@@ -9,19 +9,32 @@
  */
 
 #include <filesystem>
-#include <fstream>
-#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#endif
 
 #include "ServeHttpRequestHandler.h"
 
 using namespace std;
 
-ServeHttpRequestHandler::ServeHttpRequestHandler(string homePath)
+static uint64_t getModificationTime(const struct stat &status);
+
+/**
+ * @brief Construct a new ServeHttpRequestHandler
+ *
+ * @param homePath
+ * @param fileCacheSize     maximum bytes of files kept in memory
+ */
+ServeHttpRequestHandler::ServeHttpRequestHandler(string homePath, size_t fileCacheSize) : fileCache(fileCacheSize)
 {
-    this->homePath = homePath;
+    this->homePath = filesystem::absolute(homePath).string();
 }
 
-bool ServeHttpRequestHandler::handleRequest(string url, HttpArguments arguments, vector<char> &response)
+bool ServeHttpRequestHandler::handleRequest(string url, HttpArguments arguments, HttpResponse &response)
 {
     return serve(url, response);
 }
@@ -29,35 +42,69 @@ bool ServeHttpRequestHandler::handleRequest(string url, HttpArguments arguments,
 /**
  * @brief Serves a static webpage
  *
+ * Los archivos chicos salen del cache; los grandes se envían con sendfile.
+ *
  * @param url The URL
  * @param response The HTTP response
  * @return true URL valid
  * @return false URL invalid
  */
-bool ServeHttpRequestHandler::serve(string url, vector<char> &response)
+bool ServeHttpRequestHandler::serve(string url, HttpResponse &response)
 {
     // Blocks directory traversal
     // e.g. https://www.example.com/show_file.php?file=../../MyFile
-    // * Builds absolute local path from url
-    // * Checks if absolute local path is within home path
-    auto homeAbsolutePath = filesystem::absolute(homePath);
-    auto relativePath = homeAbsolutePath / url.substr(1);
-    string path = filesystem::absolute(relativePath.make_preferred()).string();
-
-    if (path.substr(0, homeAbsolutePath.string().size()) != homeAbsolutePath)
+    // * Normalizes the url without touching the disk
+    // * Checks that it does not go above home path
+    auto relativePath = filesystem::path(url.substr(1)).lexically_normal();
+    if (relativePath.empty() || relativePath.has_root_path() || *relativePath.begin() == "..")
         return false;
 
+    string path = (filesystem::path(homePath) / relativePath).make_preferred().string();
+
     // Serves file
-    ifstream file(path);
-    if (file.fail())
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0 || (status.st_mode & S_IFMT) != S_IFREG)
         return false;
 
-    file.seekg(0, ios::end);
-    int fileSize = file.tellg();
-    file.seekg(0, ios::beg);
+    size_t fileSize = (size_t)status.st_size;
+
+    if (fileSize > fileCache.getMaxFileSize())
+    {
+#ifdef _WIN32
+        int fileDescriptor = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        int fileDescriptor = open(path.c_str(), O_RDONLY);
+#endif
+        if (fileDescriptor < 0)
+            return false;
 
-    response.resize(fileSize);
-    file.read(response.data(), fileSize);
+        response.fileDescriptor = fileDescriptor;
+        response.fileSize = fileSize;
 
-    return true;
+        return true;
+    }
+
+    response.sharedBody = fileCache.get(path, getModificationTime(status), fileSize);
+
+    return response.sharedBody != NULL;
+}
+
+/**
+ * @brief When a file was last modified, with the precision the file system has
+ *
+ * Con solo los segundos, una página reescrita en el mismo segundo y con el
+ * mismo largo se seguiría sirviendo vieja desde el cache.
+ *
+ * @param status
+ * @return uint64_t     in nanoseconds
+ */
+static uint64_t getModificationTime(const struct stat &status)
+{
+#if defined(_WIN32)
+    return (uint64_t)status.st_mtime * 1000000000;
+#elif defined(__APPLE__)
+    return (uint64_t)status.st_mtimespec.tv_sec * 1000000000 + (uint64_t)status.st_mtimespec.tv_nsec;
+#else
+    return (uint64_t)status.st_mtim.tv_sec * 1000000000 + (uint64_t)status.st_mtim.tv_nsec;
+#endif
 }
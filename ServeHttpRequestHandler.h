@@ -11,20 +11,22 @@
 #ifndef SERVEHTTPREQUESTHANDLER_H
 #define SERVEHTTPREQUESTHANDLER_H
 
+#include "FileCache.h"
 #include "HttpServer.h"
 
 class ServeHttpRequestHandler : public HttpRequestHandler
 {
 public:
-    ServeHttpRequestHandler(std::string homePath);
+    ServeHttpRequestHandler(std::string homePath, size_t fileCacheSize);
 
-    bool handleRequest(std::string url, HttpArguments arguments, std::vector<char> &response);
+    bool handleRequest(std::string url, HttpArguments arguments, HttpResponse &response);
 
 protected:
-    bool serve(std::string path, std::vector<char> &response);
+    bool serve(std::string path, HttpResponse &response);
 
 private:
     std::string homePath;
+    FileCache fileCache;
 };
 
 #endif
@@ -0,0 +1,378 @@
+/**
+ * @file ServerMetrics.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Latency histograms and counters of the server, in Prometheus format
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "ServerMetrics.h"
+
+using namespace std;
+
+// Los buckets de Prometheus van de 2^10 ns (~1 µs) a 2^33 ns (~8.6 s). Caen
+// justo en bordes de los buckets del histograma, así que las cuentas son exactas
+static const size_t PROMETHEUS_FIRST_BUCKET_BITS = 10;
+static const size_t PROMETHEUS_LAST_BUCKET_BITS = 33;
+
+static const double PROMETHEUS_QUANTILES[] = {0.5, 0.99, 0.999};
+
+static const char *const STAGE_NAMES[METRIC_STAGE_COUNT] = {"parse", "lookup", "intersect", "render", "send"};
+static const char *const REQUEST_KINDS[] = {"search", "suggest", "file", "metrics", "not_found"};
+
+/**
+ * @brief The histograms and counters of one thread. Solo ese hilo las escribe
+ */
+struct ThreadMetrics
+{
+    atomic<uint64_t> bucketCounts[METRIC_STAGE_COUNT][LATENCY_BUCKET_COUNT];
+    atomic<uint64_t> sums[METRIC_STAGE_COUNT];
+    atomic<uint64_t> counters[METRIC_COUNTER_COUNT];
+};
+
+// Las métricas del último ServerMetrics que usó cada hilo, para no tomar el lock
+struct ThreadMetricsCache
+{
+    uint64_t ownerId;
+    ThreadMetrics *metrics;
+};
+
+static thread_local ThreadMetricsCache threadMetricsCache = {0, NULL};
+static atomic<uint64_t> nextMetricsId(1);
+
+static void addRelaxed(atomic<uint64_t> &value, uint64_t amount);
+static string formatNumber(double value);
+
+/**
+ * @brief Construct a new, empty LatencyHistogram
+ *
+ */
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+void LatencyHistogram::add(uint64_t nanoseconds, uint64_t count)
+{
+    bucketCounts[getBucket(nanoseconds)] += count;
+    this->count += count;
+    sum += nanoseconds * count;
+}
+
+void LatencyHistogram::clear()
+{
+    for (auto &bucketCount : bucketCounts)
+        bucketCount = 0;
+
+    count = 0;
+    sum = 0;
+}
+
+uint64_t LatencyHistogram::getCount() const
+{
+    return count;
+}
+
+/**
+ * @brief Sum of the latencies added
+ *
+ * @return uint64_t     in nanoseconds
+ */
+uint64_t LatencyHistogram::getSum() const
+{
+    return sum;
+}
+
+/**
+ * @brief Counts the latencies below a bound
+ *
+ * @param nanoseconds   exact if it is the start of a bucket
+ * @return uint64_t
+ */
+uint64_t LatencyHistogram::getCountBelow(uint64_t nanoseconds) const
+{
+    uint64_t countBelow = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT && getBucketStart(bucket) < nanoseconds; bucket++)
+        countBelow += bucketCounts[bucket];
+
+    return countBelow;
+}
+
+/**
+ * @brief The latency that is above that fraction of the latencies
+ *
+ * @param fraction
+ * @return uint64_t     the middle of its bucket, in nanoseconds; 0 if empty
+ */
+uint64_t LatencyHistogram::getPercentile(double fraction) const
+{
+    uint64_t rank = max((uint64_t)ceil(fraction * count), (uint64_t)1);
+
+    uint64_t countBelow = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++)
+    {
+        countBelow += bucketCounts[bucket];
+        if (countBelow >= rank)
+        {
+            uint64_t start = getBucketStart(bucket);
+            uint64_t end = (bucket + 1 < LATENCY_BUCKET_COUNT) ? getBucketStart(bucket + 1) : start + 1;
+
+            return start + (end - start) / 2;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief The bucket of a latency
+ *
+ * Los primeros 2 * LATENCY_SUB_BUCKETS valores tienen un bucket cada uno;
+ * después, cada potencia de 2 se divide en LATENCY_SUB_BUCKETS buckets.
+ *
+ * @param nanoseconds
+ * @return size_t
+ */
+size_t LatencyHistogram::getBucket(uint64_t nanoseconds)
+{
+    if (nanoseconds >> LATENCY_MAX_BITS)
+        return LATENCY_BUCKET_COUNT - 1;
+
+    size_t shift = 0;
+    while ((nanoseconds >> shift) >= 2 * LATENCY_SUB_BUCKETS)
+        shift++;
+
+    return shift * LATENCY_SUB_BUCKETS + (size_t)(nanoseconds >> shift);
+}
+
+/**
+ * @brief The smallest latency of a bucket
+ *
+ * @param bucket
+ * @return uint64_t     in nanoseconds
+ */
+uint64_t LatencyHistogram::getBucketStart(size_t bucket)
+{
+    if (bucket < 2 * LATENCY_SUB_BUCKETS)
+        return bucket;
+
+    size_t shift = bucket / LATENCY_SUB_BUCKETS - 1;
+
+    return (uint64_t)(bucket - shift * LATENCY_SUB_BUCKETS) << shift;
+}
+
+/**
+ * @brief Construct a new ServerMetrics
+ *
+ */
+ServerMetrics::ServerMetrics()
+{
+    id = nextMetricsId++;
+}
+
+ServerMetrics::~ServerMetrics()
+{
+}
+
+/**
+ * @brief Adds the time of a stage of a request
+ *
+ * @param stage
+ * @param milliseconds
+ */
+void ServerMetrics::addTime(MetricStage stage, double milliseconds)
+{
+    uint64_t nanoseconds = (uint64_t)(max(milliseconds, 0.0) * 1e6 + 0.5);
+
+    ThreadMetrics &metrics = getThreadMetrics();
+    addRelaxed(metrics.bucketCounts[stage][LatencyHistogram::getBucket(nanoseconds)], 1);
+    addRelaxed(metrics.sums[stage], nanoseconds);
+}
+
+void ServerMetrics::addCount(MetricCounter counter, uint64_t value)
+{
+    addRelaxed(getThreadMetrics().counters[counter], value);
+}
+
+/**
+ * @brief Adds up the latencies of a stage in all the threads
+ *
+ * @param stage
+ * @param histogram
+ */
+void ServerMetrics::getHistogram(MetricStage stage, LatencyHistogram &histogram) const
+{
+    histogram.clear();
+
+    lock_guard<mutex> lock(threadsMutex);
+
+    for (auto &entry : threadMetrics)
+    {
+        ThreadMetrics &metrics = *entry.second;
+
+        for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++)
+        {
+            uint64_t bucketCount = metrics.bucketCounts[stage][bucket].load(memory_order_relaxed);
+            histogram.bucketCounts[bucket] += bucketCount;
+            histogram.count += bucketCount;
+        }
+        histogram.sum += metrics.sums[stage].load(memory_order_relaxed);
+    }
+}
+
+uint64_t ServerMetrics::getCount(MetricCounter counter) const
+{
+    uint64_t count = 0;
+
+    lock_guard<mutex> lock(threadsMutex);
+
+    for (auto &entry : threadMetrics)
+        count += entry.second->counters[counter].load(memory_order_relaxed);
+
+    return count;
+}
+
+/**
+ * @brief Writes the counters and histograms in the Prometheus text format
+ *
+ * Además de los buckets, cada etapa tiene su p50, p99 y p999, calculados con
+ * todos los buckets del histograma.
+ *
+ * @param text  they are added at its end
+ */
+void ServerMetrics::write(string &text) const
+{
+    text += "# HELP edaoogle_requests_total Requests served, by kind.\n";
+    text += "# TYPE edaoogle_requests_total counter\n";
+    for (size_t kind = 0; kind <= METRIC_NOT_FOUND_REQUESTS; kind++)
+    {
+        text += "edaoogle_requests_total{kind=\"";
+        text += REQUEST_KINDS[kind];
+        text += "\"} " + to_string(getCount((MetricCounter)kind)) + "\n";
+    }
+
+    writeMetric(text, "edaoogle_sent_bytes_total", "counter", "Bytes of the responses sent.",
+                (double)getCount(METRIC_SENT_BYTES));
+
+    LatencyHistogram histograms[METRIC_STAGE_COUNT];
+    for (size_t stage = 0; stage < METRIC_STAGE_COUNT; stage++)
+        getHistogram((MetricStage)stage, histograms[stage]);
+
+    text += "# HELP edaoogle_stage_duration_seconds Time of each stage of a request.\n";
+    text += "# TYPE edaoogle_stage_duration_seconds histogram\n";
+    for (size_t stage = 0; stage < METRIC_STAGE_COUNT; stage++)
+    {
+        string labels = string("{stage=\"") + STAGE_NAMES[stage] + "\"";
+        const LatencyHistogram &histogram = histograms[stage];
+
+        for (size_t bits = PROMETHEUS_FIRST_BUCKET_BITS; bits <= PROMETHEUS_LAST_BUCKET_BITS; bits++)
+        {
+            uint64_t bound = (uint64_t)1 << bits;
+            text += "edaoogle_stage_duration_seconds_bucket" + labels + ",le=\"" +
+                    formatNumber(bound / 1e9) + "\"} " + to_string(histogram.getCountBelow(bound)) + "\n";
+        }
+        text += "edaoogle_stage_duration_seconds_bucket" + labels + ",le=\"+Inf\"} " +
+                to_string(histogram.getCount()) + "\n";
+        text += "edaoogle_stage_duration_seconds_sum" + labels + "} " + formatNumber(histogram.getSum() / 1e9) + "\n";
+        text += "edaoogle_stage_duration_seconds_count" + labels + "} " + to_string(histogram.getCount()) + "\n";
+    }
+
+    text += "# HELP edaoogle_stage_duration_quantile_seconds Percentiles of the time of each stage.\n";
+    text += "# TYPE edaoogle_stage_duration_quantile_seconds gauge\n";
+    for (size_t stage = 0; stage < METRIC_STAGE_COUNT; stage++)
+    {
+        for (double quantile : PROMETHEUS_QUANTILES)
+        {
+            text += string("edaoogle_stage_duration_quantile_seconds{stage=\"") + STAGE_NAMES[stage] +
+                    "\",quantile=\"" + formatNumber(quantile) + "\"} " +
+                    formatNumber(histograms[stage].getPercentile(quantile) / 1e9) + "\n";
+        }
+    }
+}
+
+/**
+ * @brief The metrics of the calling thread, which are created the first time
+ *
+ * @return ThreadMetrics&
+ */
+ThreadMetrics &ServerMetrics::getThreadMetrics()
+{
+    if (threadMetricsCache.ownerId == id)
+        return *threadMetricsCache.metrics;
+
+    lock_guard<mutex> lock(threadsMutex);
+
+    unique_ptr<ThreadMetrics> &metrics = threadMetrics[this_thread::get_id()];
+    if (!metrics)
+        metrics = make_unique<ThreadMetrics>();
+
+    threadMetricsCache = {id, metrics.get()};
+
+    return *metrics;
+}
+
+/**
+ * @brief Writes a metric without labels, in the Prometheus text format
+ *
+ * @param text  it is added at its end
+ * @param name
+ * @param type  "counter" or "gauge"
+ * @param help
+ * @param value
+ */
+void writeMetric(string &text, const char *name, const char *type, const char *help, double value)
+{
+    text += string("# HELP ") + name + " " + help + "\n";
+    text += string("# TYPE ") + name + " " + type + "\n";
+    text += string(name) + " " + formatNumber(value) + "\n";
+}
+
+/**
+ * @brief Memory of the process that is in RAM
+ *
+ * @return uint64_t     in bytes; 0 if it is not known
+ */
+uint64_t getResidentMemory()
+{
+#ifdef __linux__
+    // En páginas: el tamaño total y después lo que está en RAM
+    ifstream statm("/proc/self/statm");
+
+    uint64_t size, residentPages;
+    if (statm >> size >> residentPages)
+        return residentPages * (uint64_t)sysconf(_SC_PAGESIZE);
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief Adds to a value that only the calling thread writes. No necesita una
+ *        suma atómica: alcanza con que los que leen no vean valores a medias
+ *
+ * @param value
+ * @param amount
+ */
+static void addRelaxed(atomic<uint64_t> &value, uint64_t amount)
+{
+    value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+static string formatNumber(double value)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", value);
+
+    return text;
+}
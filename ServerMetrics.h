@@ -0,0 +1,120 @@
+/**
+ * @file ServerMetrics.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Latency histograms and counters of the server, in Prometheus format
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef SERVERMETRICS_H
+#define SERVERMETRICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Las partes de un pedido que se miden
+enum MetricStage
+{
+    METRIC_PARSE,       // leer los argumentos y entender la búsqueda
+    METRIC_LOOKUP,      // buscar los términos en el diccionario y planear
+    METRIC_INTERSECT,   // recorrer las posting lists y puntuar
+    METRIC_RENDER,      // escribir la página de resultados
+    METRIC_SEND,        // desde que se encola la respuesta hasta que se envió
+    METRIC_STAGE_COUNT,
+};
+
+enum MetricCounter
+{
+    METRIC_SEARCH_REQUESTS,
+    METRIC_SUGGEST_REQUESTS,
+    METRIC_FILE_REQUESTS,
+    METRIC_METRICS_REQUESTS,
+    METRIC_NOT_FOUND_REQUESTS,
+    METRIC_SENT_BYTES,
+    METRIC_COUNTER_COUNT,
+};
+
+// Cada potencia de 2 se divide en 2^LATENCY_SUB_BUCKET_BITS buckets iguales,
+// así que un valor se guarda con un error relativo de a lo sumo 1/16
+const size_t LATENCY_SUB_BUCKET_BITS = 4;
+const size_t LATENCY_SUB_BUCKETS = 1 << LATENCY_SUB_BUCKET_BITS;
+
+// Hasta 2^40 ns, unos 18 minutos; lo que tarde más va al último bucket
+const size_t LATENCY_MAX_BITS = 40;
+const size_t LATENCY_BUCKET_COUNT = (LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS;
+
+/**
+ * @brief Counts of latencies in nanoseconds, in logarithmic buckets (like an
+ *        HDR histogram)
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void add(uint64_t nanoseconds, uint64_t count = 1);
+    void clear();
+
+    uint64_t getCount() const;
+    uint64_t getSum() const;
+    uint64_t getCountBelow(uint64_t nanoseconds) const;
+    uint64_t getPercentile(double fraction) const;
+
+    static size_t getBucket(uint64_t nanoseconds);
+    static uint64_t getBucketStart(size_t bucket);
+
+private:
+    friend class ServerMetrics;
+
+    uint64_t bucketCounts[LATENCY_BUCKET_COUNT];
+    uint64_t count;
+    uint64_t sum;
+};
+
+struct ThreadMetrics;
+
+/**
+ * @brief Latencies of each stage and counters of the requests served
+ *
+ * Cada hilo escribe solo en sus propios histogramas y contadores, sin locks ni
+ * operaciones atómicas de lectura-escritura: un hilo no compite con ningún
+ * otro al medir. El lock solo se toma la primera vez que un hilo mide algo, y
+ * al leer, para sumar los de todos los hilos.
+ */
+class ServerMetrics
+{
+public:
+    ServerMetrics();
+    ~ServerMetrics();
+
+    ServerMetrics(const ServerMetrics &) = delete;
+    ServerMetrics &operator=(const ServerMetrics &) = delete;
+
+    void addTime(MetricStage stage, double milliseconds);
+    void addCount(MetricCounter counter, uint64_t value = 1);
+
+    void getHistogram(MetricStage stage, LatencyHistogram &histogram) const;
+    uint64_t getCount(MetricCounter counter) const;
+
+    void write(std::string &text) const;
+
+private:
+    ThreadMetrics &getThreadMetrics();
+
+    uint64_t id;    // distinto para cada objeto, aunque se reuse la dirección
+
+    mutable std::mutex threadsMutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<ThreadMetrics>> threadMetrics;
+};
+
+void writeMetric(std::string &text, const char *name, const char *type, const char *help, double value);
+uint64_t getResidentMemory();
+
+#endif
@@ -0,0 +1,497 @@
+/**
+ * @file TextNormalizer.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Splits text in search terms and folds case and accents
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+#include "TextNormalizer.h"
+
+using namespace std;
+
+// Las entidades más largas que se reconocen, sin contar '&' y ';'
+static const size_t MAX_ENTITY_LENGTH = 32;
+
+// Lo que se usa en lugar de un caracter inválido
+static const uint32_t REPLACEMENT_CHARACTER = 0xfffd;
+
+struct HtmlEntity
+{
+    const char *name;
+    uint32_t codepoint;
+};
+
+// Entidades de HTML 4 y &apos;, ordenadas para buscarlas por bisección
+static const HtmlEntity HTML_ENTITIES[] = {
+    {"AElig", 198}, {"Aacute", 193}, {"Acirc", 194}, {"Agrave", 192}, {"Alpha", 913},
+    {"Aring", 197}, {"Atilde", 195}, {"Auml", 196}, {"Beta", 914}, {"Ccedil", 199},
+    {"Chi", 935}, {"Dagger", 8225}, {"Delta", 916}, {"ETH", 208}, {"Eacute", 201},
+    {"Ecirc", 202}, {"Egrave", 200}, {"Epsilon", 917}, {"Eta", 919}, {"Euml", 203},
+    {"Gamma", 915}, {"Iacute", 205}, {"Icirc", 206}, {"Igrave", 204}, {"Iota", 921},
+    {"Iuml", 207}, {"Kappa", 922}, {"Lambda", 923}, {"Mu", 924}, {"Ntilde", 209},
+    {"Nu", 925}, {"OElig", 338}, {"Oacute", 211}, {"Ocirc", 212}, {"Ograve", 210},
+    {"Omega", 937}, {"Omicron", 927}, {"Oslash", 216}, {"Otilde", 213}, {"Ouml", 214},
+    {"Phi", 934}, {"Pi", 928}, {"Prime", 8243}, {"Psi", 936}, {"Rho", 929},
+    {"Scaron", 352}, {"Sigma", 931}, {"THORN", 222}, {"Tau", 932}, {"Theta", 920},
+    {"Uacute", 218}, {"Ucirc", 219}, {"Ugrave", 217}, {"Upsilon", 933}, {"Uuml", 220},
+    {"Xi", 926}, {"Yacute", 221}, {"Yuml", 376}, {"Zeta", 918}, {"aacute", 225},
+    {"acirc", 226}, {"acute", 180}, {"aelig", 230}, {"agrave", 224}, {"alefsym", 8501},
+    {"alpha", 945}, {"amp", 38}, {"and", 8743}, {"ang", 8736}, {"apos", 39},
+    {"aring", 229}, {"asymp", 8776}, {"atilde", 227}, {"auml", 228}, {"bdquo", 8222},
+    {"beta", 946}, {"brvbar", 166}, {"bull", 8226}, {"cap", 8745}, {"ccedil", 231},
+    {"cedil", 184}, {"cent", 162}, {"chi", 967}, {"circ", 710}, {"clubs", 9827},
+    {"cong", 8773}, {"copy", 169}, {"crarr", 8629}, {"cup", 8746}, {"curren", 164},
+    {"dArr", 8659}, {"dagger", 8224}, {"darr", 8595}, {"deg", 176}, {"delta", 948},
+    {"diams", 9830}, {"divide", 247}, {"eacute", 233}, {"ecirc", 234}, {"egrave", 232},
+    {"empty", 8709}, {"emsp", 8195}, {"ensp", 8194}, {"epsilon", 949}, {"equiv", 8801},
+    {"eta", 951}, {"eth", 240}, {"euml", 235}, {"euro", 8364}, {"exist", 8707},
+    {"fnof", 402}, {"forall", 8704}, {"frac12", 189}, {"frac14", 188}, {"frac34", 190},
+    {"frasl", 8260}, {"gamma", 947}, {"ge", 8805}, {"gt", 62}, {"hArr", 8660},
+    {"harr", 8596}, {"hearts", 9829}, {"hellip", 8230}, {"iacute", 237}, {"icirc", 238},
+    {"iexcl", 161}, {"igrave", 236}, {"image", 8465}, {"infin", 8734}, {"int", 8747},
+    {"iota", 953}, {"iquest", 191}, {"isin", 8712}, {"iuml", 239}, {"kappa", 954},
+    {"lArr", 8656}, {"lambda", 955}, {"lang", 9001}, {"laquo", 171}, {"larr", 8592},
+    {"lceil", 8968}, {"ldquo", 8220}, {"le", 8804}, {"lfloor", 8970}, {"lowast", 8727},
+    {"loz", 9674}, {"lrm", 8206}, {"lsaquo", 8249}, {"lsquo", 8216}, {"lt", 60},
+    {"macr", 175}, {"mdash", 8212}, {"micro", 181}, {"middot", 183}, {"minus", 8722},
+    {"mu", 956}, {"nabla", 8711}, {"nbsp", 160}, {"ndash", 8211}, {"ne", 8800},
+    {"ni", 8715}, {"not", 172}, {"notin", 8713}, {"nsub", 8836}, {"ntilde", 241},
+    {"nu", 957}, {"oacute", 243}, {"ocirc", 244}, {"oelig", 339}, {"ograve", 242},
+    {"oline", 8254}, {"omega", 969}, {"omicron", 959}, {"oplus", 8853}, {"or", 8744},
+    {"ordf", 170}, {"ordm", 186}, {"oslash", 248}, {"otilde", 245}, {"otimes", 8855},
+    {"ouml", 246}, {"para", 182}, {"part", 8706}, {"permil", 8240}, {"perp", 8869},
+    {"phi", 966}, {"pi", 960}, {"piv", 982}, {"plusmn", 177}, {"pound", 163},
+    {"prime", 8242}, {"prod", 8719}, {"prop", 8733}, {"psi", 968}, {"quot", 34},
+    {"rArr", 8658}, {"radic", 8730}, {"rang", 9002}, {"raquo", 187}, {"rarr", 8594},
+    {"rceil", 8969}, {"rdquo", 8221}, {"real", 8476}, {"reg", 174}, {"rfloor", 8971},
+    {"rho", 961}, {"rlm", 8207}, {"rsaquo", 8250}, {"rsquo", 8217}, {"sbquo", 8218},
+    {"scaron", 353}, {"sdot", 8901}, {"sect", 167}, {"shy", 173}, {"sigma", 963},
+    {"sigmaf", 962}, {"sim", 8764}, {"spades", 9824}, {"sub", 8834}, {"sube", 8838},
+    {"sum", 8721}, {"sup", 8835}, {"sup1", 185}, {"sup2", 178}, {"sup3", 179},
+    {"supe", 8839}, {"szlig", 223}, {"tau", 964}, {"there4", 8756}, {"theta", 952},
+    {"thetasym", 977}, {"thinsp", 8201}, {"thorn", 254}, {"tilde", 732}, {"times", 215},
+    {"trade", 8482}, {"uArr", 8657}, {"uacute", 250}, {"uarr", 8593}, {"ucirc", 251},
+    {"ugrave", 249}, {"uml", 168}, {"upsih", 978}, {"upsilon", 965}, {"uuml", 252},
+    {"weierp", 8472}, {"xi", 958}, {"yacute", 253}, {"yen", 165}, {"yuml", 255},
+    {"zeta", 950}, {"zwj", 8205}, {"zwnj", 8204},
+};
+
+struct CodepointRange
+{
+    uint32_t first;
+    uint32_t last;
+};
+
+// Puntuación y símbolos de fuera de ASCII, que separan palabras
+static const CodepointRange SEPARATOR_RANGES[] = {
+    {0x80, 0xa9},       // controles y puntuación de Latin-1, excepto ª
+    {0xab, 0xb4},       // excepto µ
+    {0xb6, 0xb9},       // excepto º
+    {0xbb, 0xbf},
+    {0xd7, 0xd7},       // ×
+    {0xf7, 0xf7},       // ÷
+    {0x2000, 0x206f},   // puntuación general: espacios, guiones, comillas
+    {0x20a0, 0x20cf},   // monedas
+    {0x2100, 0x214f},   // ™, ℃, ...
+    {0x2190, 0x23ff},   // flechas, operadores matemáticos
+    {0x2460, 0x27bf},   // recuadros, figuras, dingbats
+    {0x2e00, 0x2e7f},
+    {0x3000, 0x303f},   // puntuación CJK
+    {0xfe00, 0xfe0f},   // selectores de variante
+    {0xfeff, 0xfeff},   // BOM
+    {0xfff0, 0xffff},
+    {0x1f000, 0x1faff}, // emojis
+};
+
+struct FoldingRange
+{
+    uint32_t first;
+    uint32_t last;
+    const char *folded;
+};
+
+// Letras latinas con acentos, en minúsculas y sin acentos
+static const FoldingRange LATIN_FOLDING_RANGES[] = {
+    {0xc0, 0xc5, "a"}, {0xc6, 0xc6, "ae"}, {0xc7, 0xc7, "c"}, {0xc8, 0xcb, "e"},
+    {0xcc, 0xcf, "i"}, {0xd0, 0xd0, "d"}, {0xd1, 0xd1, "n"}, {0xd2, 0xd6, "o"},
+    {0xd8, 0xd8, "o"}, {0xd9, 0xdc, "u"}, {0xdd, 0xdd, "y"}, {0xde, 0xde, "th"},
+    {0xdf, 0xdf, "ss"}, {0xe0, 0xe5, "a"}, {0xe6, 0xe6, "ae"}, {0xe7, 0xe7, "c"},
+    {0xe8, 0xeb, "e"}, {0xec, 0xef, "i"}, {0xf0, 0xf0, "d"}, {0xf1, 0xf1, "n"},
+    {0xf2, 0xf6, "o"}, {0xf8, 0xf8, "o"}, {0xf9, 0xfc, "u"}, {0xfd, 0xfd, "y"},
+    {0xfe, 0xfe, "th"}, {0xff, 0xff, "y"},
+    {0x100, 0x105, "a"}, {0x106, 0x10d, "c"}, {0x10e, 0x111, "d"}, {0x112, 0x11b, "e"},
+    {0x11c, 0x123, "g"}, {0x124, 0x127, "h"}, {0x128, 0x131, "i"}, {0x132, 0x133, "ij"},
+    {0x134, 0x135, "j"}, {0x136, 0x138, "k"}, {0x139, 0x142, "l"}, {0x143, 0x14b, "n"},
+    {0x14c, 0x151, "o"}, {0x152, 0x153, "oe"}, {0x154, 0x159, "r"}, {0x15a, 0x161, "s"},
+    {0x162, 0x167, "t"}, {0x168, 0x173, "u"}, {0x174, 0x175, "w"}, {0x176, 0x178, "y"},
+    {0x179, 0x17e, "z"}, {0x17f, 0x17f, "s"},
+};
+
+static const uint32_t LATIN_FOLDING_FIRST = 0xc0;
+static const uint32_t LATIN_FOLDING_LAST = 0x17f;
+
+// LATIN_FOLDING[codepoint - LATIN_FOLDING_FIRST]
+static const array<const char *, LATIN_FOLDING_LAST - LATIN_FOLDING_FIRST + 1> LATIN_FOLDING = []()
+{
+    array<const char *, LATIN_FOLDING_LAST - LATIN_FOLDING_FIRST + 1> table = {};
+
+    for (auto &range : LATIN_FOLDING_RANGES)
+    {
+        for (uint32_t codepoint = range.first; codepoint <= range.last; codepoint++)
+            table[codepoint - LATIN_FOLDING_FIRST] = range.folded;
+    }
+
+    return table;
+}();
+
+static char toLowerAscii(char c);
+static uint32_t foldCodepoint(uint32_t codepoint);
+
+/**
+ * @brief Determines if a character can be part of a word
+ *
+ * @param codepoint
+ * @return true if it is not a separator, punctuation or a symbol
+ */
+bool isWordCodepoint(uint32_t codepoint)
+{
+    if (codepoint < 0x80)
+        return isalnum((int)codepoint);
+
+    const CodepointRange *end = SEPARATOR_RANGES + sizeof(SEPARATOR_RANGES) / sizeof(SEPARATOR_RANGES[0]);
+    const CodepointRange *range = lower_bound(SEPARATOR_RANGES, end, codepoint,
+                                              [](const CodepointRange &range, uint32_t codepoint)
+                                              { return range.last < codepoint; });
+
+    return range == end || codepoint < range->first;
+}
+
+/**
+ * @brief Writes a character in UTF-8
+ *
+ * @param codepoint
+ * @param output    room for 4 bytes
+ * @return size_t   number of bytes written
+ */
+size_t encodeUtf8(uint32_t codepoint, char *output)
+{
+    if (codepoint < 0x80)
+    {
+        output[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800)
+    {
+        output[0] = (char)(0xc0 | (codepoint >> 6));
+        output[1] = (char)(0x80 | (codepoint & 0x3f));
+        return 2;
+    }
+    if (codepoint < 0x10000)
+    {
+        output[0] = (char)(0xe0 | (codepoint >> 12));
+        output[1] = (char)(0x80 | ((codepoint >> 6) & 0x3f));
+        output[2] = (char)(0x80 | (codepoint & 0x3f));
+        return 3;
+    }
+
+    output[0] = (char)(0xf0 | (codepoint >> 18));
+    output[1] = (char)(0x80 | ((codepoint >> 12) & 0x3f));
+    output[2] = (char)(0x80 | ((codepoint >> 6) & 0x3f));
+    output[3] = (char)(0x80 | (codepoint & 0x3f));
+    return 4;
+}
+
+/**
+ * @brief Reads one UTF-8 character
+ *
+ * @param text
+ * @param position
+ * @param codepoint
+ * @return size_t   number of bytes, or 0 if the character is not valid UTF-8
+ */
+size_t decodeUtf8(string_view text, size_t position, uint32_t &codepoint)
+{
+    unsigned char first = (unsigned char)text[position];
+
+    size_t length;
+    uint32_t minimum;
+
+    if (first < 0x80)
+    {
+        codepoint = first;
+        return 1;
+    }
+    else if ((first & 0xe0) == 0xc0)
+    {
+        length = 2;
+        minimum = 0x80;
+        codepoint = first & 0x1f;
+    }
+    else if ((first & 0xf0) == 0xe0)
+    {
+        length = 3;
+        minimum = 0x800;
+        codepoint = first & 0x0f;
+    }
+    else if ((first & 0xf8) == 0xf0)
+    {
+        length = 4;
+        minimum = 0x10000;
+        codepoint = first & 0x07;
+    }
+    else
+        return 0;
+
+    if (text.size() - position < length)
+        return 0;
+
+    for (size_t i = 1; i < length; i++)
+    {
+        unsigned char c = (unsigned char)text[position + i];
+        if ((c & 0xc0) != 0x80)
+            return 0;
+
+        codepoint = (codepoint << 6) | (c & 0x3f);
+    }
+
+    // Formas demasiado largas, surrogates y valores fuera de Unicode
+    if (codepoint < minimum || codepoint > 0x10ffff ||
+        (codepoint >= 0xd800 && codepoint <= 0xdfff))
+        return 0;
+
+    return length;
+}
+
+/**
+ * @brief Reads an HTML entity: named, like "&oacute;", decimal, like "&#243;",
+ *        or hexadecimal, like "&#xF3;"
+ *
+ * @param text
+ * @param position      where the '&' is
+ * @param codepoint     the character it stands for
+ * @return size_t       length of the entity, or 0 if there is none
+ */
+size_t decodeHtmlEntity(string_view text, size_t position, uint32_t &codepoint)
+{
+    // Se busca el ';' solo donde puede estar, para no recorrer todo el texto
+    size_t end = text.substr(position + 1, MAX_ENTITY_LENGTH + 1).find(';');
+    if (end == string_view::npos || end == 0)
+        return 0;
+
+    string_view name = text.substr(position + 1, end);
+    size_t length = name.size() + 2;
+
+    if (name[0] != '#')
+    {
+        const HtmlEntity *entitiesEnd = HTML_ENTITIES + sizeof(HTML_ENTITIES) / sizeof(HTML_ENTITIES[0]);
+        const HtmlEntity *entity = lower_bound(HTML_ENTITIES, entitiesEnd, name,
+                                               [](const HtmlEntity &entity, string_view name)
+                                               { return entity.name < name; });
+
+        if (entity == entitiesEnd || entity->name != name)
+            return 0;
+
+        codepoint = entity->codepoint;
+        return length;
+    }
+
+    bool isHexadecimal = name.size() > 1 && (name[1] == 'x' || name[1] == 'X');
+    size_t first = isHexadecimal ? 2 : 1;
+    if (first >= name.size())
+        return 0;
+
+    // Se deja de acumular al pasar el último caracter válido, para no desbordar
+    uint32_t value = 0;
+    for (size_t i = first; i < name.size(); i++)
+    {
+        unsigned char c = (unsigned char)name[i];
+        uint32_t digit;
+
+        if (isdigit(c))
+            digit = c - '0';
+        else if (isHexadecimal && isxdigit(c))
+            digit = tolower(c) - 'a' + 10;
+        else
+            return 0;
+
+        if (value <= 0x10ffff)
+            value = value * (isHexadecimal ? 16 : 10) + digit;
+    }
+
+    bool isValid = value != 0 && value <= 0x10ffff && (value < 0xd800 || value > 0xdfff);
+    codepoint = isValid ? value : REPLACEMENT_CHARACTER;
+
+    return length;
+}
+
+/**
+ * @brief Splits a text in search terms, in lowercase and without accents
+ *
+ * Los términos se separan por los caracteres que no son letras ni dígitos. Se
+ * usa igual al indexar y al buscar, para que "São Paulo" y "sao paulo" den los
+ * mismos términos.
+ *
+ * @param text      UTF-8 text, without HTML entities
+ * @param buffer    where the terms are written
+ * @param terms     the terms, that point to buffer
+ */
+void normalizeTerms(string_view text, string &buffer, vector<string_view> &terms)
+{
+    buffer.clear();
+    terms.clear();
+
+    // Casi todas las palabras son ASCII sin puntuación: un solo término
+    bool isPlainWord = !text.empty();
+    for (size_t i = 0; isPlainWord && i < text.size(); i++)
+        isPlainWord = (unsigned char)text[i] < 0x80 && isWordByte(text[i]);
+
+    if (isPlainWord)
+    {
+        buffer.assign(text);
+        for (auto &c : buffer)
+            c = toLowerAscii(c);
+
+        terms.push_back(buffer);
+        return;
+    }
+
+    // Si no, primero se escriben los términos separados por un espacio
+    size_t i = 0;
+    while (i < text.size())
+    {
+        unsigned char c = (unsigned char)text[i];
+
+        if (c < 0x80)
+        {
+            if (isWordByte(c))
+                buffer += toLowerAscii(c);
+            else if (!buffer.empty() && buffer.back() != ' ')
+                buffer += ' ';
+
+            i++;
+            continue;
+        }
+
+        uint32_t codepoint;
+        size_t length = decodeUtf8(text, i, codepoint);
+
+        i += length ? length : 1;
+
+        if (!length || !isWordCodepoint(codepoint))
+        {
+            if (!buffer.empty() && buffer.back() != ' ')
+                buffer += ' ';
+
+            continue;
+        }
+
+        codepoint = foldCodepoint(codepoint);
+
+        if (codepoint >= LATIN_FOLDING_FIRST && codepoint <= LATIN_FOLDING_LAST &&
+            LATIN_FOLDING[codepoint - LATIN_FOLDING_FIRST])
+            buffer += LATIN_FOLDING[codepoint - LATIN_FOLDING_FIRST];
+        else if (codepoint)
+        {
+            char encoded[4];
+            buffer.append(encoded, encodeUtf8(codepoint, encoded));
+        }
+    }
+
+    // Después se apuntan, cuando el buffer ya no cambia
+    size_t start = 0;
+    while (start < buffer.size())
+    {
+        size_t end = buffer.find(' ', start);
+        if (end == string::npos)
+            end = buffer.size();
+
+        if (end > start)
+            terms.push_back(string_view(buffer).substr(start, end - start));
+
+        start = end + 1;
+    }
+}
+
+/**
+ * @brief Like tolower(), without depending on the locale
+ *
+ */
+static char toLowerAscii(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c + 'a' - 'A') : c;
+}
+
+/**
+ * @brief Lowercase and without accents, for the alphabets that are not in
+ *        LATIN_FOLDING
+ *
+ * @param codepoint
+ * @return uint32_t     0 for the accents that come as separate characters
+ */
+static uint32_t foldCodepoint(uint32_t codepoint)
+{
+    // Acentos combinables, que se escriben después de la letra
+    if (codepoint >= 0x300 && codepoint <= 0x36f)
+        return 0;
+
+    switch (codepoint)
+    {
+    case 0xaa:      // ª
+        return 'a';
+    case 0xb5:      // µ
+        return 0x3bc;
+    case 0xba:      // º
+        return 'o';
+
+    // Griego con tonos
+    case 0x386:
+    case 0x3ac:
+        return 0x3b1;
+    case 0x388:
+    case 0x3ad:
+        return 0x3b5;
+    case 0x389:
+    case 0x3ae:
+        return 0x3b7;
+    case 0x38a:
+    case 0x3af:
+    case 0x3ca:
+    case 0x390:
+        return 0x3b9;
+    case 0x38c:
+    case 0x3cc:
+        return 0x3bf;
+    case 0x38e:
+    case 0x3cd:
+    case 0x3cb:
+    case 0x3b0:
+        return 0x3c5;
+    case 0x38f:
+    case 0x3ce:
+        return 0x3c9;
+    case 0x3c2:     // sigma final
+        return 0x3c3;
+
+    // Cirílico: ё
+    case 0x401:
+    case 0x451:
+        return 0x435;
+    }
+
+    // Mayúsculas griegas y cirílicas
+    if (codepoint >= 0x391 && codepoint <= 0x3a9)
+        return codepoint + 0x20;
+    if (codepoint >= 0x410 && codepoint <= 0x42f)
+        return codepoint + 0x20;
+    if (codepoint >= 0x400 && codepoint <= 0x40f)
+        return codepoint + 0x50;
+
+    return codepoint;
+}
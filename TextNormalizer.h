@@ -0,0 +1,45 @@
+/**
+ * @file TextNormalizer.h
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief Splits text in search terms and folds case and accents
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#ifndef TEXTNORMALIZER_H
+#define TEXTNORMALIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Determines if a byte can be part of a word. The bytes of multibyte
+ *        UTF-8 characters always can; isWordCodepoint() decides later
+ *
+ * Es inline porque el tokenizador la llama para cada byte de cada página.
+ *
+ * @param c
+ * @return true if c is an ASCII letter or digit, or is not ASCII
+ */
+inline bool isWordByte(char c)
+{
+    unsigned char byte = (unsigned char)c;
+
+    return byte >= 0x80 || (byte >= '0' && byte <= '9') || ((byte | 0x20) >= 'a' && (byte | 0x20) <= 'z');
+}
+
+bool isWordCodepoint(uint32_t codepoint);
+
+size_t encodeUtf8(uint32_t codepoint, char *output);
+size_t decodeUtf8(std::string_view text, size_t position, uint32_t &codepoint);
+size_t decodeHtmlEntity(std::string_view text, size_t position, uint32_t &codepoint);
+
+void normalizeTerms(std::string_view text, std::string &buffer,
+                    std::vector<std::string_view> &terms);
+
+#endif
@@ -8,7 +8,10 @@
  *
  */
 
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <thread>
 
 #include <microhttpd.h>
 
@@ -23,31 +26,94 @@ int main(int argc, const char *argv[])
     CommandLineParser parser(argc, argv);
 
     // Configuration
-    int port = 8000;
+    HttpServerOptions serverOptions;
+    serverOptions.port = 8000;
+    serverOptions.threadCount = thread::hardware_concurrency();
+    serverOptions.connectionLimit = 1000;
+    serverOptions.connectionTimeout = 30;
+
     string homePath = "www";
+    unsigned int fileCacheMegabytes = 64;
+
+    SearchIndexOptions indexOptions;
+    indexOptions.threadCount = thread::hardware_concurrency();
+    indexOptions.codec = POSTING_CODEC_VARINT;
+    indexOptions.storePositions = false;
 
     // Parse command line
     if (parser.hasOption("--help"))
     {
         cout << "edahttpd 0.1" << endl
              << endl;
-        cout << "Usage: edahttpd [-p PORT] [-h HOME_PATH]" << endl;
+        cout << "Usage: edahttpd [-p PORT] [-h HOME_PATH] [-j THREADS] [-c raw|varint|bitpack]" << endl
+             << "                [-t THREADS] [--max-connections N] [--timeout SECONDS]" << endl
+             << "                [--file-cache MEGABYTES] [--watch] [--positions]" << endl
+             << endl;
+        cout << "  -j       threads that build the index" << endl;
+        cout << "  -t       threads that serve requests" << endl;
+        cout << "  --watch  update the index when pages change" << endl;
+        cout << "  --positions  store word positions, for \"phrases\" and NEAR/k" << endl;
 
         return 0;
     }
 
-    if (parser.hasOption("-p"))
-        port = stoi(parser.getOption("-p"));
+    const char *numberOptions[] = {"-p", "-j", "-t", "--max-connections", "--timeout", "--file-cache"};
+    unsigned int *numberValues[] = {&serverOptions.port,
+                                    &indexOptions.threadCount,
+                                    &serverOptions.threadCount,
+                                    &serverOptions.connectionLimit,
+                                    &serverOptions.connectionTimeout,
+                                    &fileCacheMegabytes};
+
+    for (size_t i = 0; i < size(numberOptions); i++)
+    {
+        if (!parser.getNumberOption(numberOptions[i], *numberValues[i]))
+        {
+            cout << "Invalid value for " << numberOptions[i] << ": "
+                 << parser.getOption(numberOptions[i]) << endl;
+
+            return 1;
+        }
+    }
 
     if (parser.hasOption("-h"))
         homePath = parser.getOption("-h");
 
-    // Start server
-    HttpServer server(port);
+    if (parser.hasOption("--positions"))
+        indexOptions.storePositions = true;
+
+    if (indexOptions.threadCount < 1)
+        indexOptions.threadCount = 1;
 
-    EDAoogleHttpRequestHandler edaOogleHttpRequestHandler(homePath);
+    if (serverOptions.threadCount < 1)
+        serverOptions.threadCount = 1;
+
+    if (serverOptions.port < 1 || serverOptions.port > UINT16_MAX)
+    {
+        cout << "Invalid port: " << serverOptions.port << endl;
+
+        return 1;
+    }
+
+    if (parser.hasOption("-c") &&
+        !parsePostingCodec(parser.getOption("-c"), indexOptions.codec))
+    {
+        cout << "Unknown codec: " << parser.getOption("-c") << endl;
+
+        return 1;
+    }
+
+    // El índice se arma antes de aceptar conexiones
+    EDAoogleHttpRequestHandler edaOogleHttpRequestHandler(homePath, indexOptions,
+                                                          (size_t)fileCacheMegabytes << 20);
+
+    // Start server
+    HttpServer server(serverOptions);
     server.setHttpRequestHandler(&edaOogleHttpRequestHandler);
 
+    if (parser.hasOption("--watch") && !edaOogleHttpRequestHandler.watchPages())
+        cout << "Could not watch " << homePath << "/wiki" << endl;
+
     if (server.isRunning())
     {
         cout << "Running server..." << endl;
@@ -0,0 +1,563 @@
+/**
+ * @file main_bench.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief EDAoogle benchmarks
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "CommandLineParser.h"
+#include "HtmlTokenizer.h"
+#include "MappedFile.h"
+#include "SearchIndex.h"
+#include "TextNormalizer.h"
+
+using namespace std;
+
+// Siempre la misma semilla, para que las búsquedas sean las mismas en cada
+// commit y los resultados se puedan comparar
+static const uint32_t QUERY_SEED = 2022;
+
+// Un término en más de una página de cada tantas es una stopword
+static const uint32_t STOPWORD_RATIO = 10;
+static const size_t STOPWORD_COUNT = 32;
+
+// Lo más corto que se busca con "~": a las palabras cortas casi todo les queda cerca
+static const size_t MIN_FUZZY_LENGTH = 4;
+
+static const size_t RESULTS_PER_QUERY = 10;
+
+// Búsquedas de un tipo, y cuánto tardó cada una
+struct QuerySet
+{
+    string name;
+    SearchMode mode;
+    vector<string> queries;
+    vector<double> latencies;       // en microsegundos
+    size_t matchCount;
+};
+
+// Los términos del índice, para armar las búsquedas
+struct Vocabulary
+{
+    vector<string> terms;                           // en 2 o más páginas, y no stopwords
+    vector<string> stopwords;                       // los más frecuentes primero
+    unordered_map<string, uint32_t> frequencies;    // de todos los términos
+};
+
+typedef chrono::steady_clock BenchClock;
+
+static double getMilliseconds(BenchClock::time_point start, BenchClock::time_point end);
+static void readPages(const vector<filesystem::path> &pageList, vector<string> &pages);
+static void benchmarkTokenizer(const vector<string> &pages, unsigned int passes, ostream &json);
+static void benchmarkBuild(const string &wikiPath, const SearchIndexOptions &options,
+                           unsigned int maxThreads, ostream &json);
+static void benchmarkSaveLoad(const SearchIndex &index, ostream &json);
+static void readVocabulary(const SearchIndex &index, Vocabulary &vocabulary);
+static void makeQuerySets(const Vocabulary &vocabulary, const vector<string> &pages,
+                          size_t queryCount, vector<QuerySet> &querySets);
+static void pickPageTerms(const string &page, const Vocabulary &vocabulary, size_t count,
+                          mt19937 &random, vector<string> &terms);
+static void runQuerySet(const SearchIndex &index, unsigned int passes, QuerySet &querySet);
+static double getPercentile(const vector<double> &sortedValues, double fraction);
+static void writeQuerySet(const QuerySet &querySet, ostream &json);
+
+/**
+ * @brief Measures the tokenizer, the index and the searches over the pages of
+ *        the wiki, and writes the results as JSON
+ *
+ * Las búsquedas se arman con el vocabulario de las mismas páginas: términos
+ * sueltos, varios términos de una misma página (para que tengan resultados),
+ * los términos más frecuentes, palabras con "~" y búsquedas con operadores.
+ *
+ */
+int main(int argc, const char *argv[])
+{
+    CommandLineParser parser(argc, argv);
+
+    string homePath = "www";
+    string outputPath;
+    unsigned int maxThreads = thread::hardware_concurrency();
+    unsigned int queryCount = 1000;
+    unsigned int passes = 3;
+
+    SearchIndexOptions options;
+    options.threadCount = 1;
+    options.codec = POSTING_CODEC_VARINT;
+    options.storePositions = false;
+
+    if (parser.hasOption("--help"))
+    {
+        cout << "edaoogle_bench 0.1" << endl
+             << endl;
+        cout << "Usage: edaoogle_bench [-h HOME_PATH] [-o FILE] [-j THREADS] [-n QUERIES]" << endl
+             << "                      [-r PASSES] [-c raw|varint|bitpack] [--positions]" << endl
+             << endl;
+        cout << "  -o       write the JSON results to FILE instead of the console" << endl;
+        cout << "  -j       most threads to build the index with" << endl;
+        cout << "  -n       searches of each kind" << endl;
+        cout << "  -r       times each search is run" << endl;
+
+        return 0;
+    }
+
+    const char *numberOptions[] = {"-j", "-n", "-r"};
+    unsigned int *numberValues[] = {&maxThreads, &queryCount, &passes};
+
+    for (size_t i = 0; i < size(numberOptions); i++)
+    {
+        if (!parser.getNumberOption(numberOptions[i], *numberValues[i]))
+        {
+            cout << "Invalid value for " << numberOptions[i] << ": "
+                 << parser.getOption(numberOptions[i]) << endl;
+
+            return 1;
+        }
+    }
+
+    if (parser.hasOption("-h"))
+        homePath = parser.getOption("-h");
+
+    if (parser.hasOption("-o"))
+        outputPath = parser.getOption("-o");
+
+    if (parser.hasOption("--positions"))
+        options.storePositions = true;
+
+    if (parser.hasOption("-c") &&
+        !parsePostingCodec(parser.getOption("-c"), options.codec))
+    {
+        cout << "Unknown codec: " << parser.getOption("-c") << endl;
+
+        return 1;
+    }
+
+    maxThreads = max(maxThreads, 1U);
+    passes = max(passes, 1U);
+
+    string wikiPath = homePath + "/wiki";
+    vector<filesystem::path> pageList = listPages(wikiPath);
+    if (pageList.empty())
+    {
+        cout << "No pages in " << wikiPath << endl;
+
+        return 1;
+    }
+
+    vector<string> pages;
+    readPages(pageList, pages);
+
+    size_t pageBytes = 0;
+    for (auto &page : pages)
+        pageBytes += page.size();
+
+    ostringstream json;
+    json << "{\n";
+    json << "  \"pages\": " << pages.size() << ",\n";
+    json << "  \"pageBytes\": " << pageBytes << ",\n";
+    json << "  \"codec\": \"" << getPostingCodecName(options.codec) << "\",\n";
+    json << "  \"positions\": " << (options.storePositions ? "true" : "false") << ",\n";
+
+    cerr << "Tokenizer..." << endl;
+    benchmarkTokenizer(pages, passes, json);
+
+    cerr << "Index build..." << endl;
+    benchmarkBuild(wikiPath, options, maxThreads, json);
+
+    SearchIndex index;
+    options.threadCount = maxThreads;
+    index.build(wikiPath, options);
+
+    json << "  \"terms\": " << index.getTermCount() << ",\n";
+    json << "  \"postingBytes\": " << index.getPostingBytes() << ",\n";
+
+    cerr << "Index save and load..." << endl;
+    benchmarkSaveLoad(index, json);
+
+    Vocabulary vocabulary;
+    readVocabulary(index, vocabulary);
+
+    vector<QuerySet> querySets;
+    makeQuerySets(vocabulary, pages, queryCount, querySets);
+
+    json << "  \"passes\": " << passes << ",\n";
+    json << "  \"queries\": {\n";
+    for (size_t i = 0; i < querySets.size(); i++)
+    {
+        cerr << "Searches: " << querySets[i].name << "..." << endl;
+        runQuerySet(index, passes, querySets[i]);
+
+        writeQuerySet(querySets[i], json);
+        json << ((i + 1 < querySets.size()) ? ",\n" : "\n");
+    }
+    json << "  }\n";
+    json << "}\n";
+
+    if (outputPath.empty())
+        cout << json.str();
+    else if (!(ofstream(outputPath) << json.str()))
+    {
+        cout << "Could not write " << outputPath << endl;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+static double getMilliseconds(BenchClock::time_point start, BenchClock::time_point end)
+{
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+static void readPages(const vector<filesystem::path> &pageList, vector<string> &pages)
+{
+    for (auto &pagePath : pageList)
+    {
+        MappedFile file;
+        if (file.open(pagePath.string()))
+            pages.emplace_back(file.getData(), file.getSize());
+    }
+}
+
+/**
+ * @brief Splits every page in normalized terms, as the index does, without
+ *        reading from disk. Se toma la pasada más rápida
+ *
+ * @param pages
+ * @param passes
+ * @param json
+ */
+static void benchmarkTokenizer(const vector<string> &pages, unsigned int passes, ostream &json)
+{
+    double bestTime = INFINITY;
+    size_t termCount = 0;
+
+    string normalizedToken;
+    vector<string_view> terms;
+
+    for (unsigned int pass = 0; pass < passes; pass++)
+    {
+        termCount = 0;
+
+        auto t1 = BenchClock::now();
+        for (auto &page : pages)
+        {
+            HtmlTokenizer tokenizer(page);
+            string_view token;
+            while (tokenizer.next(token))
+            {
+                normalizeTerms(token, normalizedToken, terms);
+                termCount += terms.size();
+            }
+        }
+        auto t2 = BenchClock::now();
+
+        bestTime = min(bestTime, getMilliseconds(t1, t2));
+    }
+
+    size_t pageBytes = 0;
+    for (auto &page : pages)
+        pageBytes += page.size();
+
+    json << "  \"tokenizer\": {\"terms\": " << termCount
+         << ", \"milliseconds\": " << bestTime
+         << ", \"megabytesPerSecond\": " << pageBytes / 1e6 / (bestTime / 1000)
+         << ", \"termsPerSecond\": " << termCount / (bestTime / 1000) << "},\n";
+}
+
+/**
+ * @brief Builds the index with 1, 2, 4... threads, up to maxThreads. Las
+ *        páginas ya están en el cache del sistema operativo
+ *
+ * @param wikiPath
+ * @param options
+ * @param maxThreads
+ * @param json
+ */
+static void benchmarkBuild(const string &wikiPath, const SearchIndexOptions &options,
+                           unsigned int maxThreads, ostream &json)
+{
+    vector<unsigned int> threadCounts;
+    for (unsigned int threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+        threadCounts.push_back(threadCount);
+    threadCounts.push_back(maxThreads);
+
+    json << "  \"build\": [";
+
+    for (size_t i = 0; i < threadCounts.size(); i++)
+    {
+        SearchIndexOptions buildOptions = options;
+        buildOptions.threadCount = threadCounts[i];
+
+        SearchIndex index;
+        auto t1 = BenchClock::now();
+        size_t pageCount = index.build(wikiPath, buildOptions);
+        auto t2 = BenchClock::now();
+
+        double buildTime = getMilliseconds(t1, t2);
+
+        json << (i ? ", " : "") << "{\"threads\": " << threadCounts[i]
+             << ", \"milliseconds\": " << buildTime
+             << ", \"pagesPerSecond\": " << pageCount / (buildTime / 1000) << "}";
+    }
+
+    json << "],\n";
+}
+
+/**
+ * @brief Saves the index to a temporary file and maps it again
+ *
+ * @param index
+ * @param json
+ */
+static void benchmarkSaveLoad(const SearchIndex &index, ostream &json)
+{
+    string filename = (filesystem::temp_directory_path() / "edaoogle_bench.bin").string();
+
+    auto t1 = BenchClock::now();
+    bool isSaved = index.save(filename);
+    auto t2 = BenchClock::now();
+
+    SearchIndex loaded;
+    bool isLoaded = isSaved && loaded.load(filename);
+    auto t3 = BenchClock::now();
+
+    error_code error;
+    uintmax_t fileSize = filesystem::file_size(filename, error);
+
+    loaded.clear();
+    filesystem::remove(filename, error);
+
+    if (!isLoaded)
+        cout << "Could not save and load " << filename << endl;
+
+    json << "  \"saveLoad\": {\"fileBytes\": " << (error ? 0 : fileSize)
+         << ", \"saveMilliseconds\": " << getMilliseconds(t1, t2)
+         << ", \"loadMilliseconds\": " << getMilliseconds(t2, t3) << "},\n";
+}
+
+/**
+ * @brief Reads the terms of the index with their frequencies
+ *
+ * @param index
+ * @param vocabulary
+ */
+static void readVocabulary(const SearchIndex &index, Vocabulary &vocabulary)
+{
+    uint32_t stopwordFrequency = (uint32_t)(index.getDocumentCount() / STOPWORD_RATIO);
+
+    vector<pair<uint32_t, string>> stopwords;
+
+    for (TermCursor cursor(index); !cursor.isAtEnd(); cursor.next())
+    {
+        string term(cursor.getText());
+        uint32_t documentFrequency = cursor.getEntry().documentFrequency;
+
+        vocabulary.frequencies[term] = documentFrequency;
+
+        if (documentFrequency > stopwordFrequency)
+            stopwords.push_back({documentFrequency, term});
+        else if (documentFrequency >= 2)
+            vocabulary.terms.push_back(term);
+    }
+
+    sort(stopwords.begin(), stopwords.end(), greater<pair<uint32_t, string>>());
+    stopwords.resize(min(stopwords.size(), STOPWORD_COUNT));
+
+    for (auto &stopword : stopwords)
+        vocabulary.stopwords.push_back(stopword.second);
+}
+
+/**
+ * @brief Makes the searches of each kind
+ *
+ * @param vocabulary
+ * @param pages
+ * @param queryCount    of each kind
+ * @param querySets
+ */
+static void makeQuerySets(const Vocabulary &vocabulary, const vector<string> &pages,
+                          size_t queryCount, vector<QuerySet> &querySets)
+{
+    mt19937 random(QUERY_SEED);
+
+    auto pickTerm = [&](const vector<string> &terms) -> const string &
+    { return terms[uniform_int_distribution<size_t>(0, terms.size() - 1)(random)]; };
+
+    auto pickPage = [&]() -> const string &
+    { return pages[uniform_int_distribution<size_t>(0, pages.size() - 1)(random)]; };
+
+    auto join = [](const vector<string> &terms)
+    {
+        string query;
+        for (auto &term : terms)
+            query += (query.empty() ? "" : " ") + term;
+        return query;
+    };
+
+    QuerySet single = {"single", SEARCH_ALL_WORDS, {}, {}, 0};
+    QuerySet multi = {"multi", SEARCH_ALL_WORDS, {}, {}, 0};
+    QuerySet multiAny = {"multiAny", SEARCH_ANY_WORD, {}, {}, 0};
+    QuerySet stopword = {"stopword", SEARCH_ALL_WORDS, {}, {}, 0};
+    QuerySet stopwordAny = {"stopwordAny", SEARCH_ANY_WORD, {}, {}, 0};
+    QuerySet fuzzy = {"fuzzy", SEARCH_ALL_WORDS, {}, {}, 0};
+    QuerySet boolean = {"boolean", SEARCH_ALL_WORDS, {}, {}, 0};
+
+    vector<string> terms;
+
+    for (size_t i = 0; i < queryCount && !vocabulary.terms.empty(); i++)
+    {
+        single.queries.push_back(pickTerm(vocabulary.terms));
+
+        // Términos de una misma página, para que las búsquedas tengan resultados
+        pickPageTerms(pickPage(), vocabulary, 2 + i % 2, random, terms);
+        multi.queries.push_back(join(terms));
+        multiAny.queries.push_back(join(terms));
+
+        // Si la página tiene pocos términos, la resta se busca igual
+        if (terms.size() >= 2)
+            boolean.queries.push_back((i % 2) ? "(" + terms[0] + " OR " + terms[1] + ") -" + pickTerm(vocabulary.terms)
+                                              : terms[0] + " -" + terms[1]);
+
+        string fuzzyTerm;
+        do
+            fuzzyTerm = pickTerm(vocabulary.terms);
+        while (fuzzyTerm.size() < MIN_FUZZY_LENGTH);
+        fuzzy.queries.push_back(fuzzyTerm + "~");
+    }
+
+    for (size_t i = 0; i < queryCount && !vocabulary.stopwords.empty(); i++)
+    {
+        terms.clear();
+        for (size_t j = 0; j <= i % 3; j++)
+            terms.push_back(pickTerm(vocabulary.stopwords));
+
+        stopword.queries.push_back(join(terms));
+        stopwordAny.queries.push_back(join(terms));
+    }
+
+    querySets = {single, multi, multiAny, stopword, stopwordAny, fuzzy, boolean};
+}
+
+/**
+ * @brief Picks distinct terms of a page that are neither rare nor stopwords
+ *
+ * @param page
+ * @param vocabulary
+ * @param count         most terms to pick
+ * @param random
+ * @param terms
+ */
+static void pickPageTerms(const string &page, const Vocabulary &vocabulary, size_t count,
+                          mt19937 &random, vector<string> &terms)
+{
+    vector<string> pageTerms;
+
+    string normalizedToken;
+    vector<string_view> tokenTerms;
+
+    HtmlTokenizer tokenizer(page);
+    string_view token;
+    while (tokenizer.next(token))
+    {
+        normalizeTerms(token, normalizedToken, tokenTerms);
+        for (auto term : tokenTerms)
+        {
+            auto frequency = vocabulary.frequencies.find(string(term));
+            if (frequency != vocabulary.frequencies.end() && frequency->second >= 2 &&
+                find(vocabulary.stopwords.begin(), vocabulary.stopwords.end(), term) == vocabulary.stopwords.end())
+                pageTerms.emplace_back(term);
+        }
+    }
+
+    sort(pageTerms.begin(), pageTerms.end());
+    pageTerms.erase(unique(pageTerms.begin(), pageTerms.end()), pageTerms.end());
+    shuffle(pageTerms.begin(), pageTerms.end(), random);
+
+    terms.assign(pageTerms.begin(), pageTerms.begin() + min(count, pageTerms.size()));
+}
+
+/**
+ * @brief Runs every search once without measuring it, and then passes times
+ *
+ * @param index
+ * @param passes
+ * @param querySet
+ */
+static void runQuerySet(const SearchIndex &index, unsigned int passes, QuerySet &querySet)
+{
+    vector<SearchResult> results;
+
+    querySet.matchCount = 0;
+    for (auto &query : querySet.queries)
+        querySet.matchCount += index.search(query, querySet.mode, 0, RESULTS_PER_QUERY, results);
+
+    for (unsigned int pass = 0; pass < passes; pass++)
+    {
+        for (auto &query : querySet.queries)
+        {
+            auto t1 = BenchClock::now();
+            index.search(query, querySet.mode, 0, RESULTS_PER_QUERY, results);
+            auto t2 = BenchClock::now();
+
+            querySet.latencies.push_back(getMilliseconds(t1, t2) * 1000);
+        }
+    }
+
+    sort(querySet.latencies.begin(), querySet.latencies.end());
+}
+
+/**
+ * @brief The value that is above that fraction of the values
+ *
+ * @param sortedValues
+ * @param fraction
+ * @return double
+ */
+static double getPercentile(const vector<double> &sortedValues, double fraction)
+{
+    if (sortedValues.empty())
+        return 0;
+
+    size_t rank = (size_t)ceil(fraction * sortedValues.size());
+
+    return sortedValues[min(max(rank, (size_t)1), sortedValues.size()) - 1];
+}
+
+static void writeQuerySet(const QuerySet &querySet, ostream &json)
+{
+    double totalLatency = 0;
+    for (auto latency : querySet.latencies)
+        totalLatency += latency;
+
+    double meanLatency = querySet.latencies.empty() ? 0 : totalLatency / querySet.latencies.size();
+
+    json << "    \"" << querySet.name << "\": {\"queries\": " << querySet.queries.size()
+         << ", \"mode\": \"" << (querySet.mode == SEARCH_ALL_WORDS ? "and" : "or") << "\""
+         << ", \"averageMatches\": "
+         << (querySet.queries.empty() ? 0 : (double)querySet.matchCount / querySet.queries.size())
+         << ", \"meanMicroseconds\": " << meanLatency
+         << ", \"p50Microseconds\": " << getPercentile(querySet.latencies, 0.5)
+         << ", \"p99Microseconds\": " << getPercentile(querySet.latencies, 0.99)
+         << ", \"p999Microseconds\": " << getPercentile(querySet.latencies, 0.999)
+         << ", \"maxMicroseconds\": " << (querySet.latencies.empty() ? 0 : querySet.latencies.back())
+         << "}";
+}
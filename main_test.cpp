@@ -1,5 +1,1382 @@
+/**
+ * @file main_test.cpp
+ * @authors Heir Alejandro, Hertter José, Vieira Valentín
+ * @brief EDAoogle tests
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <map>
+#include <random>
+#include <thread>
+
+#include "FileCache.h"
+#include "HtmlTokenizer.h"
+#include "LevenshteinAutomaton.h"
+#include "QueryCache.h"
+#include "SearchIndex.h"
+#include "SegmentedIndex.h"
+#include "ServerMetrics.h"
+#include "ServeHttpRequestHandler.h"
+#include "TextNormalizer.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const string &message)
+{
+    if (!condition)
+    {
+        cout << "FAIL: " << message << endl;
+        failures++;
+    }
+}
+
+/**
+ * @brief Writes a few small pages to index
+ *
+ * @param wikiPath
+ */
+static void writeFixture(const filesystem::path &wikiPath)
+{
+    filesystem::remove_all(wikiPath);
+    filesystem::create_directories(wikiPath);
+
+    ofstream(wikiPath / "Agua.html") << "<html><head><title>Agua</title></head>\n"
+                                        "<body><p>El agua es una sustancia.</p></body></html>\n";
+    ofstream(wikiPath / "Golfo.html") << "<html><head><title>Golfo</title></head>\n"
+                                         "<body><p>La guerra del golfo.</p></body></html>\n";
+    ofstream(wikiPath / "Guerra.html") << "<html><head><title>Guerra</title></head>\n"
+                                          "<body><p>Una guerra es un conflicto; el agua también.</p></body></html>\n";
+}
+
+/**
+ * @brief Tags, comments, scripts and styles are skipped even across lines, and
+ *        entities stay inside their word
+ *
+ */
+static void testHtmlTokenizer()
+{
+    string html = "<html><head><title>Am&#233;rica</title>\n"
+                  "<style>\np { color: red; }\n</style>\n"
+                  "<script type=\"text/javascript\">if (a < b) { oculto(); }</SCRIPT></head>\n"
+                  "<body><p class=\"x\"\ndata-y='a > b'>Hola, navegaci&#243;n</p>\n"
+                  "<!-- comentario\n de varias l\u00edneas -->fin&#160;1 < 2 &amp; caf&eacute;&#x21;</body></html>";
+
+    HtmlTokenizer tokenizer(html);
+
+    vector<string> tokens;
+    string_view token;
+    while (tokenizer.next(token))
+        tokens.push_back(string(token));
+
+    vector<string> expected = {"Am\u00e9rica", "Hola", "navegaci\u00f3n", "fin", "1", "2", "caf\u00e9"};
+    check(tokens == expected, "unexpected HTML tokens");
+    check(tokenizer.getTitle() == "Am&#233;rica", "unexpected HTML title");
+}
+
+/**
+ * @brief Terms are split at punctuation, in lowercase and without accents
+ *
+ */
+static void testNormalizeTerms()
+{
+    string buffer;
+    vector<string_view> terms;
+    normalizeTerms("S\u00e3o_Paulo \u00c1RBOL \u00abJos\u00e9\u00bb Stra\u00dfe x\u00b2 Cafe\u0301 \u0391\u0398\u0389\u039d\u0391",
+                   buffer, terms);
+
+    vector<string_view> expected = {"sao", "paulo", "arbol", "jose", "strasse", "x", "cafe",
+                                    "\u03b1\u03b8\u03b7\u03bd\u03b1"};
+    check(terms == expected, "unexpected normalized terms");
+
+    normalizeTerms(" \xff\xfe,. \u2014 ", buffer, terms);
+    check(terms.empty(), "punctuation and invalid UTF-8 should give no terms");
+}
+
+/**
+ * @brief Searching must never modify the index, not even for unknown words
+ *
+ * @param index
+ */
+static void testQueryFloodDoesNotGrowIndex(const SearchIndex &index)
+{
+    size_t termCount = index.getTermCount();
+
+    mt19937 random(7);
+    string query;
+    vector<DocId> results;
+
+    for (int i = 0; i < 100000; i++)
+    {
+        query.clear();
+        int wordCount = 1 + random() % 3;
+        for (int w = 0; w < wordCount; w++)
+        {
+            query += ' ';
+            int wordLength = 1 + random() % 8;
+            for (int c = 0; c < wordLength; c++)
+                query += (char)('a' + random() % 26);
+        }
+
+        index.match(query, results);
+    }
+
+    check(index.getTermCount() == termCount, "query flood changed the term count");
+}
+
+static void testMatch(const SearchIndex &index)
+{
+    vector<DocId> results;
+
+    index.match("agua", results);
+    check(results.size() == 2, "\"agua\" should match 2 pages");
+
+    index.match("Guerra  GOLFO", results);
+    check(results.size() == 1 && index.getDocument(results[0]).path == "/wiki/Golfo.html",
+          "\"Guerra GOLFO\" should match /wiki/Golfo.html");
+
+    index.match("agua inexistente", results);
+    check(results.empty(), "a missing word should match nothing");
+
+    index.match("TAMBI\u00c9N", results);
+    check(results.size() == 1 && index.getDocument(results[0]).path == "/wiki/Guerra.html",
+          "\"TAMBI\u00c9N\" should match /wiki/Guerra.html");
+
+    index.match(" ,.", results);
+    check(results.empty(), "a query without words should match nothing");
+}
+
+/**
+ * @brief Pages that repeat a word rank first, and pages split the same ranking
+ *
+ * @param index
+ */
+static void testSearch(const SearchIndex &index)
+{
+    vector<SearchResult> results;
+
+    // "Agua" tiene agua en el título y en el texto, "Guerra" solo en el texto
+    size_t matchCount = index.search("agua", SEARCH_ALL_WORDS, 0, 10, results);
+    check(matchCount == 2 && results.size() == 2, "\"agua\" should rank 2 pages");
+    check(!results.empty() && index.getDocument(results[0].docId).path == "/wiki/Agua.html",
+          "/wiki/Agua.html should rank first for \"agua\"");
+    check(results.size() == 2 && results[0].score > results[1].score,
+          "results should be sorted by decreasing score");
+
+    vector<SearchResult> firstPage, secondPage;
+    index.search("agua", SEARCH_ALL_WORDS, 0, 1, firstPage);
+    matchCount = index.search("agua", SEARCH_ALL_WORDS, 1, 1, secondPage);
+    check(matchCount == 2 && firstPage.size() == 1 && secondPage.size() == 1 &&
+              firstPage[0].docId == results[0].docId && secondPage[0].docId == results[1].docId,
+          "pages should split the same ranking");
+
+    check(index.search("agua", SEARCH_ALL_WORDS, 2, 10, results) == 2 && results.empty(),
+          "a page past the end should be empty");
+    check(index.search("agua inexistente", SEARCH_ALL_WORDS, 0, 10, results) == 0 && results.empty(),
+          "a missing word should rank nothing");
+
+    // Con cualquiera de las palabras
+    matchCount = index.search("agua golfo inexistente", SEARCH_ANY_WORD, 0, 10, results);
+    check(matchCount == 3 && results.size() == 3, "\"agua golfo\" should rank 3 pages with any word");
+
+    // Block-Max WAND tiene que dar los mismos primeros resultados que puntuar todo
+    for (size_t count = 1; count < results.size(); count++)
+    {
+        vector<SearchResult> bestResults;
+        index.search("agua golfo inexistente", SEARCH_ANY_WORD, 0, count, bestResults);
+
+        bool samePrefix = bestResults.size() == count;
+        for (size_t i = 0; samePrefix && i < count; i++)
+            samePrefix = bestResults[i].docId == results[i].docId;
+        check(samePrefix, "the best " + to_string(count) + " results should not change with any word");
+    }
+}
+
+/**
+ * @brief Streamed matches must be the same as the matches found at once, in
+ *        the same order, however they are split in chunks
+ *
+ * @param index
+ */
+static void testMatchStream(const SearchIndex &index)
+{
+    for (string searchString : {"agua", "agua golfo", "golfo guerra", "agua inexistente"})
+    {
+        vector<DocId> expected;
+        index.match(searchString, expected);
+
+        for (size_t chunkSize : {1, 2, 64})
+        {
+            PostingStream matches;
+            index.openMatches(searchString, SEARCH_ALL_WORDS, matches);
+
+            vector<DocId> streamed(chunkSize);
+            vector<DocId> results;
+            while (size_t count = matches.next(streamed.data(), chunkSize))
+                results.insert(results.end(), streamed.begin(), streamed.begin() + count);
+
+            check(results == expected, "streamed matches for \"" + searchString + "\" should not change");
+        }
+    }
+
+    PostingStream matches;
+    index.openMatches("agua golfo inexistente", SEARCH_ANY_WORD, matches);
+
+    DocId docIds[16];
+    size_t count = matches.next(docIds, 16);
+    check(count == 3 && docIds[0] < docIds[1] && docIds[1] < docIds[2] && !matches.next(docIds, 16),
+          "streamed matches with any word should be each page once, in order");
+}
+
+/**
+ * @brief The server answers from several threads at once, so concurrent
+ *        searches must give the same results as one at a time
+ *
+ * @param index
+ */
+static void testConcurrentSearch(const SearchIndex &index)
+{
+    const vector<string> searchStrings = {"agua", "agua golfo", "golfo guerra", "inexistente"};
+
+    vector<vector<SearchResult>> expected(searchStrings.size() * 2);
+    for (size_t i = 0; i < expected.size(); i++)
+        index.search(searchStrings[i / 2], (SearchMode)(i % 2), 0, 10, expected[i]);
+
+    atomic<int> mismatches(0);
+
+    vector<thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&, t]()
+                             {
+                                 vector<SearchResult> results;
+                                 for (size_t j = 0; j < 500; j++)
+                                 {
+                                     size_t i = (j + t) % expected.size();
+                                     index.search(searchStrings[i / 2], (SearchMode)(i % 2), 0, 10, results);
+
+                                     bool isSame = results.size() == expected[i].size();
+                                     for (size_t k = 0; isSame && k < results.size(); k++)
+                                         isSame = results[k].docId == expected[i][k].docId &&
+                                                  results[k].score == expected[i][k].score;
+                                     if (!isSame)
+                                         mismatches++;
+                                 } });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    check(!mismatches, "concurrent searches should match serial searches");
+}
+
+/**
+ * @brief A saved index must load back identical, and be rejected when the
+ *        file is corrupt or the pages changed
+ *
+ * @param index
+ * @param wikiPath
+ */
+static void testSaveLoad(const SearchIndex &index, const filesystem::path &wikiPath)
+{
+    auto filename = (wikiPath.parent_path() / "searchIndex.bin").string();
+    check(index.save(filename), "save failed");
+
+    SearchIndex loaded;
+    check(loaded.load(filename, wikiPath.string()), "load failed");
+    check(loaded.getTermCount() == index.getTermCount() &&
+              loaded.getDocumentCount() == index.getDocumentCount(),
+          "loaded index has a different size");
+
+    vector<DocId> expected, results;
+    for (auto query : {"agua", "guerra golfo", "el", "conflicto"})
+    {
+        index.match(query, expected);
+        loaded.match(query, results);
+        check(expected == results, string("loaded index differs for \"") + query + "\"");
+    }
+
+    for (DocId docId = 0; docId < index.getDocumentCount(); docId++)
+        check(index.getDocument(docId).path == loaded.getDocument(docId).path &&
+                  index.getDocument(docId).title == loaded.getDocument(docId).title,
+              "loaded document table differs");
+    loaded.clear();
+
+    // Un byte cambiado en las posting lists
+    fstream file(filename, ios::in | ios::out | ios::binary);
+    file.seekg(-1, ios::end);
+    char lastByte = (char)file.get();
+    file.seekp(-1, ios::end);
+    file.put(lastByte ^ 0x55);
+    file.close();
+    check(!loaded.load(filename, wikiPath.string()), "corrupt index was loaded");
+
+    // Una página nueva
+    index.save(filename);
+    ofstream(wikiPath / "Nueva.html") << "<html><body>nueva</body></html>\n";
+    check(!loaded.load(filename, wikiPath.string()), "stale index was loaded");
+    filesystem::remove(wikiPath / "Nueva.html");
+}
+
+/**
+ * @brief Searches with the same words share their cached results, until the
+ *        cache is invalidated
+ *
+ */
+static void testIncrementalBuild(const SearchIndex &index, const filesystem::path &wikiPath,
+                                 const SearchIndexOptions &options)
+{
+    // Una página cambiada, una nueva y una borrada
+    ofstream(wikiPath / "Golfo.html") << "<html><head><title>Golfo</title></head>\n"
+                                         "<body><p>El golfo de San Jorge.</p></body></html>\n";
+    ofstream(wikiPath / "Nueva.html") << "<html><head><title>Nueva</title></head>\n"
+                                         "<body><p>Una guerra nueva.</p></body></html>\n";
+    filesystem::remove(wikiPath / "Agua.html");
+
+    check(!index.isUpToDate(wikiPath.string()), "changed pages were not detected");
+
+    SearchIndex updated;
+    size_t readCount = updated.build(wikiPath.string(), options, &index);
+    check(readCount == 2, "incremental build read " + to_string(readCount) + " pages instead of 2");
+    check(updated.isUpToDate(wikiPath.string()), "incremental build is not up to date");
+
+    SearchIndex rebuilt;
+    rebuilt.build(wikiPath.string(), options);
+
+    check(updated.getDocumentCount() == rebuilt.getDocumentCount() &&
+              updated.getTermCount() == rebuilt.getTermCount(),
+          "incremental build has a different size");
+
+    for (DocId docId = 0; docId < rebuilt.getDocumentCount(); docId++)
+        check(updated.getDocument(docId).path == rebuilt.getDocument(docId).path &&
+                  updated.getDocument(docId).title == rebuilt.getDocument(docId).title &&
+                  updated.getDocument(docId).length == rebuilt.getDocument(docId).length,
+              "incremental build has a different document table");
+
+    vector<SearchResult> expected, results;
+    for (auto query : {"guerra", "golfo", "el agua", "sustancia", "nueva", "jorge"})
+    {
+        rebuilt.search(query, SEARCH_ANY_WORD, 0, 10, expected);
+        updated.search(query, SEARCH_ANY_WORD, 0, 10, results);
+
+        bool isEqual = expected.size() == results.size();
+        for (size_t i = 0; isEqual && i < results.size(); i++)
+            isEqual = expected[i].docId == results[i].docId && expected[i].score == results[i].score;
+        check(isEqual, string("incremental build differs for \"") + query + "\"");
+    }
+}
+
+/**
+ * @brief A segmented index must find the same pages, with the same scores, as
+ *        an index of the current pages built from scratch
+ *
+ * @param segmented
+ * @param wikiPath
+ * @param options
+ * @param label     for the failure messages
+ */
+static void checkSegmentedIndex(const SegmentedIndex &segmented, const filesystem::path &wikiPath,
+                                const SearchIndexOptions &options, const string &label)
+{
+    SearchIndex rebuilt;
+    rebuilt.build(wikiPath.string(), options);
+
+    shared_ptr<const IndexSnapshot> snapshot = segmented.getSnapshot();
+    check(snapshot->getDocumentCount() == rebuilt.getDocumentCount(),
+          label + ": segmented index has a different number of pages");
+
+    vector<SearchResult> expected, results;
+    for (auto query : {"guerra", "golfo", "el agua", "sustancia", "nueva", "jorge", "una guerra"})
+    {
+        for (auto mode : {SEARCH_ALL_WORDS, SEARCH_ANY_WORD})
+        {
+            size_t expectedCount = rebuilt.search(query, mode, 0, 100, expected);
+            size_t count = snapshot->search(query, mode, 0, 100, results);
+
+            // Los docIds cambian, y con ellos el orden de los empates; las
+            // páginas y los puntajes no
+            map<string_view, float> expectedScores;
+            for (auto &result : expected)
+                expectedScores[rebuilt.getDocument(result.docId).path] = result.score;
+
+            bool isEqual = count == expectedCount && results.size() == expected.size();
+            for (size_t i = 0; isEqual && i < results.size(); i++)
+            {
+                auto expectedScore = expectedScores.find(snapshot->getDocument(results[i].docId).path);
+                isEqual = expectedScore != expectedScores.end() &&
+                          fabs(results[i].score - expectedScore->second) <= 1e-5F * expectedScore->second;
+            }
+            check(isEqual, label + ": segmented index differs for \"" + query + "\"");
+
+            IndexMatches matches;
+            snapshot->openMatches(query, mode, matches);
+
+            DocId docIds[2];
+            size_t matchCount = 0, found;
+            while ((found = matches.next(docIds, 2)))
+                matchCount += found;
+            check(matchCount == expectedCount, label + ": segmented matches differ for \"" + query + "\"");
+        }
+    }
+}
+
+static void testSegmentedIndex(const filesystem::path &wikiPath, const SearchIndexOptions &options)
+{
+    writeFixture(wikiPath);
+
+    auto indexPath = (wikiPath.parent_path() / "segments").string();
+    filesystem::remove_all(indexPath);
+
+    SegmentedIndex segmented(indexPath, wikiPath.string(), options);
+    check(!segmented.load(), "missing segmented index was loaded");
+
+    segmented.build();
+    check(segmented.getSnapshot()->getSegmentCount() == 1, "build should make one segment");
+    check(segmented.update() == 0, "update without changes changed the index");
+    checkSegmentedIndex(segmented, wikiPath, options, "build");
+
+    // Una página cambiada, una nueva y una borrada
+    shared_ptr<const IndexSnapshot> oldSnapshot = segmented.getSnapshot();
+    ofstream(wikiPath / "Golfo.html") << "<html><head><title>Golfo</title></head>\n"
+                                         "<body><p>El golfo de San Jorge.</p></body></html>\n";
+    ofstream(wikiPath / "Nueva.html") << "<html><head><title>Nueva</title></head>\n"
+                                         "<body><p>Una guerra nueva.</p></body></html>\n";
+    filesystem::remove(wikiPath / "Agua.html");
+
+    check(segmented.update() == 3, "update should find 3 changed pages");
+    check(segmented.getSnapshot()->getSegmentCount() == 2, "update should add one segment");
+    check(oldSnapshot->getDocumentCount() == 3, "old snapshot changed");
+    checkSegmentedIndex(segmented, wikiPath, options, "update");
+
+    // Cada página nueva en su propio segmento, hasta que se mezclan
+    for (int i = 0; i < 4; i++)
+    {
+        ofstream(wikiPath / ("Extra" + to_string(i) + ".html")) << "<html><body>guerra extra " << i
+                                                                << "</body></html>\n";
+        segmented.update();
+    }
+
+    size_t segmentCount = segmented.getSnapshot()->getSegmentCount();
+    segmented.mergeSegments();
+    check(segmented.getSnapshot()->getSegmentCount() < segmentCount, "segments were not merged");
+    checkSegmentedIndex(segmented, wikiPath, options, "merge");
+
+    SegmentedIndex loaded(indexPath, wikiPath.string(), options);
+    check(loaded.load(), "segmented index was not loaded");
+    checkSegmentedIndex(loaded, wikiPath, options, "load");
+
+    // Las búsquedas siguen mientras se actualiza y se mezcla
+    atomic<bool> isUpdating(true);
+    atomic<int> emptySearches(0);
+
+    thread searchThread([&]()
+                        {
+                            vector<SearchResult> results;
+                            while (isUpdating)
+                            {
+                                if (!segmented.getSnapshot()->search("guerra", SEARCH_ALL_WORDS, 0, 10, results))
+                                    emptySearches++;
+                            } });
+
+    segmented.startMerging();
+    for (int i = 4; i < 12; i++)
+    {
+        ofstream(wikiPath / ("Extra" + to_string(i) + ".html")) << "<html><body>guerra extra " << i
+                                                                << "</body></html>\n";
+        segmented.update();
+    }
+    segmented.stopMerging();
+
+    isUpdating = false;
+    searchThread.join();
+
+    check(!emptySearches, "searches failed while the index was updated");
+    checkSegmentedIndex(segmented, wikiPath, options, "background merge");
+}
+
+static void testQueryCache()
+{
+    check(getQueryCacheKey("Agua golfo", SEARCH_ALL_WORDS, 0, 10) ==
+              getQueryCacheKey("golfo AGUA agua", SEARCH_ALL_WORDS, 0, 10),
+          "the order and case of the words should not change the cache key");
+    check(getQueryCacheKey("agua", SEARCH_ALL_WORDS, 0, 10) != getQueryCacheKey("agua", SEARCH_ANY_WORD, 0, 10) &&
+              getQueryCacheKey("agua", SEARCH_ALL_WORDS, 0, 10) != getQueryCacheKey("agua", SEARCH_ALL_WORDS, 10, 10),
+          "the mode and the page should change the cache key");
+    check(getQueryCacheKey("agua -golfo", SEARCH_ALL_WORDS, 0, 10) != getQueryCacheKey("agua golfo", SEARCH_ALL_WORDS, 0, 10) &&
+              getQueryCacheKey("agua OR golfo", SEARCH_ALL_WORDS, 0, 10) != getQueryCacheKey("agua golfo", SEARCH_ALL_WORDS, 0, 10) &&
+              getQueryCacheKey("agua -golfo", SEARCH_ALL_WORDS, 0, 10) != getQueryCacheKey("agua OR golfo", SEARCH_ALL_WORDS, 0, 10),
+          "the operators should change the cache key");
+
+    QueryCache queryCache(4, 2);
+    auto results = make_shared<QueryResults>(QueryResults{1, {{0, 1.0F}}, {}});
+
+    uint64_t generation = queryCache.getGeneration();
+    queryCache.put("agua", generation, results);
+    check(queryCache.get("agua") == results && !queryCache.get("golfo"), "a cached search should be found");
+    check(queryCache.getHitCount() == 1 && queryCache.getMissCount() == 1, "hits and misses should be counted");
+
+    for (int i = 0; i < 10; i++)
+        queryCache.put(to_string(i), generation, results);
+    check(!queryCache.get("agua"), "the least recently used search should be evicted");
+
+    queryCache.invalidate();
+    check(!queryCache.get("9"), "an invalidated search should not be found");
+
+    queryCache.put("agua", generation, results);
+    check(!queryCache.get("agua"), "results from before an invalidation should be dropped");
+}
+
+/**
+ * @brief Static files are cached up to a byte budget, reread when they change,
+ *        and never served from outside the home path
+ *
+ * @param homePath
+ */
+static void testServeFiles(const filesystem::path &homePath)
+{
+    // 80 bytes de cache: entran hasta 8 archivos de 10 bytes
+    FileCache fileCache(80);
+
+    vector<string> paths;
+    for (int i = 0; i < 10; i++)
+    {
+        paths.push_back((homePath / ("file" + to_string(i) + ".txt")).string());
+        ofstream(paths.back()) << "012345678" << i;
+    }
+
+    // En nanosegundos
+    FileContents first = fileCache.get(paths[0], 1000000000, 10);
+    check(first && string(first->begin(), first->end()) == "0123456780", "a file should be read");
+    check(fileCache.get(paths[0], 1000000000, 10) == first, "an unchanged file should come from the cache");
+    check(fileCache.get(paths[0], 1000000001, 10) != first,
+          "a file modified within the same second should be read again");
+
+    for (auto &path : paths)
+        fileCache.get(path, 1, 10);
+    check(fileCache.getSize() == 80, "the cache should not grow past its capacity");
+
+    ServeHttpRequestHandler handler(homePath.string(), 80);
+    HttpResponse response;
+    check(handler.handleRequest("/file1.txt", HttpArguments(), response) &&
+              response.sharedBody && response.sharedBody->size() == 10,
+          "a file in the home path should be served");
+    check(response.statusCode == MHD_HTTP_OK, "a served file should be answered with 200 OK");
+    check(!handler.handleRequest("/../wiki/Agua.html", HttpArguments(), response) &&
+              !handler.handleRequest("/a/../../wiki/Agua.html", HttpArguments(), response),
+          "files outside the home path should not be served");
+}
+
+/**
+ * @brief Quoted phrases need their words together and in order, and NEAR/k
+ *        near; without positions they only need the words
+ *
+ */
+static void testPhraseSearch(const filesystem::path &wikiPath, const SearchIndexOptions &options)
+{
+    SearchQuery query;
+    parseSearchQuery("\"Guerra del\" NEAR/3 golfo", query);
+    check(query.terms.size() == 3 && query.terms[0] == "del" && query.terms[2] == "guerra" &&
+              query.constraints.size() == 2 &&
+              query.constraints[0].termIndexes == vector<uint32_t>({2, 0}) &&
+              query.constraints[0].maxDistance == 0 &&
+              query.constraints[1].termIndexes == vector<uint32_t>({0, 1}) &&
+              query.constraints[1].maxDistance == 3,
+          "phrase query was not parsed");
+    check(getQueryCacheKey("\"el agua\"", SEARCH_ALL_WORDS, 0, 10) !=
+              getQueryCacheKey("el agua", SEARCH_ALL_WORDS, 0, 10),
+          "a phrase and its words share the cache key");
+
+    writeFixture(wikiPath);
+
+    SearchIndexOptions positionOptions = options;
+    positionOptions.storePositions = true;
+
+    SearchIndex index;
+    index.build(wikiPath.string(), positionOptions);
+    check(index.hasPositions() && index.getPositionBytes() > 0, "positions were not stored");
+
+    // Agua: "El agua es una sustancia"; Guerra: "Una guerra es un conflicto; el agua también"
+    vector<SearchResult> results;
+    const pair<const char *, size_t> phraseQueries[] = {
+        {"\"el agua\"", 2},
+        {"\"también agua\"", 0},
+        {"también agua", 1},
+        {"\"guerra del golfo\"", 1},
+        {"\"guerra golfo\"", 0},
+        {"guerra NEAR/2 conflicto", 0},
+        {"guerra NEAR/3 conflicto", 1},
+        {"conflicto NEAR/3 guerra", 1},
+    };
+    for (auto &phraseQuery : phraseQueries)
+        check(index.search(phraseQuery.first, SEARCH_ALL_WORDS, 0, 10, results) == phraseQuery.second &&
+                  results.size() == phraseQuery.second,
+              string("phrase search failed for ") + phraseQuery.first);
+
+    // La frase no es opcional en el modo OR; las otras palabras sí
+    check(index.search("\"el agua\" golfo", SEARCH_ANY_WORD, 0, 10, results) == 2,
+          "phrase should be required in any-word mode");
+
+    SearchIndex withoutPositions;
+    withoutPositions.build(wikiPath.string(), options);
+    check(!withoutPositions.hasPositions() &&
+              withoutPositions.search("\"también agua\"", SEARCH_ALL_WORDS, 0, 10, results) == 1,
+          "phrase without positions should match its words");
+
+    auto filename = (wikiPath.parent_path() / "positions.bin").string();
+    index.save(filename);
+    SearchIndex loaded;
+    check(loaded.load(filename) && loaded.hasPositions() &&
+              loaded.search("\"el agua\"", SEARCH_ALL_WORDS, 0, 10, results) == 2 &&
+              loaded.search("\"también agua\"", SEARCH_ALL_WORDS, 0, 10, results) == 0,
+          "loaded index lost its positions");
+    loaded.clear();
+    filesystem::remove(filename);
+
+    // Las posiciones de las páginas que no cambian se copian
+    ofstream(wikiPath / "Golfo.html") << "<html><head><title>Golfo</title></head>\n"
+                                         "<body><p>El agua del golfo.</p></body></html>\n";
+    SearchIndex updated;
+    check(updated.build(wikiPath.string(), positionOptions, &index) == 1 &&
+              updated.search("\"el agua\"", SEARCH_ALL_WORDS, 0, 10, results) == 3 &&
+              updated.search("\"guerra del golfo\"", SEARCH_ALL_WORDS, 0, 10, results) == 0 &&
+              updated.search("guerra NEAR/3 conflicto", SEARCH_ALL_WORDS, 0, 10, results) == 1,
+          "incremental build lost positions");
+
+    // Y también al mezclar segmentos
+    auto indexPath = (wikiPath.parent_path() / "positionSegments").string();
+    filesystem::remove_all(indexPath);
+
+    writeFixture(wikiPath);
+    SegmentedIndex segmented(indexPath, wikiPath.string(), positionOptions);
+    segmented.build();
+    ofstream(wikiPath / "Golfo.html") << "<html><head><title>Golfo</title></head>\n"
+                                         "<body><p>El agua del golfo.</p></body></html>\n";
+    segmented.update();
+    segmented.mergeSegments();
+
+    shared_ptr<const IndexSnapshot> snapshot = segmented.getSnapshot();
+
+    IndexMatches matches;
+    snapshot->openMatches("\"el agua\"", SEARCH_ALL_WORDS, matches);
+    DocId docIds[8];
+    check(snapshot->search("\"el agua\"", SEARCH_ALL_WORDS, 0, 10, results) == 3 &&
+              snapshot->search("\"también agua\"", SEARCH_ALL_WORDS, 0, 10, results) == 0 &&
+              matches.next(docIds, 8) == 3,
+          "segmented index lost positions");
+
+    // Sin las posiciones que se piden, los segmentos se vuelven a armar
+    SegmentedIndex reloaded(indexPath, wikiPath.string(), positionOptions);
+    SegmentedIndex reloadedWithoutPositions(indexPath, wikiPath.string(), options);
+    check(reloaded.load() && !reloadedWithoutPositions.load(),
+          "segments were loaded with other positions");
+
+    filesystem::remove_all(indexPath);
+}
+
+/**
+ * @brief Terms are found across dictionary blocks, and completed by
+ *        frequency in every segment
+ *
+ * @param wikiPath
+ * @param options
+ */
+static void testTermDictionary(const filesystem::path &wikiPath, const SearchIndexOptions &options)
+{
+    writeFixture(wikiPath);
+
+    // Muchos términos con prefijos comunes, para llenar varios bloques
+    ofstream numbers(wikiPath / "Numeros.html");
+    numbers << "<html><body>";
+    for (int i = 0; i < 200; i++)
+        numbers << " numero" << i;
+    numbers << "</body></html>\n";
+    numbers.close();
+
+    SearchIndex index;
+    index.build(wikiPath.string(), options);
+
+    vector<DocId> noDeletions;
+    bool allFound = true;
+    for (int i = 0; i < 200; i++)
+        allFound = allFound && index.getDocumentFrequency("numero" + to_string(i), noDeletions) == 1;
+    check(allFound && index.getDocumentFrequency("guerra", noDeletions) == 2,
+          "terms were not found in the dictionary");
+    check(!index.getDocumentFrequency("numero200", noDeletions) &&
+              !index.getDocumentFrequency("numer", noDeletions) &&
+              !index.getDocumentFrequency("zzz", noDeletions),
+          "missing terms were found in the dictionary");
+
+    string previous;
+    size_t termCount = 0;
+    bool isSorted = true;
+    for (TermCursor cursor(index); !cursor.isAtEnd(); cursor.next(), termCount++)
+    {
+        isSorted = isSorted && previous < cursor.getText();
+        previous = string(cursor.getText());
+    }
+    check(isSorted && termCount == index.getTermCount(), "term cursor did not walk the dictionary");
+
+    auto indexPath = (wikiPath.parent_path() / "completionSegments").string();
+    filesystem::remove_all(indexPath);
+
+    SegmentedIndex segmented(indexPath, wikiPath.string(), options);
+    segmented.build();
+
+    auto getCompletions = [&](const string &prefix, size_t count)
+    {
+        vector<TermCompletion> completions;
+        segmented.getSnapshot()->findCompletions(prefix, count, completions);
+
+        string text;
+        for (auto &completion : completions)
+            text += completion.term + ":" + to_string(completion.documentFrequency) + " ";
+        return text;
+    };
+
+    check(getCompletions("g", 10) == "guerra:2 golfo:1 ", "completions are not by frequency");
+    check(getCompletions("la GU", 10) == "guerra:2 ", "completions should use the last word");
+    check(getCompletions("e", 1) == "el:2 ", "completions with the same frequency are not alphabetical");
+    check(getCompletions("numero19", 3) == "numero19:1 numero190:1 numero191:1 ",
+          "completions across blocks failed");
+    check(getCompletions("x", 10).empty() && getCompletions("", 10).empty(), "unexpected completions");
+
+    // Las páginas borradas no cuentan, aunque estén en otro segmento
+    ofstream(wikiPath / "Nueva.html") << "<html><body>Una guerra nueva.</body></html>\n";
+    filesystem::remove(wikiPath / "Agua.html");
+    segmented.update();
+    check(segmented.getSnapshot()->getSegmentCount() == 2 &&
+              getCompletions("g", 10) == "guerra:3 golfo:1 " &&
+              getCompletions("agu", 10) == "agua:1 " &&
+              getCompletions("sus", 10).empty(),
+          "completions counted deleted pages");
+
+    filesystem::remove_all(indexPath);
+}
+
+/**
+ * @brief Words with "~" also match the terms a few edits away
+ *
+ * @param wikiPath
+ * @param options
+ */
+static void testFuzzySearch(const filesystem::path &wikiPath, const SearchIndexOptions &options)
+{
+    SearchQuery query;
+    parseSearchQuery("gerra~ agua~2 de~ \"el golfo~\" sin~0", query);
+    check(query.terms == vector<string_view>({"agua", "de", "el", "gerra", "golfo", "sin"}) &&
+              query.maxEdits == vector<uint32_t>({2, 0, 0, 1, 0, 0}),
+          "fuzzy query was not parsed");
+    check(getQueryCacheKey("gerra~", SEARCH_ALL_WORDS, 0, 10) !=
+              getQueryCacheKey("gerra", SEARCH_ALL_WORDS, 0, 10),
+          "a fuzzy word and the exact one share the cache key");
+
+    // Las distancias son en caracteres, no en bytes
+    auto getDistance = [](string_view a, string_view b, uint32_t maxDistance)
+    {
+        LevenshteinAutomaton automaton(a, maxDistance);
+        vector<uint8_t> state(automaton.getStateSize());
+        vector<uint8_t> nextState(automaton.getStateSize());
+        automaton.start(state.data());
+
+        size_t position = 0;
+        uint32_t codepoint;
+        while (position < b.size())
+        {
+            position += decodeUtf8(b, position, codepoint);
+            automaton.step(state.data(), codepoint, nextState.data());
+            state.swap(nextState);
+        }
+        return automaton.getDistance(state.data());
+    };
+    check(getDistance("guerra", "gerra", 2) == 1 && getDistance("guerra", "gueraa", 2) == 1 &&
+              getDistance("guerra", "agua", 2) == 3 &&
+              getDistance("\u03b1\u03b8\u03b7\u03bd\u03b1", "\u03b1\u03b8\u03b9\u03bd\u03b1", 2) == 1,
+          "unexpected edit distances");
+
+    writeFixture(wikiPath);
+
+    SearchIndex index;
+    index.build(wikiPath.string(), options);
+
+    vector<SearchResult> results;
+    const pair<const char *, size_t> fuzzyQueries[] = {
+        {"gerra", 0},
+        {"gerra~", 2},
+        {"gerra~ golfo", 1},
+        {"gera~", 0},
+        {"gera~2", 2},
+        {"\"la gerra~\"", 0},
+    };
+    for (auto &fuzzyQuery : fuzzyQueries)
+        check(index.search(fuzzyQuery.first, SEARCH_ALL_WORDS, 0, 10, results) == fuzzyQuery.second,
+              string("fuzzy search failed for ") + fuzzyQuery.first);
+
+    check(index.search("gerra~ sustancia", SEARCH_ANY_WORD, 0, 10, results) == 3,
+          "fuzzy search failed in any-word mode");
+
+    // Las variantes pesan menos que la palabra exacta
+    check(index.search("guerra~ golfo~", SEARCH_ANY_WORD, 0, 10, results) == 2 &&
+              results[0].docId == 1,
+          "fuzzy variants should not outrank exact words");
+
+    auto indexPath = (wikiPath.parent_path() / "fuzzySegments").string();
+    filesystem::remove_all(indexPath);
+
+    SegmentedIndex segmented(indexPath, wikiPath.string(), options);
+    segmented.build();
+    ofstream(wikiPath / "Nueva.html") << "<html><body>Una gerra nueva.</body></html>\n";
+    segmented.update();
+
+    // Las variantes de todos los segmentos, también sin ordenar
+    shared_ptr<const IndexSnapshot> snapshot = segmented.getSnapshot();
+    IndexMatches matches;
+    snapshot->openMatches("guerra~ una", SEARCH_ALL_WORDS, matches);
+    DocId docIds[8];
+    check(snapshot->search("guerra~", SEARCH_ALL_WORDS, 0, 10, results) == 3 &&
+              snapshot->search("guerra", SEARCH_ALL_WORDS, 0, 10, results) == 2 &&
+              matches.next(docIds, 8) == 2,
+          "fuzzy search failed in a segmented index");
+
+    filesystem::remove_all(indexPath);
+}
+
+/**
+ * @brief AND, OR, NOT and parentheses build a tree, which each index plans
+ *        and runs with its own list lengths
+ *
+ * @param wikiPath
+ * @param options
+ */
+static void testBooleanSearch(const filesystem::path &wikiPath, const SearchIndexOptions &options)
+{
+    SearchQuery query;
+    parseSearchQuery("agua OR (golfo -guerra)", query);
+    check(query.terms == vector<string_view>({"agua", "golfo", "guerra"}) &&
+              query.nodes.size() == 6 && query.nodes.back().type == QUERY_OR &&
+              query.nodes[query.nodes.back().children[1]].type == QUERY_AND &&
+              query.termWeights == vector<float>({1, 1, 0}),
+          "boolean query was not parsed");
+
+    parseSearchQuery("agua golfo", query);
+    check(query.nodes.empty(), "a query without operators should not have a tree");
+
+    // Listas sintéticas: a es densa (un bitmap), b y c son cortas
+    const uint32_t documentCount = 20000;
+    vector<DocId> docIds[3];
+    for (DocId docId = 0; docId < documentCount; docId += 2)
+        docIds[0].push_back(docId);
+    for (DocId docId = 0; docId < 10000; docId += 1000)
+        docIds[1].push_back(docId);
+    for (DocId docId = 0; docId < 18000; docId += 30)
+        docIds[2].push_back(docId);
+
+    vector<uint8_t> encoded[3];
+    vector<PostingReader> lists;
+    for (size_t i = 0; i < 3; i++)
+    {
+        size_t offset;
+        PostingEncoding encoding = encodePostings(docIds[i].data(), docIds[i].size(), POSTING_CODEC_VARINT,
+                                                  documentCount, encoded[i], offset);
+        lists.push_back(PostingReader(encoded[i].data() + offset, (uint32_t)docIds[i].size(),
+                                      encoding, documentCount));
+    }
+
+    // Una lista por término de la búsqueda, que son letras de la a a la c
+    vector<PostingReader> postings;
+    auto setPostings = [&]()
+    {
+        postings.clear();
+        for (auto term : query.terms)
+            postings.push_back(lists[term[0] - 'a']);
+    };
+
+    auto keepAll = [](uint32_t, DocId *, size_t count)
+    { return count; };
+
+    const pair<const char *, const char *> plans[] = {
+        {"a b -c", "AND/galloping(b a NOT/galloping(c))"},
+        {"a OR c", "OR/bitmap(c a)"},
+        {"b OR c", "OR/merge(b c)"},
+        {"(b OR c) a", "AND/galloping(OR/merge(b c) a)"},
+        {"a AND a", "a"},
+        {"-a", "NONE"},
+    };
+    for (auto &plan : plans)
+    {
+        parseSearchQuery(plan.first, query);
+        setPostings();
+        check(QueryPlan(query, postings, documentCount).describe() == plan.second,
+              string("unexpected plan for ") + plan.first);
+    }
+
+    vector<DocId> planResults;
+    parseSearchQuery("a b -c", query);
+    setPostings();
+    QueryPlan(query, postings, documentCount).run(keepAll, planResults);
+    check(planResults == vector<DocId>({1000, 2000, 4000, 5000, 7000, 8000}), "plan found other pages");
+
+    // c está toda en a, y comparte cuatro páginas con b
+    parseSearchQuery("(b OR c) a", query);
+    setPostings();
+    QueryPlan(query, postings, documentCount).run(keepAll, planResults);
+    check(planResults.size() == 606, "union plan found other pages");
+
+    writeFixture(wikiPath);
+
+    SearchIndexOptions positionOptions = options;
+    positionOptions.storePositions = true;
+
+    SearchIndex index;
+    index.build(wikiPath.string(), positionOptions);
+
+    // Agua: "El agua es una sustancia"; Golfo: "La guerra del golfo";
+    // Guerra: "Una guerra es un conflicto; el agua también"
+    vector<SearchResult> results;
+    const pair<const char *, size_t> booleanQueries[] = {
+        {"agua OR golfo", 3},
+        {"guerra -golfo", 1},
+        {"guerra NOT golfo", 1},
+        {"agua AND guerra", 1},
+        {"(sustancia OR golfo) guerra", 1},
+        {"-guerra", 0},
+        {"NOT NOT agua", 2},
+        {"una (agua OR", 2},
+        {"\"también agua\" OR golfo", 1},
+        {"\"el agua\" OR golfo", 3},
+        {"agua -\"el agua\"", 0},
+        {"guerra -(golfo OR sustancia)", 1},
+        {"guerra NEAR/3 conflicto OR sustancia", 2},
+        {"guerra -gerra~", 0},
+    };
+    for (auto &booleanQuery : booleanQueries)
+        check(index.search(booleanQuery.first, SEARCH_ALL_WORDS, 0, 10, results) == booleanQuery.second &&
+                  results.size() == booleanQuery.second,
+              string("boolean search failed for ") + booleanQuery.first);
+
+    // Las palabras excluidas no suman, y un OR no cambia los puntajes
+    vector<SearchResult> wordResults;
+    index.search("guerra", SEARCH_ALL_WORDS, 0, 10, wordResults);
+    check(index.search("guerra -sustancia", SEARCH_ALL_WORDS, 0, 10, results) == 2 &&
+              results[0].docId == wordResults[0].docId && results[0].score == wordResults[0].score,
+          "excluded words changed the scores");
+
+    auto indexPath = (wikiPath.parent_path() / "booleanSegments").string();
+    filesystem::remove_all(indexPath);
+
+    SegmentedIndex segmented(indexPath, wikiPath.string(), positionOptions);
+    segmented.build();
+    ofstream(wikiPath / "Nueva.html") << "<html><body>Una guerra nueva.</body></html>\n";
+    segmented.update();
+
+    shared_ptr<const IndexSnapshot> snapshot = segmented.getSnapshot();
+    IndexMatches matches;
+    snapshot->openMatches("guerra -golfo", SEARCH_ALL_WORDS, matches);
+    DocId streamed[8];
+    SearchTiming timing = {-1, -1, -1};
+    check(snapshot->search("guerra -golfo", SEARCH_ALL_WORDS, 0, 10, results, &timing) == 2 &&
+              matches.next(streamed, 8) == 2 && timing.parseTime >= 0 &&
+              timing.planningTime >= 0 && timing.executionTime >= 0,
+          "boolean search failed in a segmented index");
+
+    filesystem::remove_all(indexPath);
+}
+
+/**
+ * @brief Writes a corpus of a few related pages, for the golden results
+ *
+ * @param wikiPath
+ */
+static void writeGoldenFixture(const filesystem::path &wikiPath)
+{
+    filesystem::remove_all(wikiPath);
+    filesystem::create_directories(wikiPath);
+
+    const vector<pair<string, string>> pages = {
+        {"Africa", "<title>África</title><p>África es un continente. Egipto, Kenia y Nigeria son "
+                   "países de África.</p>"},
+        {"Egipto", "<title>Egipto</title><p>Egipto es un país de África. Las pirámides de "
+                   "Egipto están junto al Nilo.</p>"},
+        {"Mexico", "<title>México</title><p>México es un país de América del Norte. "
+                   "Tiene pirámides mayas.</p>"},
+        {"Mundo", "<title>Mundo</title><p>El mundo tiene continentes: África, América, Asia, "
+                  "Europa y Oceanía.</p>"},
+        {"Piramide", "<title>Pirámide</title><p>Una pirámide es una construcción. Las "
+                     "pirámides de Egipto y de México.</p>"},
+        {"Rio_Amazonas", "<title>Río Amazonas</title><p>El Amazonas es el río más caudaloso "
+                         "del mundo, en América del Sur.</p>"},
+        {"Rio_Nilo", "<title>Río Nilo</title><p>El Nilo es el río más largo de África. "
+                     "El río Nilo cruza Egipto.</p>"},
+        {"Sahara", "<title>Sahara</title><p>El desierto del Sahara está en el norte de África, "
+                   "al oeste del Nilo.</p>"},
+    };
+
+    for (auto &page : pages)
+        ofstream(wikiPath / (page.first + ".html")) << "<html><head>" << page.second << "</body></html>\n";
+}
+
+/**
+ * @brief Searches over the golden corpus must find these pages, in this order.
+ *        Si un cambio del ranking es a propósito, se actualiza la tabla
+ *
+ * @param wikiPath
+ * @param options
+ */
+static void testGoldenResults(const filesystem::path &wikiPath, const SearchIndexOptions &options)
+{
+    struct GoldenSearch
+    {
+        const char *searchString;
+        SearchMode mode;
+        size_t matchCount;
+        vector<string> paths;   // los primeros 5, sin "/wiki/" ni ".html"
+    };
+
+    const vector<GoldenSearch> goldenSearches = {
+        {"nilo", SEARCH_ALL_WORDS, 3, {"Rio_Nilo", "Egipto", "Sahara"}},
+        {"nilo", SEARCH_ANY_WORD, 3, {"Rio_Nilo", "Egipto", "Sahara"}},
+        {"río nilo", SEARCH_ALL_WORDS, 1, {"Rio_Nilo"}},
+        {"\"río nilo\"", SEARCH_ALL_WORDS, 1, {"Rio_Nilo"}},
+        {"áfrica", SEARCH_ALL_WORDS, 5, {"Africa", "Mundo", "Egipto", "Sahara", "Rio_Nilo"}},
+        {"egipto pirámides", SEARCH_ALL_WORDS, 2, {"Egipto", "Piramide"}},
+        {"egipto pirámides", SEARCH_ANY_WORD, 5, {"Egipto", "Piramide", "Mexico", "Africa", "Rio_Nilo"}},
+        {"país -méxico", SEARCH_ALL_WORDS, 1, {"Egipto"}},
+        {"(nilo OR amazonas) río", SEARCH_ALL_WORDS, 2, {"Rio_Amazonas", "Rio_Nilo"}},
+        {"río mundo", SEARCH_ANY_WORD, 3, {"Rio_Amazonas", "Rio_Nilo", "Mundo"}},
+        {"áfrica NEAR/3 egipto", SEARCH_ALL_WORDS, 0, {}},
+        {"áfrica NEAR/5 egipto", SEARCH_ALL_WORDS, 3, {"Egipto", "Africa", "Rio_Nilo"}},
+        {"piramde~", SEARCH_ALL_WORDS, 3, {"Piramide", "Mexico", "Egipto"}},
+        {"america~ sur", SEARCH_ALL_WORDS, 1, {"Rio_Amazonas"}},
+        {"continente OR desierto", SEARCH_ALL_WORDS, 2, {"Africa", "Sahara"}},
+        {"inexistente", SEARCH_ANY_WORD, 0, {}},
+    };
+
+    writeGoldenFixture(wikiPath);
+
+    SearchIndexOptions positionOptions = options;
+    positionOptions.storePositions = true;
+
+    SearchIndex index;
+    index.build(wikiPath.string(), positionOptions);
+
+    vector<SearchResult> results;
+    for (auto &golden : goldenSearches)
+    {
+        size_t matchCount = index.search(golden.searchString, golden.mode, 0, 5, results);
+
+        vector<string> paths;
+        for (auto &result : results)
+        {
+            string path(index.getDocument(result.docId).path);
+            paths.push_back(path.substr(6, path.size() - 11));
+        }
+
+        string label = string("\"") + golden.searchString + "\"" + (golden.mode == SEARCH_ANY_WORD ? " (any)" : "");
+        check(matchCount == golden.matchCount, label + " matched " + to_string(matchCount) + " pages");
+        check(paths == golden.paths, label + " changed its ranking");
+    }
+}
+
+/**
+ * @brief Reads a whole file, to compare saved indexes byte by byte
+ *
+ * @param filename
+ * @return string
+ */
+static string readFileBytes(const string &filename)
+{
+    ifstream file(filename, ios::binary);
+
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+/**
+ * @brief The saved index must not depend on the number of threads, on being
+ *        built at once or incrementally, or on a save and load in between
+ *
+ * @param wikiPath
+ * @param options
+ */
+static void testIndexEquivalence(const filesystem::path &wikiPath, const SearchIndexOptions &options)
+{
+    writeGoldenFixture(wikiPath);
+
+    for (PostingCodec codec : {POSTING_CODEC_RAW, POSTING_CODEC_VARINT, POSTING_CODEC_BITPACK})
+    {
+        for (bool storePositions : {false, true})
+        {
+            SearchIndexOptions buildOptions = options;
+            buildOptions.codec = codec;
+            buildOptions.storePositions = storePositions;
+
+            string label = string(getPostingCodecName(codec)) + (storePositions ? " with positions" : "");
+            string filename = (wikiPath.parent_path() / "serial.bin").string();
+
+            buildOptions.threadCount = 1;
+            SearchIndex serial;
+            serial.build(wikiPath.string(), buildOptions);
+            serial.save(filename);
+            string serialBytes = readFileBytes(filename);
+            check(!serialBytes.empty(), label + ": serial index was not saved");
+
+            for (unsigned int threadCount : {2, 3, 8})
+            {
+                buildOptions.threadCount = threadCount;
+                SearchIndex parallel;
+                parallel.build(wikiPath.string(), buildOptions);
+                parallel.save(filename);
+                check(readFileBytes(filename) == serialBytes,
+                      label + ": index built with " + to_string(threadCount) + " threads differs");
+            }
+
+            // Guardar lo cargado tiene que dar el mismo archivo
+            SearchIndex loaded;
+            check(loaded.load(filename, wikiPath.string()), label + ": load failed");
+            string copyname = (wikiPath.parent_path() / "copy.bin").string();
+            loaded.save(copyname);
+            check(readFileBytes(copyname) == serialBytes, label + ": saving a loaded index changed it");
+
+            // Sin cambios, y con todas las páginas cambiadas de a una
+            SearchIndex updated;
+            updated.build(wikiPath.string(), buildOptions, &loaded);
+            updated.save(copyname);
+            check(readFileBytes(copyname) == serialBytes, label + ": incremental build without changes differs");
+        }
+    }
+
+    // Una página cambiada, una nueva y una borrada, con y sin hilos
+    SearchIndex previous;
+    previous.build(wikiPath.string(), options);
+
+    ofstream(wikiPath / "Mexico.html") << "<html><head><title>México</title></head>\n"
+                                          "<body><p>México limita con Guatemala.</p></body></html>\n";
+    ofstream(wikiPath / "Kenia.html") << "<html><head><title>Kenia</title></head>\n"
+                                         "<body><p>Kenia es un país de África.</p></body></html>\n";
+    filesystem::remove(wikiPath / "Sahara.html");
+
+    SearchIndexOptions serialOptions = options;
+    serialOptions.threadCount = 1;
+
+    SearchIndex rebuilt;
+    rebuilt.build(wikiPath.string(), serialOptions);
+    string filename = (wikiPath.parent_path() / "serial.bin").string();
+    rebuilt.save(filename);
+    string serialBytes = readFileBytes(filename);
+
+    for (unsigned int threadCount : {1, 4})
+    {
+        SearchIndexOptions buildOptions = options;
+        buildOptions.threadCount = threadCount;
+
+        SearchIndex updated;
+        updated.build(wikiPath.string(), buildOptions, &previous);
+        updated.save(filename);
+        check(readFileBytes(filename) == serialBytes,
+              "incremental build with " + to_string(threadCount) + " threads differs from a serial build");
+    }
+}
+
+/**
+ * @brief Many threads search every kind of query at once, on one index and on
+ *        a segmented index that is updated meanwhile. Con EDAOOGLE_TSAN,
+ *        ThreadSanitizer revisa que no haya carreras
+ *
+ * @param wikiPath
+ * @param options
+ */
+static void testSearchStress(const filesystem::path &wikiPath, const SearchIndexOptions &options)
+{
+    writeGoldenFixture(wikiPath);
+
+    SearchIndexOptions positionOptions = options;
+    positionOptions.storePositions = true;
+
+    SearchIndex index;
+    index.build(wikiPath.string(), positionOptions);
+
+    auto indexPath = (wikiPath.parent_path() / "stress").string();
+    filesystem::remove_all(indexPath);
+    SegmentedIndex segmented(indexPath, wikiPath.string(), positionOptions);
+    segmented.build();
+
+    const vector<string> searchStrings = {"nilo", "río nilo", "egipto pirámides", "\"río nilo\"",
+                                          "áfrica NEAR/3 egipto", "(nilo OR amazonas) -sahara",
+                                          "piramde~", "país -méxico", "inexistente"};
+
+    vector<vector<SearchResult>> expected(searchStrings.size() * 2);
+    for (size_t i = 0; i < expected.size(); i++)
+        index.search(searchStrings[i / 2], (SearchMode)(i % 2), 0, 10, expected[i]);
+
+    atomic<int> mismatches(0);
+    atomic<bool> isUpdating(true);
+
+    vector<thread> threads;
+    for (int t = 0; t < 8; t++)
+    {
+        threads.emplace_back([&, t]()
+                             {
+                                 vector<SearchResult> results;
+                                 vector<DocId> docIds(4);
+                                 for (size_t j = 0; j < 300; j++)
+                                 {
+                                     size_t i = (j * 7 + t) % expected.size();
+                                     const string &searchString = searchStrings[i / 2];
+                                     SearchMode mode = (SearchMode)(i % 2);
+
+                                     index.search(searchString, mode, 0, 10, results);
+
+                                     bool isSame = results.size() == expected[i].size();
+                                     for (size_t k = 0; isSame && k < results.size(); k++)
+                                         isSame = results[k].docId == expected[i][k].docId &&
+                                                  results[k].score == expected[i][k].score;
+                                     if (!isSame)
+                                         mismatches++;
+
+                                     // El segmentado cambia mientras tanto: solo se recorre
+                                     shared_ptr<const IndexSnapshot> snapshot = segmented.getSnapshot();
+                                     snapshot->search(searchString, mode, 0, 10, results);
+
+                                     IndexMatches matches;
+                                     snapshot->openMatches(searchString, mode, matches);
+                                     while (matches.next(docIds.data(), docIds.size()))
+                                         ;
+                                 } });
+    }
+
+    thread updateThread([&]()
+                        {
+                            segmented.startMerging();
+                            for (int i = 0; isUpdating; i++)
+                            {
+                                ofstream(wikiPath / ("Extra" + to_string(i % 6) + ".html"))
+                                    << "<html><body>río nilo extra " << i << "</body></html>\n";
+                                segmented.update();
+                            }
+                            segmented.stopMerging(); });
+
+    for (auto &thread : threads)
+        thread.join();
+    isUpdating = false;
+    updateThread.join();
+
+    check(!mismatches, "searches under stress should match serial searches");
+}
+
+/**
+ * @brief Latencies keep their bucket within 1/16, and the metrics of all the
+ *        threads add up
+ *
+ */
+static void testServerMetrics()
+{
+    bool isBucketed = true;
+    for (uint64_t nanoseconds : {0ULL, 1ULL, 15ULL, 16ULL, 31ULL, 32ULL, 1000ULL, 123456ULL, 999999999ULL})
+    {
+        size_t bucket = LatencyHistogram::getBucket(nanoseconds);
+        uint64_t start = LatencyHistogram::getBucketStart(bucket);
+        uint64_t end = LatencyHistogram::getBucketStart(bucket + 1);
+
+        isBucketed = isBucketed && start <= nanoseconds && nanoseconds < end &&
+                     (end - start) * LATENCY_SUB_BUCKETS <= max(start, (uint64_t)LATENCY_SUB_BUCKETS);
+    }
+    check(isBucketed, "latencies should fall in a bucket at most 1/16 as wide as them");
+    check(LatencyHistogram::getBucket(UINT64_MAX) == LATENCY_BUCKET_COUNT - 1,
+          "very long latencies should go to the last bucket");
+
+    LatencyHistogram histogram;
+    for (uint64_t i = 1; i <= 1000; i++)
+        histogram.add(i * 1000);
+    check(histogram.getCount() == 1000 && histogram.getSum() == 500500000, "histogram count or sum is wrong");
+    check(fabs(histogram.getPercentile(0.5) - 500000.0) <= 500000.0 / 16 &&
+              fabs(histogram.getPercentile(0.99) - 990000.0) <= 990000.0 / 16,
+          "histogram percentiles are wrong");
+    check(histogram.getCountBelow(1 << 19) == 524, "histogram count below 2^19 ns is wrong");
+
+    ServerMetrics metrics;
+
+    vector<thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&]()
+                             {
+                                 for (int i = 0; i < 1000; i++)
+                                 {
+                                     metrics.addTime(METRIC_INTERSECT, 0.003);
+                                     metrics.addCount(METRIC_SEARCH_REQUESTS);
+                                     metrics.addCount(METRIC_SENT_BYTES, 100);
+                                 } });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    metrics.getHistogram(METRIC_INTERSECT, histogram);
+    check(histogram.getCount() == 4000 && histogram.getSum() == 4000 * 3000 &&
+              metrics.getCount(METRIC_SEARCH_REQUESTS) == 4000 && metrics.getCount(METRIC_SENT_BYTES) == 400000,
+          "metrics of all the threads should add up");
+
+    string text;
+    metrics.write(text);
+    check(text.find("edaoogle_requests_total{kind=\"search\"} 4000\n") != string::npos &&
+              text.find("edaoogle_sent_bytes_total 400000\n") != string::npos &&
+              text.find("edaoogle_stage_duration_seconds_bucket{stage=\"intersect\",le=\"2.048e-06\"} 0\n") != string::npos &&
+              text.find("edaoogle_stage_duration_seconds_bucket{stage=\"intersect\",le=\"4.096e-06\"} 4000\n") != string::npos &&
+              text.find("edaoogle_stage_duration_seconds_count{stage=\"send\"} 0\n") != string::npos &&
+              text.find("# TYPE edaoogle_stage_duration_seconds histogram\n") != string::npos,
+          "metrics text is not in the Prometheus format");
+}
+
 int main()
 {
+    testHtmlTokenizer();
+    testNormalizeTerms();
+    testQueryCache();
+    testServerMetrics();
+
+    auto wikiPath = filesystem::temp_directory_path() / "edaoogle_test" / "wiki";
+    writeFixture(wikiPath);
+
+    SearchIndexOptions options;
+    options.threadCount = 2;
+    options.codec = POSTING_CODEC_VARINT;
+    options.storePositions = false;
+
+    SearchIndex index;
+    index.build(wikiPath.string(), options);
+
+    testMatch(index);
+    testSearch(index);
+    testMatchStream(index);
+    testQueryFloodDoesNotGrowIndex(index);
+    testConcurrentSearch(index);
+    testSaveLoad(index, wikiPath);
+    testIncrementalBuild(index, wikiPath, options);
+    testSegmentedIndex(wikiPath, options);
+    testPhraseSearch(wikiPath, options);
+    testTermDictionary(wikiPath, options);
+    testFuzzySearch(wikiPath, options);
+    testBooleanSearch(wikiPath, options);
+    testGoldenResults(wikiPath, options);
+    testIndexEquivalence(wikiPath, options);
+    testSearchStress(wikiPath, options);
+
+    auto homePath = wikiPath.parent_path() / "home";
+    filesystem::create_directories(homePath);
+    testServeFiles(homePath);
+
+    filesystem::remove_all(wikiPath.parent_path());
+
+    if (failures)
+        return 1;
 
+    cout << "All tests passed" << endl;
     return 0;
-}
\ No newline at end of file
+}